@@ -0,0 +1,377 @@
+
+
+#ifndef ANTIALIASING_H
+#define ANTIALIASING_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "glstate.h"
+#include "primitives.h"
+#include "gputimer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// anti-aliasing modes of AntiAliasing
+enum AntiAliasingMode {
+    AA_NONE,
+    AA_MSAA, // 4x multisampled scene, resolved by PostProcess
+    AA_FXAA, // fxaa.frag on the tone mapped image
+    AA_SMAA  // SMAA 1x: smaaEdges.frag, smaaWeights.frag and smaaBlend.frag on the tone mapped image
+};
+
+// coverage of pixel x (its left side at x) under the line p1 -> p2, split into the part below the edge (x) and
+// above it (y)
+inline glm::vec2 smaaLineArea(glm::vec2 p1, glm::vec2 p2, float x)
+{
+    glm::vec2 d = p2 - p1;
+    float x1 = x, x2 = x + 1.0f;
+    float y1 = p1.y + d.y * (x1 - p1.x) / d.x;
+    float y2 = p1.y + d.y * (x2 - p1.x) / d.x;
+    bool inside = (x1 >= p1.x && x1 < p2.x) || (x2 > p1.x && x2 <= p2.x);
+    if (!inside)
+        return glm::vec2(0.0f);
+    bool trapezoid = (y1 < 0.0f) == (y2 < 0.0f) || std::fabs(y1) < 1e-4f || std::fabs(y2) < 1e-4f;
+    if (trapezoid)
+    {
+        float a = (y1 + y2) / 2.0f;
+        return a < 0.0f ? glm::vec2(-a, 0.0f) : glm::vec2(0.0f, a);
+    }
+    // the line crosses the edge inside the pixel: two triangles
+    float crossing = -p1.y * d.x / d.y + p1.x;
+    float fraction = crossing - std::floor(crossing);
+    float a1 = crossing > p1.x ? y1 * fraction / 2.0f : 0.0f;
+    float a2 = crossing < p2.x ? y2 * (1.0f - fraction) / 2.0f : 0.0f;
+    float a = std::fabs(a1) > std::fabs(a2) ? a1 : -a2;
+    return a < 0.0f ? glm::vec2(std::fabs(a1), std::fabs(a2)) : glm::vec2(std::fabs(a2), std::fabs(a1));
+}
+
+// U shapes get the square root of their area on short lines, or their middle pixels stay too sharp
+inline glm::vec2 smaaSmoothArea(float d, glm::vec2 a1, glm::vec2 a2)
+{
+    float p = std::min(d / 32.0f, 1.0f);
+    glm::vec2 b1 = glm::sqrt(a1 * 2.0f) * 0.5f;
+    glm::vec2 b2 = glm::sqrt(a2 * 2.0f) * 0.5f;
+    return glm::mix(b1, a1, p) + glm::mix(b2, a2, p);
+}
+
+// coverage of the pixel left pixels from the left end of an edge of left + right + 1 pixels, for the 16 shapes of
+// crossing edges at its ends (bits 0/1: below the edge at the left/right end, 2/3: above it). The line
+// is revectorized from the middle of the edge to half a pixel beyond the crossing edges.
+inline glm::vec2 smaaOrthogonalArea(int pattern, float left, float right)
+{
+    float d = left + right + 1.0f;
+    float o1 = 0.5f, o2 = -0.5f; // above and below the edge
+    glm::vec2 middle(d / 2.0f, 0.0f);
+    switch (pattern)
+    {
+    case 1: // crossing below on the left
+        return left <= right ? smaaLineArea(glm::vec2(0.0f, o2), middle, left) : glm::vec2(0.0f);
+    case 2:
+        return left >= right ? smaaLineArea(middle, glm::vec2(d, o2), left) : glm::vec2(0.0f);
+    case 3:
+        return smaaSmoothArea(d, smaaLineArea(glm::vec2(0.0f, o2), middle, left), smaaLineArea(middle, glm::vec2(d, o2), left));
+    case 4:
+        return left <= right ? smaaLineArea(glm::vec2(0.0f, o1), middle, left) : glm::vec2(0.0f);
+    case 6: case 7: case 14: // Z shapes, and those with a crossing edge going through one end
+        return smaaLineArea(glm::vec2(0.0f, o1), glm::vec2(d, o2), left);
+    case 8:
+        return left >= right ? smaaLineArea(middle, glm::vec2(d, o1), left) : glm::vec2(0.0f);
+    case 9: case 11: case 13:
+        return smaaLineArea(glm::vec2(0.0f, o2), glm::vec2(d, o1), left);
+    case 12:
+        return smaaSmoothArea(d, smaaLineArea(glm::vec2(0.0f, o1), middle, left), smaaLineArea(middle, glm::vec2(d, o1), left));
+    default: // no crossing edges, or both sides at one end
+        return glm::vec2(0.0f);
+    }
+}
+
+// The area texture of SMAA 1x (orthogonal patterns, no subpixel offset), RG8, AREA_SIZE x AREA_SIZE: for crossing
+// edges read as e1 and e2 (0, 0.25, 0.75 or 1 from a bilinear fetch, times 4) and distances to the ends of the edge
+// it holds the coverage at 16 * (e1, e2) + sqrt(distances). Computed the way the reference implementation's
+// AreaTex.py does, instead of shipping its table.
+inline vector<unsigned char> smaaAreaTexture()
+{
+    const int MAX_DISTANCE = 16, SIZE = 5 * MAX_DISTANCE;
+    // where in the 5 x 5 grid of crossing edge readings each pattern goes
+    const int patternCells[16][2] = { { 0, 0 }, { 3, 0 }, { 0, 3 }, { 3, 3 }, { 1, 0 }, { 4, 0 }, { 1, 3 }, { 4, 3 },
+                                      { 0, 1 }, { 3, 1 }, { 0, 4 }, { 3, 4 }, { 1, 1 }, { 4, 1 }, { 1, 4 }, { 4, 4 } };
+    vector<unsigned char> texels(SIZE * SIZE * 2, 0);
+    for (int pattern = 0; pattern < 16; pattern++)
+    {
+        for (int right = 0; right < MAX_DISTANCE; right++)
+        {
+            for (int left = 0; left < MAX_DISTANCE; left++)
+            {
+                // distances are stored quadratically, the shader takes their square root
+                glm::vec2 area = smaaOrthogonalArea(pattern, float(left * left), float(right * right));
+                int x = patternCells[pattern][0] * MAX_DISTANCE + left;
+                int y = patternCells[pattern][1] * MAX_DISTANCE + right;
+                texels[(y * SIZE + x) * 2 + 0] = (unsigned char)(glm::clamp(area.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+                texels[(y * SIZE + x) * 2 + 1] = (unsigned char)(glm::clamp(area.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    }
+    return texels;
+}
+
+// The search texture, R8, 66 x 33: the last fetch of a search, 4 edges bilinearly mixed into one value per channel
+// (read back as 32 * value, a unique integer per combination), mapped to how many of its 2 pixels the edge still
+// covers, times 127. Searches to the left use the first 33 columns, to the right the other 33. As the reference's
+// SearchTex.py, minus its flip and crop.
+inline vector<unsigned char> smaaSearchTexture()
+{
+    // which 4 edges (farther/nearer pixel of the row across the edge, then of the row along it) give each fetched value
+    int edges[33][4];
+    bool valid[33] = { false };
+    for (int combination = 0; combination < 16; combination++)
+    {
+        int e[4] = { combination & 1, (combination >> 1) & 1, (combination >> 2) & 1, (combination >> 3) & 1 };
+        int value = e[0] + 3 * e[1] + 7 * e[2] + 21 * e[3]; // 32 * bilinear weights of 1/32, 3/32, 7/32, 21/32
+        for (int i = 0; i < 4; i++)
+            edges[value][i] = e[i];
+        valid[value] = true;
+    }
+    vector<unsigned char> texels(66 * 33, 0);
+    for (int y = 0; y < 33; y++)
+    {
+        for (int x = 0; x < 33; x++)
+        {
+            if (!valid[x] || !valid[y])
+                continue;
+            const int* crossing = edges[x]; // r: edges across the line
+            const int* along = edges[y];    // g: the line's own edges
+            int left = 0, right = 0;
+            if (along[3] == 1)
+                left++;
+            if (left == 1 && along[2] == 1 && crossing[1] != 1 && crossing[3] != 1)
+                left++;
+            if (along[3] == 1 && crossing[1] != 1 && crossing[3] != 1)
+                right++;
+            if (right == 1 && along[2] == 1 && crossing[0] != 1 && crossing[2] != 1)
+                right++;
+            texels[y * 66 + x] = (unsigned char)(127 * left);
+            texels[y * 66 + x + 33] = (unsigned char)(127 * right);
+        }
+    }
+    return texels;
+}
+
+// Anti-aliasing of the final image, selectable at runtime.
+//
+// AA_MSAA renders the scene into a multisampled target (sceneSamples()) that PostProcess resolves in its shader,
+// like the anti-aliasing lesson's 4x framebuffer and blit. It costs 4x the scene's color and depth memory and
+// bandwidth and doesn't work with the deferred and SSAO G-buffers. AA_FXAA and AA_SMAA instead filter the tone
+// mapped image: PostProcess draws into target() (an RGBA8 texture the size of the screen), apply() writes the
+// anti-aliased result to the final framebuffer.
+//   FXAA is one pass that blurs across the edges it finds, cheap but a bit soft on text and fine detail.
+//   SMAA 1x finds edges (smaaEdges.frag), measures the pattern they are part of and looks its coverage up in the
+//   precomputed area texture (smaaWeights.frag), then blends every pixel with its neighbours by that coverage
+//   (smaaBlend.frag). Sharper than FXAA, for an RG8 and an RGBA8 target more.
+// Per frame: post.apply(scene, bloom, aa.target(0), w, h, aa.sceneSamples()); aa.apply(0);
+class AntiAliasing
+{
+public:
+    static const int MSAA_SAMPLES = 4;
+    static const int AREA_SIZE = 80;
+    static const int SEARCH_WIDTH = 66, SEARCH_HEIGHT = 33;
+
+    AntiAliasingMode mode;
+    float fxaaEdgeThreshold;    // relative local contrast an FXAA edge needs
+    float fxaaEdgeThresholdMin; // absolute
+    float fxaaSubpixel;         // 0 - 1, how much FXAA softens single pixel detail
+    float smaaThreshold;        // luma difference of an SMAA edge
+    int smaaSearchSteps;        // SMAA follows edges up to 2 * steps pixels each way
+    unsigned int color;         // the tone mapped image for FXAA and SMAA
+    int width, height;
+
+    AntiAliasing(int screenWidth, int screenHeight, AntiAliasingMode aaMode = AA_SMAA)
+        : mode(aaMode), fxaaEdgeThreshold(0.166f), fxaaEdgeThresholdMin(0.0833f), fxaaSubpixel(0.75f),
+          smaaThreshold(0.1f), smaaSearchSteps(16), color(0), width(0), height(0), edges(0), weights(0),
+          fxaaShader("blur.vs", "fxaa.frag"), edgesShader("blur.vs", "smaaEdges.frag"),
+          weightsShader("blur.vs", "smaaWeights.frag"), blendShader("blur.vs", "smaaBlend.frag")
+    {
+        glGenFramebuffers(1, &colorFBO);
+        glGenFramebuffers(1, &FBO);
+
+        vector<unsigned char> area = smaaAreaTexture();
+        glGenTextures(1, &areaTexture);
+        glState().bindTexture(GL_TEXTURE_2D, areaTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, AREA_SIZE, AREA_SIZE, 0, GL_RG, GL_UNSIGNED_BYTE, &area[0]);
+        setFilter(GL_LINEAR);
+        vector<unsigned char> search = smaaSearchTexture();
+        glGenTextures(1, &searchTexture);
+        glState().bindTexture(GL_TEXTURE_2D, searchTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, SEARCH_WIDTH, SEARCH_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, &search[0]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        setFilter(GL_NEAREST);
+
+        fxaaShader.use();
+        fxaaShader.setInt("image", 0);
+        edgesShader.use();
+        edgesShader.setInt("image", 0);
+        weightsShader.use();
+        weightsShader.setInt("edgesTexture", 0);
+        weightsShader.setInt("areaTexture", 1);
+        weightsShader.setInt("searchTexture", 2);
+        blendShader.use();
+        blendShader.setInt("image", 0);
+        blendShader.setInt("blendTexture", 1);
+        resize(screenWidth, screenHeight);
+    }
+
+    // reallocates the targets for a new screen size
+    void resize(int screenWidth, int screenHeight)
+    {
+        if (screenWidth == width && screenHeight == height && color)
+            return;
+        width = std::max(1, screenWidth);
+        height = std::max(1, screenHeight);
+        if (color)
+        {
+            unsigned int textures[3] = { color, edges, weights };
+            glDeleteTextures(3, textures);
+            glState().invalidate(); // some of them may still be bound
+        }
+        color = createTarget(GL_RGBA8, GL_RGBA);
+        edges = createTarget(GL_RG8, GL_RG);
+        weights = createTarget(GL_RGBA8, GL_RGBA);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, colorFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // samples of the scene target for this mode
+    int sceneSamples() const
+    {
+        return mode == AA_MSAA ? MSAA_SAMPLES : 1;
+    }
+
+    // whether apply() has work to do, i.e. the post-processing has to draw into target()
+    bool filtersImage() const
+    {
+        return mode == AA_FXAA || mode == AA_SMAA;
+    }
+
+    // the framebuffer the post-processing draws into: our color target for FXAA and SMAA, else finalFBO
+    unsigned int target(unsigned int finalFBO) const
+    {
+        return filtersImage() ? colorFBO : finalFBO;
+    }
+
+    // anti-aliases color into targetFBO (0 for the window), nothing to do for AA_NONE and AA_MSAA. Uses its own
+    // framebuffer and viewport. With a timer the passes are timed as "fxaa" or "smaa <pass>".
+    void apply(unsigned int targetFBO, GpuTimer* timer = 0)
+    {
+        if (!filtersImage())
+            return;
+        glState().disable(GL_DEPTH_TEST);
+        glState().disable(GL_BLEND);
+        glm::vec4 metrics(1.0f / width, 1.0f / height, (float)width, (float)height);
+
+        if (mode == AA_FXAA)
+        {
+            GpuTimer::mark(timer, "fxaa", true);
+            glState().bindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+            glState().viewport(0, 0, width, height);
+            fxaaShader.use();
+            fxaaShader.setVec2("texelSize", metrics.x, metrics.y);
+            fxaaShader.setFloat("edgeThreshold", fxaaEdgeThreshold);
+            fxaaShader.setFloat("edgeThresholdMin", fxaaEdgeThresholdMin);
+            fxaaShader.setFloat("subpixelQuality", fxaaSubpixel);
+            glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, color);
+            Primitives::Quad().draw();
+            GpuTimer::mark(timer, "fxaa", false);
+            glState().enable(GL_DEPTH_TEST);
+            return;
+        }
+
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glState().viewport(0, 0, width, height);
+
+        // 1. edges, only where there are some
+        GpuTimer::mark(timer, "smaa edges", true);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, edges, 0);
+        const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, zero);
+        edgesShader.use();
+        edgesShader.setVec4("metrics", metrics);
+        edgesShader.setFloat("threshold", smaaThreshold);
+        glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, color);
+        Primitives::Quad().draw();
+        GpuTimer::mark(timer, "smaa edges", false);
+
+        // 2. blending weights of the edges' patterns
+        GpuTimer::mark(timer, "smaa weights", true);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, weights, 0);
+        weightsShader.use();
+        weightsShader.setVec4("metrics", metrics);
+        weightsShader.setInt("maxSearchSteps", std::max(1, smaaSearchSteps));
+        glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, edges);
+        glState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, areaTexture);
+        glState().bindTexture(GL_TEXTURE2, GL_TEXTURE_2D, searchTexture);
+        Primitives::Quad().draw();
+        GpuTimer::mark(timer, "smaa weights", false);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+
+        // 3. blend the neighbours into targetFBO
+        GpuTimer::mark(timer, "smaa blend", true);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+        blendShader.use();
+        blendShader.setVec4("metrics", metrics);
+        glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, color);
+        glState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, weights);
+        Primitives::Quad().draw();
+        GpuTimer::mark(timer, "smaa blend", false);
+        glState().enable(GL_DEPTH_TEST);
+    }
+
+    // bytes of render targets mode needs on top of a single sampled RGBA16F scene with a 24/8 depth-stencil
+    // buffer at width x height (for MSAA: the extra samples of both), lookup textures included
+    static size_t extraMemory(AntiAliasingMode aaMode, int w, int h)
+    {
+        size_t pixels = (size_t)w * h;
+        switch (aaMode)
+        {
+        case AA_MSAA:
+            return pixels * (MSAA_SAMPLES - 1) * (8 + 4);
+        case AA_FXAA:
+            return pixels * 4;
+        case AA_SMAA:
+            return pixels * (4 + 2 + 4) + AREA_SIZE * AREA_SIZE * 2 + SEARCH_WIDTH * SEARCH_HEIGHT;
+        default:
+            return 0;
+        }
+    }
+
+private:
+    unsigned int colorFBO, FBO;
+    unsigned int edges, weights;
+    unsigned int areaTexture, searchTexture;
+    Shader fxaaShader, edgesShader, weightsShader, blendShader;
+
+    unsigned int createTarget(GLenum internalFormat, GLenum format)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState().bindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, NULL);
+        setFilter(GL_LINEAR);
+        return texture;
+    }
+
+    static void setFilter(GLint filter)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+};
+#endif
@@ -0,0 +1,265 @@
+
+
+#ifndef ASTEROIDS_H
+#define ASTEROIDS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "culling.h"
+#include "instancing.h"
+#include "pcg.h"
+#include "workers.h"
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+using namespace std;
+
+// The asteroid ring of the instancing lesson: a compact transform per rock (32 bytes, see CompactInstance),
+// plus a world space bounding sphere per rock so the field can be frustum culled before drawing.
+class AsteroidField
+{
+public:
+    vector<CompactInstance> instances;
+    SphereSet bounds;
+
+    // scatters amount rocks on a ring of the given radius, displaced by up to offset in every direction
+    // (PCG32, so the same seed gives the same field with every standard library)
+    void generate(unsigned int amount, float radius, float offset, const BoundingSphere& rockBounds, uint64_t seed = 0)
+    {
+        PCG32 rng(seed);
+        const glm::vec3 spinAxis = glm::normalize(glm::vec3(0.4f, 0.6f, 0.8f));
+        instances.resize(amount);
+        for (unsigned int i = 0; i < amount; i++)
+        {
+            // here we create the translation for our asteroids.
+            float angle = (float)i / (float)amount * 360.0f;
+            float x = std::sin(angle) * radius + rng.range(-offset, offset);
+            float y = rng.range(-offset, offset) * 0.4f; // keep height of field smaller compared to width of x and z
+            float z = std::cos(angle) * radius + rng.range(-offset, offset);
+
+            // scale and rotation, stored as they are instead of baked into a matrix
+            float s = rng.range(0.05f, 0.25f);
+            instances[i] = CompactInstance(glm::vec3(x, y, z), s, glm::angleAxis(rng.range(0.0f, 360.0f), spinAxis));
+        }
+        updateBounds(rockBounds);
+    }
+
+    // recomputes the world space bounding spheres from the rock model's bounds
+    void updateBounds(const BoundingSphere& rockBounds)
+    {
+        bounds.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            // rotation keeps distances, so only the uniform scale touches the radius
+            const CompactInstance& instance = instances[i];
+            glm::vec3 center = instance.position + instance.scale * (instance.quaternion() * rockBounds.center);
+            bounds.set(i, BoundingSphere(center, rockBounds.radius * instance.scale));
+        }
+    }
+
+    // full model matrices, for code that needs them (the GPU culler's instance buffer)
+    vector<glm::mat4> modelMatrices() const
+    {
+        vector<glm::mat4> matrices(instances.size());
+        for (size_t i = 0; i < instances.size(); i++)
+            matrices[i] = instances[i].matrix();
+        return matrices;
+    }
+
+    size_t size() const
+    {
+        return instances.size();
+    }
+};
+
+// The animated version of the ring: every rock orbits the planet and spins about its own axis, and the
+// transforms are rebuilt every frame. The state is kept as a structure of arrays so update() can stream
+// through it four rocks at a time, and the CompactInstances are written straight to their destination
+// (a persistently mapped InstanceBuffer) with no intermediate copy.
+class AsteroidSimulation
+{
+public:
+    // orbit: position = (sin(angle) * orbitRadius, height, cos(angle) * orbitRadius)
+    vector<float> orbitRadius, angle, angularVelocity, height;
+    // spin: rotation of spinAngle about the unit axis (axisX, axisY, axisZ)
+    vector<float> axisX, axisY, axisZ, spinAngle, spinRate;
+    vector<float> scale;
+
+    void generate(unsigned int amount, float radius, float offset, uint64_t seed = 0)
+    {
+        const float pi = 3.14159265f;
+        PCG32 rng(seed);
+        resize(amount);
+        for (unsigned int i = 0; i < amount; i++)
+        {
+            orbitRadius[i] = radius + rng.range(-offset, offset);
+            angle[i] = rng.range(-pi, pi);
+            // Kepler: the inner rocks go round faster, one revolution in about two minutes at the ring's radius
+            angularVelocity[i] = 0.05f * std::pow(radius / orbitRadius[i], 1.5f);
+            height[i] = rng.range(-offset, offset) * 0.4f; // keep height of field smaller compared to width of x and z
+            glm::vec3 axis;
+            do
+                axis = glm::vec3(rng.range(-1.0f, 1.0f), rng.range(-1.0f, 1.0f), rng.range(-1.0f, 1.0f));
+            while (glm::dot(axis, axis) < 0.01f || glm::dot(axis, axis) > 1.0f);
+            axis = glm::normalize(axis);
+            axisX[i] = axis.x;
+            axisY[i] = axis.y;
+            axisZ[i] = axis.z;
+            spinAngle[i] = rng.range(-pi, pi);
+            spinRate[i] = rng.range(-1.0f, 1.0f);
+            scale[i] = rng.range(0.05f, 0.25f);
+        }
+    }
+
+    size_t size() const
+    {
+        return angle.size();
+    }
+
+    // advances rocks [begin, end) by dt seconds and writes their transforms to out[begin, end)
+    void updateScalar(float dt, CompactInstance* out, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            angle[i] = wrapAngle(angle[i] + angularVelocity[i] * dt);
+            spinAngle[i] = wrapAngle(spinAngle[i] + spinRate[i] * dt);
+            float halfSpin = 0.5f * spinAngle[i];
+            float s = std::sin(halfSpin);
+            CompactInstance& instance = out[i];
+            instance.position = glm::vec3(std::sin(angle[i]) * orbitRadius[i], height[i], std::cos(angle[i]) * orbitRadius[i]);
+            instance.scale = scale[i];
+            instance.rotation = glm::vec4(axisX[i] * s, axisY[i] * s, axisZ[i] * s, std::cos(halfSpin));
+        }
+    }
+
+#ifdef CULLING_SSE
+    // same as updateScalar, four rocks per iteration with a polynomial sin/cos (error below 1e-6)
+    void updateSSE(float dt, CompactInstance* out, size_t begin, size_t end)
+    {
+        const __m128 dt4 = _mm_set1_ps(dt);
+        const __m128 half = _mm_set1_ps(0.5f);
+        // write-combined memory (a GL mapping) wants whole lines written at once, so bypass the cache when we can
+        const bool streaming = ((uintptr_t)(out + begin) & 15) == 0;
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 a = wrapAngle(_mm_add_ps(_mm_loadu_ps(&angle[i]), _mm_mul_ps(_mm_loadu_ps(&angularVelocity[i]), dt4)));
+            __m128 spin = wrapAngle(_mm_add_ps(_mm_loadu_ps(&spinAngle[i]), _mm_mul_ps(_mm_loadu_ps(&spinRate[i]), dt4)));
+            _mm_storeu_ps(&angle[i], a);
+            _mm_storeu_ps(&spinAngle[i], spin);
+
+            __m128 sinA, cosA, sinS, cosS;
+            sinCos(a, sinA, cosA);
+            sinCos(_mm_mul_ps(spin, half), sinS, cosS);
+            __m128 r = _mm_loadu_ps(&orbitRadius[i]);
+            __m128 px = _mm_mul_ps(sinA, r);
+            __m128 py = _mm_loadu_ps(&height[i]);
+            __m128 pz = _mm_mul_ps(cosA, r);
+            __m128 ps = _mm_loadu_ps(&scale[i]);
+            __m128 qx = _mm_mul_ps(_mm_loadu_ps(&axisX[i]), sinS);
+            __m128 qy = _mm_mul_ps(_mm_loadu_ps(&axisY[i]), sinS);
+            __m128 qz = _mm_mul_ps(_mm_loadu_ps(&axisZ[i]), sinS);
+            __m128 qw = cosS;
+            // structure of arrays to array of structures: afterwards px holds rock i's position and scale, etc.
+            _MM_TRANSPOSE4_PS(px, py, pz, ps);
+            _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+            float* o = (float*)&out[i];
+            if (streaming)
+            {
+                _mm_stream_ps(o, px);
+                _mm_stream_ps(o + 4, qx);
+                _mm_stream_ps(o + 8, py);
+                _mm_stream_ps(o + 12, qy);
+                _mm_stream_ps(o + 16, pz);
+                _mm_stream_ps(o + 20, qz);
+                _mm_stream_ps(o + 24, ps);
+                _mm_stream_ps(o + 28, qw);
+            }
+            else
+            {
+                _mm_storeu_ps(o, px);
+                _mm_storeu_ps(o + 4, qx);
+                _mm_storeu_ps(o + 8, py);
+                _mm_storeu_ps(o + 12, qy);
+                _mm_storeu_ps(o + 16, pz);
+                _mm_storeu_ps(o + 20, qz);
+                _mm_storeu_ps(o + 24, ps);
+                _mm_storeu_ps(o + 28, qw);
+            }
+        }
+        if (streaming)
+            _mm_sfence(); // make the streamed stores visible before the GL thread submits the draw
+        updateScalar(dt, out, i, end);
+    }
+#endif
+
+    // advances rocks [begin, end) with the fastest kernel available
+    void update(float dt, CompactInstance* out, size_t begin, size_t end)
+    {
+#ifdef CULLING_SSE
+        updateSSE(dt, out, begin, end);
+#else
+        updateScalar(dt, out, begin, end);
+#endif
+    }
+
+    // advances every rock, split across the pool's threads; out has room for size() instances
+    void update(float dt, CompactInstance* out, WorkerPool& pool)
+    {
+        // ranges start on multiples of 4 rocks, so each thread writes whole 128 byte groups
+        pool.parallelFor(size(), [this, dt, out](size_t begin, size_t end) { update(dt, out, begin, end); }, 4);
+    }
+
+private:
+    void resize(size_t amount)
+    {
+        vector<float>* arrays[] = { &orbitRadius, &angle, &angularVelocity, &height, &axisX, &axisY, &axisZ, &spinAngle, &spinRate, &scale };
+        for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+            arrays[i]->assign(amount, 0.0f);
+    }
+
+    // back into [-pi, pi]
+    static float wrapAngle(float x)
+    {
+        return x - 6.28318531f * std::floor(x * 0.159154943f + 0.5f);
+    }
+
+#ifdef CULLING_SSE
+    static __m128 wrapAngle(__m128 x)
+    {
+        // round to nearest turn (the default rounding mode), good for |x| < 2^31 turns
+        __m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.159154943f))));
+        return _mm_sub_ps(x, _mm_mul_ps(turns, _mm_set1_ps(6.28318531f)));
+    }
+
+    // sin and cos of x in [-pi, pi]
+    static void sinCos(__m128 x, __m128& sine, __m128& cosine)
+    {
+        const __m128 pi = _mm_set1_ps(3.14159265f);
+        const __m128 halfPi = _mm_set1_ps(1.57079633f);
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        // sin(x) = sin(pi - x) folds the argument into [-pi/2, pi/2], where the series converges quickly
+        __m128 folded = _mm_max_ps(_mm_min_ps(x, _mm_sub_ps(pi, x)), _mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), pi), x));
+        sine = sinPolynomial(folded);
+        // cos(x) = sin(pi/2 - |x|), already inside [-pi/2, pi/2]
+        cosine = sinPolynomial(_mm_sub_ps(halfPi, _mm_andnot_ps(signMask, x)));
+    }
+
+    // Taylor series of sin up to x^11, for x in [-pi/2, pi/2]
+    static __m128 sinPolynomial(__m128 x)
+    {
+        __m128 x2 = _mm_mul_ps(x, x);
+        __m128 p = _mm_set1_ps(-2.50521084e-8f);                                   // -1/11!
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(2.75573192e-6f));            //  1/9!
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.98412698e-4f));           // -1/7!
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(8.33333333e-3f));            //  1/5!
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.66666667e-1f));           // -1/3!
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f));
+        return _mm_mul_ps(p, x);
+    }
+#endif
+};
+#endif
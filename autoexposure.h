@@ -0,0 +1,248 @@
+
+
+#ifndef AUTOEXPOSURE_H
+#define AUTOEXPOSURE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "shader.h"
+#include "glstate.h"
+#include "primitives.h"
+
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// Automatic exposure from the average luminance of the HDR image, adapting over time like an eye does.
+//
+// With compute shaders (GL 4.3) update() builds a 256 bin histogram of log2 luminance
+// (luminanceHistogram.comp, counting in shared memory per work group) and a second, single group pass
+// (luminanceAverage.comp) reduces it to the average log luminance of the non-black pixels, moves the adapted
+// luminance towards it and clears the histogram. Older contexts draw log2 luminance into a 256x256 target and
+// let glGenerateMipmap average it down to 1x1, black pixels weighted out (luminanceLog.frag,
+// luminanceAdapt.frag).
+// Either way the result stays on the GPU: exposureTexture is 1x1 RG32F, r the adapted luminance and g the
+// exposure keyValue / luminance, which postprocess.frag reads when PostProcess::autoExposure is set.
+// For telemetry the values are also copied into a ring of READBACK_FRAMES pixel buffers behind a fence each,
+// and picked up only once their fence has passed, so the CPU never waits for the GPU; they lag a few frames.
+class AutoExposure
+{
+public:
+    static const unsigned int READBACK_FRAMES = 3;
+    static const int LOG_LUMINANCE_SIZE = 256; // of the target averaged by mipmapping, pre-4.3 only
+
+    bool gpuHistogram;      // compute path, false on pre-4.3 contexts
+    float minLogLuminance;  // log2 luminance range the histogram covers
+    float maxLogLuminance;
+    float keyValue;         // brightness the average luminance is mapped to, 0.18 is middle grey
+    float adaptationSpeed;  // per second, larger adapts faster
+
+    // telemetry, read back a few frames late: adapted luminance and exposure, readbackAvailable once any arrived
+    float readbackLuminance;
+    float readbackExposure;
+    bool readbackAvailable;
+
+    AutoExposure()
+        : gpuHistogram(GLAD_GL_VERSION_4_3 != 0), minLogLuminance(-10.0f), maxLogLuminance(6.0f), keyValue(0.18f),
+          adaptationSpeed(1.5f), readbackLuminance(0.0f), readbackExposure(1.0f), readbackAvailable(false),
+          histogramShader(0), averageShader(0), logShader(0), adaptShader(0), histogramBuffer(0), logLuminance(0),
+          FBO(0), current(0), frame(0)
+    {
+        // 1x1 exposure, starting out "unknown" (0) so the first frame adapts at once
+        float initial[2] = { 0.0f, 1.0f };
+        for (int i = 0; i < 2; i++)
+        {
+            glGenTextures(1, &exposure[i]);
+            glState().bindTexture(GL_TEXTURE_2D, exposure[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, 1, 1, 0, GL_RG, GL_FLOAT, initial);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        if (gpuHistogram)
+        {
+            histogramShader = new Shader("luminanceHistogram.comp");
+            averageShader = new Shader("luminanceAverage.comp");
+            histogramShader->use();
+            histogramShader->setInt("hdrImage", 0);
+            vector<GLuint> zeros(256, 0);
+            glGenBuffers(1, &histogramBuffer);
+            glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, histogramBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, zeros.size() * sizeof(GLuint), &zeros[0], GL_DYNAMIC_COPY);
+        }
+        else
+        {
+            logShader = new Shader("blur.vs", "luminanceLog.frag");
+            adaptShader = new Shader("blur.vs", "luminanceAdapt.frag");
+            logShader->use();
+            logShader->setInt("hdrImage", 0);
+            adaptShader->use();
+            adaptShader->setInt("logLuminance", 0);
+            adaptShader->setInt("lastExposure", 1);
+            glGenTextures(1, &logLuminance);
+            glState().bindTexture(GL_TEXTURE_2D, logLuminance);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, LOG_LUMINANCE_SIZE, LOG_LUMINANCE_SIZE, 0, GL_RG, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glGenFramebuffers(1, &FBO);
+        }
+        glGenBuffers(READBACK_FRAMES, readbackBuffers);
+        for (unsigned int i = 0; i < READBACK_FRAMES; i++)
+        {
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, 2 * sizeof(float), NULL, GL_STREAM_READ);
+            fences[i] = 0;
+        }
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    ~AutoExposure()
+    {
+        delete histogramShader;
+        delete averageShader;
+        delete logShader;
+        delete adaptShader;
+        for (unsigned int i = 0; i < READBACK_FRAMES; i++)
+            if (fences[i])
+                glDeleteSync(fences[i]);
+    }
+
+    // the 1x1 RG32F texture holding this frame's adapted luminance and exposure
+    unsigned int exposureTexture() const
+    {
+        return exposure[current];
+    }
+
+    // measures hdrTexture (width x height, the HDR scene before tone mapping) and adapts towards it, deltaTime
+    // seconds after the last update. The fallback path uses its own framebuffer and viewport, so rebind yours
+    // afterwards.
+    void update(unsigned int hdrTexture, int width, int height, float deltaTime)
+    {
+        collectReadback();
+        float adaptation = 1.0f - std::exp(-std::max(deltaTime, 0.0f) * adaptationSpeed);
+        if (gpuHistogram)
+            updateHistogram(hdrTexture, width, height, adaptation);
+        else
+            updateMipmapped(hdrTexture, adaptation);
+        issueReadback();
+    }
+
+private:
+    Shader* histogramShader;
+    Shader* averageShader;
+    Shader* logShader;
+    Shader* adaptShader;
+    unsigned int histogramBuffer;
+    unsigned int logLuminance;
+    unsigned int FBO;
+    unsigned int exposure[2]; // the compute path updates exposure[0] in place, the fallback ping-pongs
+    unsigned int current;
+    unsigned int readbackBuffers[READBACK_FRAMES];
+    GLsync fences[READBACK_FRAMES];
+    unsigned int frame;
+
+    void updateHistogram(unsigned int hdrTexture, int width, int height, float adaptation)
+    {
+        float range = maxLogLuminance - minLogLuminance;
+        histogramShader->use();
+        histogramShader->setFloat("minLogLuminance", minLogLuminance);
+        histogramShader->setFloat("inverseLogLuminanceRange", 1.0f / range);
+        glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, hdrTexture);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, histogramBuffer);
+        glDispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        averageShader->use();
+        averageShader->setUint("pixelCount", (unsigned int)(width * height));
+        averageShader->setFloat("minLogLuminance", minLogLuminance);
+        averageShader->setFloat("logLuminanceRange", range);
+        averageShader->setFloat("adaptation", adaptation);
+        averageShader->setFloat("keyValue", keyValue);
+        glBindImageTexture(0, exposure[0], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+        glDispatchCompute(1, 1, 1);
+        // postprocess.frag fetches the exposure, issueReadback() copies it out with glGetTexImage
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT |
+                        GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void updateMipmapped(unsigned int hdrTexture, float adaptation)
+    {
+        glState().disable(GL_DEPTH_TEST);
+        glState().disable(GL_BLEND);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        // log luminance, averaged down to the 1x1 level
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, logLuminance, 0);
+        glState().viewport(0, 0, LOG_LUMINANCE_SIZE, LOG_LUMINANCE_SIZE);
+        logShader->use();
+        logShader->setFloat("minLogLuminance", minLogLuminance);
+        logShader->setFloat("maxLogLuminance", maxLogLuminance);
+        glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, hdrTexture);
+        Primitives::Quad().draw();
+        glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, logLuminance);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        // adapt from last frame's exposure into the other one
+        unsigned int next = 1 - current;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, exposure[next], 0);
+        glState().viewport(0, 0, 1, 1);
+        adaptShader->use();
+        adaptShader->setFloat("averageLevel", std::log2((float)LOG_LUMINANCE_SIZE));
+        adaptShader->setFloat("adaptation", adaptation);
+        adaptShader->setFloat("keyValue", keyValue);
+        adaptShader->setFloat("minLogLuminance", minLogLuminance);
+        glState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, exposure[current]);
+        Primitives::Quad().draw();
+        current = next;
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState().enable(GL_DEPTH_TEST);
+    }
+
+    // copies this frame's exposure into its pixel buffer and fences the copy
+    void issueReadback()
+    {
+        unsigned int slot = frame % READBACK_FRAMES;
+        if (fences[slot])
+        {
+            // never picked up (the GPU is more than READBACK_FRAMES frames behind), just reuse the buffer
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+        }
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[slot]);
+        // glGetTexImage reads the active unit, which an elided bind doesn't switch to
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, exposure[current]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, (void*)0);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        frame++;
+    }
+
+    // reads every finished copy, oldest first, without waiting for the ones still in flight
+    void collectReadback()
+    {
+        for (unsigned int i = 0; i < READBACK_FRAMES; i++)
+        {
+            unsigned int slot = (frame + i) % READBACK_FRAMES;
+            if (!fences[slot])
+                continue;
+            GLenum status = glClientWaitSync(fences[slot], 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                continue;
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[slot]);
+            float* values = (float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 2 * sizeof(float), GL_MAP_READ_BIT);
+            if (values)
+            {
+                readbackLuminance = values[0];
+                readbackExposure = values[1];
+                readbackAvailable = true;
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+};
+#endif
@@ -3,8 +3,13 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 projection;
-uniform mat4 view;
+// per-frame constants, written to the frame ring buffer once a frame (FrameConstants in glLearn.cpp)
+layout (std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec4 camPos; // xyz
+};
 
 out vec3 WorldPos;
 
@@ -0,0 +1,1332 @@
+
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// Headless benchmarks, run from the command line (glLearn --bench-cull, --bench-asteroids, --bench-occlusion, --bench-lights) before any window or GL context
+// is created. They only touch CPU-side code, so the numbers are comparable between machines without a GPU
+// in the loop.
+// The GPU benchmarks (glLearn --bench-ssao, --bench-bloom, --bench-post, --bench-aa,
+// --bench-temporal, --bench-dynres) run right after the GL context is made, rendering offscreen and timing
+// the passes with GpuTimer. Software rasterizers like llvmpipe draw lazily at the next flush, so there the
+// timestamps can't tell passes apart; only hardware numbers are meaningful per pass.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "culling.h"
+#include "asteroids.h"
+#include "workers.h"
+#include "softocclusion.h"
+#include "clusters.h"
+#include "pcg.h"
+#include "gbuffer.h"
+#include "ssao.h"
+#include "bloom.h"
+#include "postprocess.h"
+#include "antialiasing.h"
+#include "temporal.h"
+#include "dynamicresolution.h"
+#include "camera.h"
+#include "gputimer.h"
+#include "primitives.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// mesh count, triangle count and bounds of a model file, read with assimp only (no GL needed)
+struct ModelStats {
+    unsigned int meshes;
+    unsigned long long triangles;
+    BoundingSphere bounds;
+    bool loaded;
+};
+
+inline ModelStats loadModelStats(const string& path)
+{
+    ModelStats stats;
+    stats.meshes = 0;
+    stats.triangles = 0;
+    stats.loaded = false;
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        return stats;
+    AABB box;
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        const aiMesh* mesh = scene->mMeshes[m];
+        stats.triangles += mesh->mNumFaces;
+        for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+            box.add(glm::vec3(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z));
+    }
+    stats.meshes = scene->mNumMeshes;
+    stats.bounds = box.sphere();
+    stats.loaded = true;
+    return stats;
+}
+
+// the asteroid lesson's rock, or a unit-sized stand-in so the benchmarks run without the model
+inline ModelStats loadRockStats()
+{
+    ModelStats rock = loadModelStats("rock/rock.obj");
+    if (!rock.loaded)
+    {
+        cout << "rock/rock.obj not found, using a 1 mesh / 1280 triangle stand-in" << endl;
+        rock.meshes = 1;
+        rock.triangles = 1280;
+        rock.bounds = BoundingSphere(glm::vec3(0.0f), 1.0f);
+    }
+    return rock;
+}
+
+inline double elapsedMs(chrono::high_resolution_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// --bench-cull: frustum culls the 100000 rock asteroid field from cameras circling the ring and reports
+// the throughput of each culling kernel and how many draws and triangles culling saves
+inline int runCullBenchmark()
+{
+    const unsigned int amount = 100000;
+    const unsigned int views = 32;
+    const unsigned int repeats = 20;
+
+    ModelStats rock = loadRockStats();
+
+    AsteroidField field;
+    field.generate(amount, 150.0f, 25.0f, rock.bounds);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1000.0f / 800.0f, 0.1f, 1000.0f);
+    vector<Frustum> frustums;
+    for (unsigned int v = 0; v < views; v++)
+    {
+        // cameras just outside the ring, looking across it at the planet
+        float angle = (float)v / (float)views * 6.2831853f;
+        glm::vec3 eye(std::sin(angle) * 180.0f, 20.0f, std::cos(angle) * 180.0f);
+        frustums.push_back(Frustum(projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f))));
+    }
+
+    struct Kernel {
+        const char* name;
+        size_t (*cull)(const Frustum&, const SphereSet&, vector<uint32_t>&);
+    };
+    vector<Kernel> kernels;
+    kernels.push_back(Kernel{ "scalar", cullSpheresScalar });
+#ifdef CULLING_SSE
+    kernels.push_back(Kernel{ "sse", cullSpheresSSE });
+#endif
+#ifdef CULLING_AVX
+    kernels.push_back(Kernel{ "avx", cullSpheresAVX });
+#endif
+
+    // every kernel has to agree with the scalar reference
+    vector<uint32_t> reference, visible;
+    unsigned long long totalVisible = 0;
+    for (unsigned int v = 0; v < views; v++)
+    {
+        cullSpheresScalar(frustums[v], field.bounds, reference);
+        totalVisible += reference.size();
+        for (size_t k = 1; k < kernels.size(); k++)
+        {
+            kernels[k].cull(frustums[v], field.bounds, visible);
+            if (visible != reference)
+            {
+                cout << kernels[k].name << " kernel disagrees with the scalar kernel in view " << v << endl;
+                return 1;
+            }
+        }
+    }
+
+    cout << "frustum culling " << amount << " asteroids, " << views << " views x " << repeats << " repeats" << endl;
+    for (size_t k = 0; k < kernels.size(); k++)
+    {
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        for (unsigned int r = 0; r < repeats; r++)
+            for (unsigned int v = 0; v < views; v++)
+                kernels[k].cull(frustums[v], field.bounds, visible);
+        double ms = elapsedMs(start);
+        double perCall = ms / (repeats * views);
+        cout << "  " << kernels[k].name << ": " << perCall << " ms per cull, "
+             << (double)amount / perCall << " instances/ms" << endl;
+    }
+
+    double visibleAvg = (double)totalVisible / views;
+    double culledAvg = amount - visibleAvg;
+    cout << "  visible: " << visibleAvg << " of " << amount << " (" << 100.0 * visibleAvg / amount << "%)" << endl;
+    cout << "  draws saved (one per rock mesh without instancing): " << (unsigned long long)(culledAvg * rock.meshes)
+         << " of " << (unsigned long long)amount * rock.meshes << " per frame" << endl;
+    cout << "  triangles saved: " << (unsigned long long)(culledAvg * rock.triangles)
+         << " of " << (unsigned long long)amount * rock.triangles << " per frame" << endl;
+    return 0;
+}
+
+// --bench-asteroids: steps the 1000000 rock animated ring and reports the frame time of the scalar and SSE
+// kernels, then how the SSE kernel scales with the number of threads against a 2 ms per frame budget
+inline int runAsteroidBenchmark()
+{
+    const unsigned int amount = 1000000;
+    const unsigned int frames = 50;
+    const float dt = 1.0f / 60.0f;
+    const double budgetMs = 2.0;
+
+    vector<CompactInstance> instances(amount), reference(amount);
+    AsteroidSimulation simulation, check;
+    simulation.generate(amount, 150.0f, 25.0f);
+
+#ifdef CULLING_SSE
+    // the SSE kernel has to follow the scalar one (a few frames, the states drift apart only by rounding)
+    check = simulation;
+    for (unsigned int f = 0; f < 10; f++)
+    {
+        check.updateScalar(dt, &reference[0], 0, amount);
+        simulation.updateSSE(dt, &instances[0], 0, amount);
+    }
+    float maxError = 0.0f;
+    for (unsigned int i = 0; i < amount; i++)
+    {
+        glm::vec3 dp = glm::abs(instances[i].position - reference[i].position) / 175.0f;
+        glm::vec4 dq = glm::abs(instances[i].rotation - reference[i].rotation);
+        maxError = std::max(maxError, std::max(glm::max(dp.x, glm::max(dp.y, dp.z)), glm::max(glm::max(dq.x, dq.y), glm::max(dq.z, dq.w))));
+    }
+    if (maxError > 1e-4f)
+    {
+        cout << "sse kernel disagrees with the scalar kernel, max relative error " << maxError << endl;
+        return 1;
+    }
+#endif
+
+    cout << "simulating " << amount << " asteroids, " << frames << " frames" << endl;
+    struct Kernel {
+        const char* name;
+        void (AsteroidSimulation::*update)(float, CompactInstance*, size_t, size_t);
+    };
+    vector<Kernel> kernels;
+    kernels.push_back(Kernel{ "scalar", &AsteroidSimulation::updateScalar });
+#ifdef CULLING_SSE
+    kernels.push_back(Kernel{ "sse", &AsteroidSimulation::updateSSE });
+#endif
+    for (size_t k = 0; k < kernels.size(); k++)
+    {
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        for (unsigned int f = 0; f < frames; f++)
+            (simulation.*kernels[k].update)(dt, &instances[0], 0, amount);
+        cout << "  " << kernels[k].name << ", 1 thread: " << elapsedMs(start) / frames << " ms per frame" << endl;
+    }
+
+    unsigned int maxThreads = std::max(1u, thread::hardware_concurrency());
+    double singleThreadMs = 0.0;
+    for (unsigned int threads = 1; threads <= maxThreads; threads++)
+    {
+        WorkerPool pool(threads);
+        simulation.update(dt, &instances[0], pool); // wake the threads once before timing
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        for (unsigned int f = 0; f < frames; f++)
+            simulation.update(dt, &instances[0], pool);
+        double ms = elapsedMs(start) / frames;
+        if (threads == 1)
+            singleThreadMs = ms;
+        double speedup = singleThreadMs / ms;
+        cout << "  " << threads << (threads == 1 ? " thread:  " : " threads: ") << ms << " ms per frame, speedup " << speedup
+             << ", efficiency " << 100.0 * speedup / threads << "%" << (ms <= budgetMs ? "" : " (over the 2 ms budget)") << endl;
+    }
+    return 0;
+}
+
+// --bench-occlusion: rasterizes the planet into the 320x192 software depth buffer from cameras close to it,
+// tests the frustum culled rocks against it and reports raster and test times for 1..N threads. The culled
+// sets must not depend on the thread count, and no rock in front of the planet may be culled, nor one behind a
+// triangle crossing the near plane.
+inline int runOcclusionBenchmark()
+{
+    const unsigned int amount = 100000;
+    const unsigned int views = 32;
+    const unsigned int repeats = 10;
+
+    ModelStats rock = loadRockStats();
+    AsteroidField field;
+    field.generate(amount, 150.0f, 25.0f, rock.bounds);
+
+    // the planet as in the lesson, radius 4 around (0, -3, 0), stood in for by a 16x8 sphere
+    const glm::vec3 planetCenter(0.0f, -3.0f, 0.0f);
+    const float planetRadius = 4.0f;
+    Occluder planet = Occluder::Sphere(16, 8);
+    glm::mat4 planetModel = glm::scale(glm::translate(glm::mat4(1.0f), planetCenter), glm::vec3(planetRadius));
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1000.0f / 800.0f, 0.1f, 1000.0f);
+    vector<glm::vec3> eyes;
+    vector<glm::mat4> cameras;
+    for (unsigned int v = 0; v < views; v++)
+    {
+        // cameras close to the planet looking past it at the far side of the ring
+        float angle = (float)v / (float)views * 6.2831853f;
+        glm::vec3 eye(std::sin(angle) * 12.0f, 0.0f, std::cos(angle) * 12.0f);
+        eyes.push_back(eye);
+        cameras.push_back(projection * glm::lookAt(eye, planetCenter, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    OcclusionBuffer buffer;
+    unsigned int maxThreads = std::max(1u, thread::hardware_concurrency());
+    {
+        // a triangle straddling the near plane, its bottom edge between the camera and the near plane: the GPU
+        // clips that part away, so it must not hide the rock straight ahead that its clipped part covers
+        Occluder straddling;
+        straddling.vertices.push_back(glm::vec3(-1.0f, -1.0f, -0.05f));
+        straddling.vertices.push_back(glm::vec3(1.0f, -1.0f, -0.05f));
+        straddling.vertices.push_back(glm::vec3(0.0f, 1.0f, -0.12f));
+        straddling.indices.push_back(0);
+        straddling.indices.push_back(1);
+        straddling.indices.push_back(2);
+        WorkerPool pool(1);
+        buffer.begin(projection);
+        buffer.addOccluder(straddling, glm::mat4(1.0f));
+        buffer.rasterize(pool);
+        if (!buffer.visible(BoundingSphere(glm::vec3(0.0f, 0.0f, -5.0f), 0.2f)))
+        {
+            cout << "a rock behind a triangle crossing the near plane was culled" << endl;
+            return 1;
+        }
+    }
+    vector<vector<uint32_t>> reference(views);
+    unsigned long long frustumVisible = 0, occlusionVisible = 0;
+    cout << "software occlusion, " << amount << " asteroids behind a " << planet.indices.size() / 3 << " triangle planet, "
+         << buffer.width << "x" << buffer.height << ", " << views << " views x " << repeats << " repeats" << endl;
+    for (unsigned int threads = 1; threads <= maxThreads; threads++)
+    {
+        WorkerPool pool(threads);
+        double rasterMs = 0.0, testMs = 0.0;
+        vector<uint32_t> visible;
+        for (unsigned int v = 0; v < views; v++)
+        {
+            for (unsigned int r = 0; r < repeats; r++)
+            {
+                chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+                buffer.begin(cameras[v]);
+                buffer.addOccluder(planet, planetModel);
+                buffer.rasterize(pool);
+                rasterMs += elapsedMs(start);
+
+                cullSpheres(Frustum(cameras[v]), field.bounds, visible);
+                if (threads == 1 && r == 0)
+                    frustumVisible += visible.size();
+                start = chrono::high_resolution_clock::now();
+                buffer.cullSpheres(field.bounds, visible);
+                testMs += elapsedMs(start);
+            }
+            if (threads == 1)
+            {
+                reference[v] = visible;
+                occlusionVisible += visible.size();
+                // nothing nearer than the planet's closest point can be behind it
+                float planetDistance = glm::length(planetCenter - eyes[v]) - planetRadius;
+                vector<bool> kept(amount, false);
+                for (size_t i = 0; i < visible.size(); i++)
+                    kept[visible[i]] = true;
+                Frustum frustum(cameras[v]);
+                for (unsigned int i = 0; i < amount; i++)
+                {
+                    BoundingSphere sphere = field.bounds.get(i);
+                    if (!kept[i] && frustum.intersects(sphere) && glm::length(sphere.center - eyes[v]) + sphere.radius < planetDistance)
+                    {
+                        cout << "rock " << i << " in front of the planet was culled in view " << v << endl;
+                        return 1;
+                    }
+                }
+            }
+            else if (visible != reference[v])
+            {
+                cout << "culling with " << threads << " threads differs from 1 thread in view " << v << endl;
+                return 1;
+            }
+        }
+        double frames = (double)views * repeats;
+        cout << "  " << threads << (threads == 1 ? " thread:  " : " threads: ") << "raster " << rasterMs / frames << " ms, test "
+             << testMs / frames << " ms per frame" << endl;
+    }
+    cout << "  visible after frustum culling: " << frustumVisible / views << ", after occlusion culling: " << occlusionVisible / views
+         << " (" << 100.0 * (1.0 - (double)occlusionVisible / (double)std::max(1ull, frustumVisible)) << "% occluded)" << endl;
+    return 0;
+}
+
+// --bench-lights: clusters 32, 1000 and 10000 point lights spread through a 100 x 20 x 100 scene in front of the
+// camera and reports the build time for 1..N threads and how many lights a pixel loops over compared to looping
+// over all of them. Every light reaching a sample point must be in that point's cluster, and the lists must not
+// depend on the thread count or the ranges kernel.
+inline int runLightBenchmark()
+{
+    const unsigned int counts[] = { 32, 1000, 10000 };
+    const unsigned int frames = 50;
+    const unsigned int samples = 20000;
+
+    LightClusterGrid grid;
+    grid.setProjection(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 2.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 inverseView = glm::inverse(view);
+    unsigned int maxThreads = std::max(1u, thread::hardware_concurrency());
+    cout << "clustered lights, " << LightClusterGrid::TILES_X << "x" << LightClusterGrid::TILES_Y << "x" << LightClusterGrid::SLICES
+         << " clusters, " << frames << " frames" << endl;
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        unsigned int count = counts[c];
+        // about the same overlap at every count: the radius shrinks as the lights get denser
+        float radius = 10.0f * std::cbrt(32.0f / count);
+        PCG32 random(count);
+        vector<PointLight> lights;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            glm::vec3 position(random.range(-50.0f, 50.0f), random.range(-8.0f, 12.0f), random.range(-100.0f, 0.0f));
+            lights.push_back(PointLight(position, glm::vec3(1.0f), radius * random.range(0.5f, 1.5f)));
+        }
+        cout << "  " << count << " lights, radius " << radius << ":" << endl;
+
+        // the SSE kernel has to give exactly the scalar ranges
+        grid.build(lights, view);
+        vector<LightClusterGrid::LightRange> ranges = grid.ranges;
+        grid.computeRangesScalar(lights, view, 0, count);
+        if (memcmp(&ranges[0], &grid.ranges[0], count * sizeof(ranges[0])) != 0)
+        {
+            cout << "light ranges of the sse and scalar kernels differ" << endl;
+            return 1;
+        }
+
+        vector<uint32_t> referenceCells = grid.cells, referenceIndices = grid.indices;
+        double singleThreadMs = 0.0;
+        for (unsigned int threads = 1; threads <= maxThreads; threads++)
+        {
+            WorkerPool pool(threads);
+            grid.build(lights, view, pool);
+            chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+            for (unsigned int f = 0; f < frames; f++)
+                grid.build(lights, view, pool);
+            double ms = elapsedMs(start) / frames;
+            if (threads == 1)
+                singleThreadMs = ms;
+            if (grid.cells != referenceCells || grid.indices != referenceIndices)
+            {
+                cout << "clusters built with " << threads << " threads differ from 1 thread" << endl;
+                return 1;
+            }
+            cout << "    " << threads << (threads == 1 ? " thread:  " : " threads: ") << ms << " ms per build, speedup "
+                 << singleThreadMs / ms << endl;
+        }
+
+        // shading cost at random points of the view frustum (up to 60 units deep, where most of the scene is)
+        unsigned long long clustered = 0, reaching = 0;
+        for (unsigned int s = 0; s < samples; s++)
+        {
+            float depth = random.range(0.1f, 60.0f);
+            glm::vec3 viewPosition(random.range(-1.0f, 1.0f) * depth * std::tan(glm::radians(22.5f)) * 16.0f / 9.0f,
+                                   random.range(-1.0f, 1.0f) * depth * std::tan(glm::radians(22.5f)), -depth);
+            glm::vec3 world = glm::vec3(inverseView * glm::vec4(viewPosition, 1.0f));
+            unsigned int cluster = grid.clusterAt(viewPosition);
+            uint32_t first = grid.cells[2 * cluster], n = grid.cells[2 * cluster + 1];
+            clustered += n;
+            vector<bool> listed(count, false);
+            for (uint32_t i = 0; i < n; i++)
+                listed[grid.indices[first + i]] = true;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                if (glm::length(lights[i].position - world) >= lights[i].radius)
+                    continue;
+                reaching++;
+                if (!listed[i])
+                {
+                    cout << "light " << i << " reaches a point of cluster " << cluster << " but isn't listed in it" << endl;
+                    return 1;
+                }
+            }
+        }
+        cout << "    " << grid.visibleLights << " lights in the frustum, " << grid.indices.size() << " list entries, at most "
+             << grid.maxClusterLights << " per cluster" << endl;
+        cout << "    lights per pixel: " << (double)clustered / samples << " clustered (" << (double)reaching / samples
+             << " reach it) instead of " << count << endl;
+    }
+    return 0;
+}
+
+// runs the benchmark named on the command line, returns -1 when there is none
+inline int runBenchmarks(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bench-cull") == 0)
+            return runCullBenchmark();
+        if (strcmp(argv[i], "--bench-asteroids") == 0)
+            return runAsteroidBenchmark();
+        if (strcmp(argv[i], "--bench-occlusion") == 0)
+            return runOcclusionBenchmark();
+        if (strcmp(argv[i], "--bench-lights") == 0)
+            return runLightBenchmark();
+    }
+    return -1;
+}
+
+// draws the --bench-ssao scene with the geometry shader (ssaoGeometry.vs): a floor, a wall and rows of spheres
+// and boxes, close enough together to occlude each other
+inline void drawSSAOBenchmarkScene(Shader& shader)
+{
+    shader.use();
+    shader.setBool("invertedNormals", false);
+    shader.setMat4("model", glm::scale(glm::mat4(1.0f), glm::vec3(30.0f)));
+    Primitives::Plane().draw();
+    glm::mat4 wall = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -25.0f)), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    shader.setMat4("model", glm::scale(wall, glm::vec3(30.0f)));
+    Primitives::Plane().draw();
+    for (int z = 0; z < 6; z++)
+    {
+        for (int x = -5; x <= 5; x++)
+        {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x * 2.2f + (z & 1), 0.8f, -z * 3.5f - 2.0f));
+            model = glm::rotate(model, 0.3f * (x + z), glm::vec3(0.0f, 1.0f, 0.0f));
+            shader.setMat4("model", glm::scale(model, glm::vec3(0.8f)));
+            if ((x + z) & 1)
+                Primitives::Cube().draw();
+            else
+                Primitives::Sphere().draw();
+        }
+    }
+}
+
+// mean absolute difference of two R8 textures of width x height
+inline double meanOcclusionDifference(unsigned int a, unsigned int b, int width, int height)
+{
+    vector<unsigned char> first((size_t)width * height), second((size_t)width * height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // glGetTexImage reads the active unit, which an elided bind doesn't switch to
+    glState().activeTexture(GL_TEXTURE0);
+    glState().bindTexture(GL_TEXTURE_2D, a);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_UNSIGNED_BYTE, &first[0]);
+    glState().bindTexture(GL_TEXTURE_2D, b);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_UNSIGNED_BYTE, &second[0]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    double sum = 0.0;
+    for (size_t i = 0; i < first.size(); i++)
+        sum += std::abs((int)first[i] - (int)second[i]);
+    return sum / first.size() / 255.0;
+}
+
+// mean absolute difference of the rgb of two RGBA8 textures of width x height
+inline double meanColorDifference(unsigned int a, unsigned int b, int width, int height)
+{
+    vector<unsigned char> first((size_t)width * height * 4), second((size_t)width * height * 4);
+    glState().activeTexture(GL_TEXTURE0);
+    glState().bindTexture(GL_TEXTURE_2D, a);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &first[0]);
+    glState().bindTexture(GL_TEXTURE_2D, b);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &second[0]);
+    double sum = 0.0;
+    for (size_t i = 0; i < first.size(); i++)
+    {
+        if ((i & 3) != 3)
+            sum += std::abs((int)first[i] - (int)second[i]);
+    }
+    return sum / ((size_t)width * height * 3) / 255.0;
+}
+
+// --bench-ssao: times the SSAO passes at 1920x1080 and 3840x2160: the old full resolution path (ssao.frag with
+// 64 samples and a 4x4 noise texture, ssaoBlur.frag) against SSAO (ssao.h) at half resolution with 16 samples
+// and at quarter resolution with 8. The quality column is the mean absolute difference to the old result.
+inline int runSSAOBenchmark()
+{
+    const int sizes[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    const unsigned int frames = 20;
+    const unsigned int warmup = 4;
+
+    Shader geometryShader("ssaoGeometry.vs", "ssaoGeometry.frag");
+    Shader oldShader("ssao.vs", "ssao.frag");
+    Shader oldBlurShader("ssao.vs", "ssaoBlur.frag");
+    vector<glm::vec3> kernel = ssaoKernel(64);
+    oldShader.use();
+    for (unsigned int i = 0; i < 64; ++i)
+        oldShader.setVec3("samples[" + std::to_string(i) + "]", kernel[i]);
+    // the lesson's noise texture
+    std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+    std::default_random_engine generator;
+    vector<glm::vec3> noise;
+    for (unsigned int i = 0; i < 16; i++)
+        noise.push_back(glm::vec3(randomFloats(generator) * 2.0f - 1.0f, randomFloats(generator) * 2.0f - 1.0f, 0.0f));
+    unsigned int noiseTexture;
+    glGenTextures(1, &noiseTexture);
+    glState().bindTexture(GL_TEXTURE_2D, noiseTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 4, 4, 0, GL_RGB, GL_FLOAT, &noise[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    unsigned int FBO;
+    glGenFramebuffers(1, &FBO);
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 4.0f, 8.0f), glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    for (int s = 0; s < 2; s++)
+    {
+        int width = sizes[s][0], height = sizes[s][1];
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 50.0f);
+        GBuffer gBuffer(width, height, GBUFFER_COMPACT);
+        gBuffer.setLayout(geometryShader);
+        geometryShader.setMat4("projection", projection);
+        geometryShader.setMat4("view", view);
+        glState().enable(GL_DEPTH_TEST);
+        gBuffer.begin();
+        drawSSAOBenchmarkScene(geometryShader);
+
+        // the old path's targets, as in the SSAO lesson
+        unsigned int oldTargets[2];
+        glGenTextures(2, oldTargets);
+        for (int i = 0; i < 2; i++)
+        {
+            glState().bindTexture(GL_TEXTURE_2D, oldTargets[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+
+        cout << "ssao at " << width << "x" << height << ", " << frames << " frames" << endl;
+        GpuTimer timer;
+        glState().disable(GL_DEPTH_TEST);
+        for (unsigned int frame = 0; frame < frames + warmup; frame++)
+        {
+            if (frame == warmup)
+            {
+                timer.finish();
+                timer.reset();
+            }
+            timer.beginFrame();
+            glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+            glState().viewport(0, 0, width, height);
+            timer.begin("old occlusion");
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oldTargets[0], 0);
+            gBuffer.bind(oldShader, projection, view);
+            oldShader.setInt("texNoise", 3);
+            oldShader.setMat4("projection", projection);
+            oldShader.setVec2("noiseScale", width / 4.0f, height / 4.0f);
+            glState().bindTexture(GL_TEXTURE3, GL_TEXTURE_2D, noiseTexture);
+            Primitives::Quad().draw();
+            timer.end("old occlusion");
+            timer.begin("old blur");
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oldTargets[1], 0);
+            oldBlurShader.use();
+            oldBlurShader.setInt("ssaoInput", 0);
+            glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, oldTargets[0]);
+            Primitives::Quad().draw();
+            timer.end("old blur");
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        }
+        timer.finish();
+        cout << "  old path (full resolution, 64 samples)" << endl;
+        timer.print();
+        cout << "    total                   " << std::fixed << std::setprecision(3) << timer.average("old occlusion") + timer.average("old blur")
+             << " ms" << endl;
+        cout.unsetf(std::ios::fixed);
+
+        const int divisors[2] = { 2, 4 };
+        const int samples[2] = { 16, 8 };
+        for (int v = 0; v < 2; v++)
+        {
+            SSAO ssao(width, height, divisors[v], samples[v]);
+            GpuTimer newTimer;
+            for (unsigned int frame = 0; frame < frames + warmup; frame++)
+            {
+                if (frame == warmup)
+                {
+                    newTimer.finish();
+                    newTimer.reset();
+                }
+                newTimer.beginFrame();
+                ssao.compute(gBuffer, projection, view, &newTimer);
+            }
+            newTimer.finish();
+            const char* passes[4] = { "ssao downsample", "ssao occlusion", "ssao blur", "ssao upsample" };
+            double total = 0.0;
+            for (int p = 0; p < 4; p++)
+                total += newTimer.average(passes[p]);
+            cout << "  1/" << divisors[v] << " resolution, " << samples[v] << " samples" << endl;
+            newTimer.print();
+            cout << "    total                   " << std::fixed << std::setprecision(3) << total << " ms, mean difference to the old path "
+                 << meanOcclusionDifference(ssao.result, oldTargets[1], width, height) << endl;
+            cout.unsetf(std::ios::fixed);
+        }
+        glDeleteTextures(2, oldTargets);
+        glState().invalidate(); // the next size's textures can get their names while the cache still has them bound
+    }
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &noiseTexture);
+    return 0;
+}
+
+// --bench-bloom: times the bloom blur at 1920x1080 and 3840x2160: the lesson's 10 full resolution passes of
+// blur.frag between two RGBA16F targets against Bloom (bloom.h) with 6 levels, every level timed on its own.
+// The bright pass is a synthetic one, scattered hot pixels on black.
+inline int runBloomBenchmark()
+{
+    const int sizes[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    const unsigned int frames = 20;
+    const unsigned int warmup = 4;
+    const unsigned int blurPasses = 10;
+
+    Shader blurShader("blur.vs", "blur.frag");
+    blurShader.use();
+    blurShader.setInt("image", 0);
+    unsigned int FBO;
+    glGenFramebuffers(1, &FBO);
+    for (int s = 0; s < 2; s++)
+    {
+        int width = sizes[s][0], height = sizes[s][1];
+        vector<float> bright((size_t)width * height * 4, 0.0f);
+        PCG32 random(42);
+        for (int i = 0; i < width * height / 64; i++)
+        {
+            size_t texel = (size_t)(random.next() % (uint32_t)(width * height)) * 4;
+            bright[texel] = bright[texel + 1] = bright[texel + 2] = random.range(1.0f, 20.0f);
+        }
+        unsigned int targets[3];
+        glGenTextures(3, targets);
+        for (int i = 0; i < 3; i++)
+        {
+            glState().bindTexture(GL_TEXTURE_2D, targets[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, i == 0 ? &bright[0] : NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+
+        cout << "bloom at " << width << "x" << height << ", " << frames << " frames" << endl;
+        GpuTimer timer;
+        glState().disable(GL_DEPTH_TEST);
+        glState().disable(GL_BLEND);
+        for (unsigned int frame = 0; frame < frames + warmup; frame++)
+        {
+            if (frame == warmup)
+            {
+                timer.finish();
+                timer.reset();
+            }
+            timer.beginFrame();
+            glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+            glState().viewport(0, 0, width, height);
+            blurShader.use();
+            timer.begin("ping-pong blur");
+            bool horizontal = true;
+            for (unsigned int i = 0; i < blurPasses; i++)
+            {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets[1 + horizontal], 0);
+                blurShader.setInt("horizontal", horizontal);
+                glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, i == 0 ? targets[0] : targets[1 + !horizontal]);
+                Primitives::Quad().draw();
+                horizontal = !horizontal;
+            }
+            timer.end("ping-pong blur");
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        }
+        timer.finish();
+        // 9 fetches per pixel and pass
+        double oldFetches = (double)blurPasses * 9.0 * width * height;
+        cout << "  ping-pong blur (" << blurPasses << " full resolution passes)" << endl;
+        timer.print();
+        cout << "    " << oldFetches / 1e6 << "M texture fetches" << endl;
+
+        Bloom bloom(width, height, 6);
+        GpuTimer bloomTimer;
+        for (unsigned int frame = 0; frame < frames + warmup; frame++)
+        {
+            if (frame == warmup)
+            {
+                bloomTimer.finish();
+                bloomTimer.reset();
+            }
+            bloomTimer.beginFrame();
+            bloom.apply(targets[0], &bloomTimer);
+        }
+        bloomTimer.finish();
+        // 13 fetches per texel down, 9 up (into every level but the smallest)
+        double newFetches = 0.0, total = 0.0;
+        int levelWidth = width, levelHeight = height;
+        for (int i = 0; i < bloom.levelCount(); i++)
+        {
+            levelWidth /= 2;
+            levelHeight /= 2;
+            newFetches += 13.0 * levelWidth * levelHeight;
+            if (i + 1 < bloom.levelCount())
+                newFetches += 9.0 * levelWidth * levelHeight;
+            total += bloomTimer.average("bloom down " + std::to_string(i)) + bloomTimer.average("bloom up " + std::to_string(i));
+        }
+        cout << "  mip chain bloom (" << bloom.levelCount() << " levels)" << endl;
+        bloomTimer.print();
+        cout << "    total                   " << std::fixed << std::setprecision(3) << total << " ms, "
+             << newFetches / 1e6 << "M texture fetches" << endl;
+        cout.unsetf(std::ios::fixed);
+        glDeleteTextures(3, targets);
+        glState().invalidate();
+    }
+    glDeleteFramebuffers(1, &FBO);
+    return 0;
+}
+
+// --bench-post: times the post-processing of a 4x MSAA HDR frame at 1920x1080 and 3840x2160: the lessons' blit
+// into an intermediate framebuffer followed by bloomFinal.frag against the single pass of PostProcess
+// (postprocess.h), resolving before tone mapping like the blit and tone mapping every sample. All write RGBA8. Without MSAA the two must agree, which is checked as well.
+inline int runPostProcessBenchmark()
+{
+    const int sizes[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    const unsigned int frames = 20;
+    const unsigned int warmup = 4;
+    const int samples = 4;
+
+    Shader bloomFinalShader("bloomFinal.vs", "bloomFinal.frag");
+    bloomFinalShader.use();
+    bloomFinalShader.setInt("scene", 0);
+    bloomFinalShader.setInt("bloomBlur", 1);
+    bloomFinalShader.setBool("bloom", true);
+    bloomFinalShader.setFloat("exposure", 1.0f);
+    PostProcess post;
+    unsigned int FBOs[3];
+    glGenFramebuffers(3, FBOs);
+    for (int s = 0; s < 2; s++)
+    {
+        int width = sizes[s][0], height = sizes[s][1];
+        // scene: smooth gradients up to 8 with hard edged bright bars, bloom: a dim gradient
+        vector<float> scene((size_t)width * height * 4), bloomImage((size_t)width * height);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                float* texel = &scene[((size_t)y * width + x) * 4];
+                float bar = ((x / 64) % 4 == 0) ? 8.0f : 0.0f;
+                texel[0] = 2.0f * x / width + bar;
+                texel[1] = 2.0f * y / height;
+                texel[2] = 0.5f + bar * 0.5f;
+                texel[3] = 1.0f;
+                bloomImage[(size_t)y * width + x] = 0.2f * x / width;
+            }
+        }
+        unsigned int textures[5]; // scene, resolved scene, bloom, old output, new output
+        glGenTextures(5, textures);
+        for (int i = 0; i < 5; i++)
+        {
+            glState().bindTexture(GL_TEXTURE_2D, textures[i]);
+            if (i == 0)
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, &scene[0]);
+            else if (i == 1)
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+            else if (i == 2)
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RED, GL_FLOAT, &bloomImage[0]);
+            else
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        // the multisampled scene, filled by blitting the plain one into it (every sample gets the texel)
+        unsigned int multisampled;
+        glGenTextures(1, &multisampled);
+        glState().bindTexture(GL_TEXTURE_2D_MULTISAMPLE, multisampled);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_RGBA16F, width, height, GL_TRUE);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[0]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, multisampled, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[1]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[0], 0);
+        glState().bindFramebuffer(GL_READ_FRAMEBUFFER, FBOs[1]);
+        glState().bindFramebuffer(GL_DRAW_FRAMEBUFFER, FBOs[0]);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[1]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[1], 0);
+
+        cout << "post-processing at " << width << "x" << height << ", " << samples << "x MSAA, " << frames << " frames" << endl;
+        // every variant in its own run, so one can't be billed for the other's work
+        GpuTimer timers[3];
+        for (int variant = 0; variant < 3; variant++)
+        {
+            GpuTimer& timer = timers[variant];
+            post.toneMapSamples = variant == 2;
+            for (unsigned int frame = 0; frame < frames + warmup; frame++)
+            {
+                if (frame == warmup)
+                {
+                    timer.finish();
+                    timer.reset();
+                }
+                timer.beginFrame();
+                if (variant == 0)
+                {
+                    // the lessons: resolve, then composite + tone map + gamma
+                    timer.begin("resolve blit");
+                    glState().bindFramebuffer(GL_READ_FRAMEBUFFER, FBOs[0]);
+                    glState().bindFramebuffer(GL_DRAW_FRAMEBUFFER, FBOs[1]);
+                    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                    timer.end("resolve blit");
+                    timer.begin("bloomFinal");
+                    glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[2]);
+                    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[3], 0);
+                    glState().viewport(0, 0, width, height);
+                    glState().disable(GL_DEPTH_TEST);
+                    bloomFinalShader.use();
+                    glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, textures[1]);
+                    glState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, textures[2]);
+                    Primitives::Quad().draw();
+                    timer.end("bloomFinal");
+                }
+                else
+                {
+                    const char* name = variant == 1 ? "fused" : "fused, per sample";
+                    timer.begin(name);
+                    glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[2]);
+                    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[4], 0);
+                    post.apply(multisampled, textures[2], FBOs[2], width, height, samples);
+                    timer.end(name);
+                }
+            }
+            timer.finish();
+            timer.print();
+        }
+        cout << "    separate passes total   " << std::fixed << std::setprecision(3)
+             << timers[0].average("resolve blit") + timers[0].average("bloomFinal") << " ms" << endl;
+        cout.unsetf(std::ios::fixed);
+
+        // without MSAA both paths compute the same thing
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[2]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[3], 0);
+        bloomFinalShader.use();
+        glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, textures[0]);
+        glState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, textures[2]);
+        Primitives::Quad().draw();
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[4], 0);
+        post.toneMapSamples = false;
+        post.apply(textures[0], textures[2], FBOs[2], width, height);
+        vector<unsigned char> separate((size_t)width * height * 4), fused((size_t)width * height * 4);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, textures[3]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &separate[0]);
+        glState().bindTexture(GL_TEXTURE_2D, textures[4]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &fused[0]);
+        int largest = 0;
+        for (size_t i = 0; i < separate.size(); i++)
+            largest = std::max(largest, std::abs((int)separate[i] - (int)fused[i]));
+        cout << "  single sampled: fused and separate passes differ by at most " << largest << "/255" << endl;
+
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[0]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, 0, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[1]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[2]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteTextures(5, textures);
+        glDeleteTextures(1, &multisampled);
+        glState().invalidate();
+    }
+    glDeleteFramebuffers(3, FBOs);
+    return 0;
+}
+
+// --bench-aa: times a frame of the --bench-ssao scene (ssaoGeometry.vs, its view space positions as HDR color for
+// plenty of hard edges) at 1920x1080 and 3840x2160 with every mode of AntiAliasing (antialiasing.h): drawn into a
+// single sampled or a 4x multisampled RGBA16F target with a 24/8 depth-stencil buffer, tone mapped by PostProcess
+// and, for FXAA and SMAA, filtered afterwards. Memory is what the mode adds to the single sampled targets.
+inline int runAntiAliasingBenchmark()
+{
+    const int sizes[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    const unsigned int frames = 20;
+    const unsigned int warmup = 4;
+    const AntiAliasingMode modes[4] = { AA_NONE, AA_MSAA, AA_FXAA, AA_SMAA };
+    const char* names[4] = { "none", "4x MSAA", "FXAA", "SMAA 1x" };
+
+    Shader geometryShader("ssaoGeometry.vs", "ssaoGeometry.frag");
+    PostProcess post;
+    post.bloom = false;
+    post.exposure = 0.2f;
+    unsigned int FBOs[3]; // single sampled scene, multisampled scene, output
+    glGenFramebuffers(3, FBOs);
+    for (int s = 0; s < 2; s++)
+    {
+        int width = sizes[s][0], height = sizes[s][1];
+        unsigned int scene, multisampled, output, depth[2];
+        glGenTextures(1, &scene);
+        glState().bindTexture(GL_TEXTURE_2D, scene);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenTextures(1, &output);
+        glState().bindTexture(GL_TEXTURE_2D, output);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glGenTextures(1, &multisampled);
+        glState().bindTexture(GL_TEXTURE_2D_MULTISAMPLE, multisampled);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, AntiAliasing::MSAA_SAMPLES, GL_RGBA16F, width, height, GL_TRUE);
+        glGenRenderbuffers(2, depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth[1]);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, AntiAliasing::MSAA_SAMPLES, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[0]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scene, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth[0]);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[1]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, multisampled, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::FRAMEBUFFER:: Multisampled framebuffer is not complete!" << endl;
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[2]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, output, 0);
+
+        AntiAliasing aa(width, height);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 3.0f, 8.0f), glm::vec3(0.0f, 0.5f, -6.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        geometryShader.use();
+        geometryShader.setMat4("projection", projection);
+        geometryShader.setMat4("view", view);
+        geometryShader.setBool("compactGBuffer", false);
+
+        cout << "anti-aliasing at " << width << "x" << height << ", " << frames << " frames" << endl;
+        double totals[4];
+        for (int m = 0; m < 4; m++)
+        {
+            aa.mode = modes[m];
+            int samples = aa.sceneSamples();
+            GpuTimer timer;
+            for (unsigned int frame = 0; frame < frames + warmup; frame++)
+            {
+                if (frame == warmup)
+                {
+                    timer.finish();
+                    timer.reset();
+                }
+                timer.beginFrame();
+                timer.begin("frame");
+                timer.begin("scene");
+                glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[samples > 1 ? 1 : 0]);
+                glState().viewport(0, 0, width, height);
+                glState().enable(GL_DEPTH_TEST);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                drawSSAOBenchmarkScene(geometryShader);
+                timer.end("scene");
+                timer.begin("post");
+                post.apply(samples > 1 ? multisampled : scene, 0, aa.target(FBOs[2]), width, height, samples);
+                timer.end("post");
+                aa.apply(FBOs[2], &timer);
+                timer.end("frame");
+            }
+            timer.finish();
+            cout << "  " << names[m] << ", " << std::fixed << std::setprecision(1)
+                 << AntiAliasing::extraMemory(modes[m], width, height) / (1024.0 * 1024.0) << " MB more" << endl;
+            cout.unsetf(std::ios::fixed);
+            timer.print();
+            totals[m] = timer.average("frame");
+        }
+        cout << "  frame time relative to no anti-aliasing:" << std::fixed << std::setprecision(3);
+        for (int m = 1; m < 4; m++)
+            cout << " " << names[m] << " +" << totals[m] - totals[0] << " ms";
+        cout << endl;
+        cout.unsetf(std::ios::fixed);
+
+        for (int i = 0; i < 3; i++)
+        {
+            glState().bindFramebuffer(GL_FRAMEBUFFER, FBOs[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, i == 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, 0, 0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, 0);
+        }
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(2, depth);
+        glDeleteTextures(1, &scene);
+        glDeleteTextures(1, &multisampled);
+        glDeleteTextures(1, &output);
+        glState().invalidate();
+    }
+    glDeleteFramebuffers(3, FBOs);
+    return 0;
+}
+
+// --bench-temporal: times temporal SSAO at 1920x1080 and 3840x2160 on the --bench-ssao scene: SSAO (ssao.h) at
+// half resolution with 64 samples every frame against 8 samples that change every frame (SSAO::temporal) averaged
+// by TemporalAccumulation (temporal.h), and what the TemporalAA resolve costs on top. The quality columns are the
+// mean absolute difference to the 64 sample result after 1 to 16 frames of a still camera.
+inline int runTemporalBenchmark()
+{
+    const int sizes[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    const unsigned int frames = 20;
+    const unsigned int warmup = 4;
+
+    Shader geometryShader("ssaoGeometry.vs", "ssaoGeometry.frag");
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 4.0f, 8.0f), glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    for (int s = 0; s < 2; s++)
+    {
+        int width = sizes[s][0], height = sizes[s][1];
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 50.0f);
+        GBuffer gBuffer(width, height, GBUFFER_COMPACT, true);
+        gBuffer.setLayout(geometryShader);
+        geometryShader.setMat4("projection", projection);
+        geometryShader.setMat4("view", view);
+        gBuffer.setMotion(geometryShader, projection * view, projection * view);
+        glState().enable(GL_DEPTH_TEST);
+        gBuffer.begin();
+        drawSSAOBenchmarkScene(geometryShader);
+
+        cout << "temporal ssao at " << width << "x" << height << ", " << frames << " frames" << endl;
+        SSAO reference(width, height, 2, 64);
+        GpuTimer referenceTimer;
+        for (unsigned int frame = 0; frame < frames + warmup; frame++)
+        {
+            if (frame == warmup)
+            {
+                referenceTimer.finish();
+                referenceTimer.reset();
+            }
+            referenceTimer.beginFrame();
+            referenceTimer.begin("frame");
+            reference.compute(gBuffer, projection, view, &referenceTimer);
+            referenceTimer.end("frame");
+        }
+        referenceTimer.finish();
+        cout << "  64 samples every frame" << endl;
+        referenceTimer.print();
+
+        SSAO ssao(width, height, 2, 8);
+        ssao.temporal = true;
+        TemporalAccumulation accumulation(width, height);
+        TemporalAA taa(width, height);
+        GpuTimer timer;
+        for (unsigned int frame = 0; frame < frames + warmup; frame++)
+        {
+            if (frame == warmup)
+            {
+                timer.finish();
+                timer.reset();
+            }
+            timer.beginFrame();
+            timer.begin("frame");
+            ssao.compute(gBuffer, projection, view, &timer);
+            accumulation.apply(ssao.result, gBuffer.velocity, gBuffer.depth, projection, &timer);
+            timer.end("frame");
+            // the normals stand in for a lit scene
+            taa.apply(gBuffer.normal, gBuffer.velocity, gBuffer.depth, &timer);
+        }
+        timer.finish();
+        cout << "  8 samples, accumulated" << endl;
+        timer.print();
+
+        const unsigned int checkpoints[4] = { 1, 4, 8, 16 };
+        accumulation.reset();
+        cout << "  mean difference to 64 samples after" << std::fixed << std::setprecision(4);
+        for (unsigned int frame = 1, c = 0; c < 4; frame++)
+        {
+            ssao.compute(gBuffer, projection, view);
+            accumulation.apply(ssao.result, gBuffer.velocity, gBuffer.depth, projection);
+            if (frame == checkpoints[c])
+            {
+                cout << " " << frame << (frame == 1 ? " frame " : " frames ")
+                     << meanOcclusionDifference(accumulation.result, reference.result, width, height);
+                c++;
+            }
+        }
+        cout << endl;
+        cout.unsetf(std::ios::fixed);
+    }
+    return 0;
+}
+
+// draws the --bench-aa scene into gBuffer (classic, with velocity) with drawProjection, a jittered projection
+// or projection itself, and sets its normals, the stand-in for the HDR scene, to linear filtering
+inline void drawUpscaleBenchmarkScene(Shader& shader, GBuffer& gBuffer, const glm::mat4& view, const glm::mat4& projection,
+                                      const glm::mat4& drawProjection)
+{
+    gBuffer.setLayout(shader);
+    shader.setMat4("projection", drawProjection);
+    shader.setMat4("view", view);
+    gBuffer.setMotion(shader, projection * view, projection * view);
+    glState().enable(GL_DEPTH_TEST);
+    gBuffer.begin();
+    drawSSAOBenchmarkScene(shader);
+    glState().bindTexture(GL_TEXTURE_2D, gBuffer.normal);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// --bench-dynres: dynamic resolution (dynamicresolution.h) for a 1920x1080 window on the --bench-aa scene (its
+// classic G-buffer's normals stand in for the lit HDR scene), with SSAO at half the render resolution. First
+// the controller: the target is set to 60% of the frame time at full resolution and every change of scale is
+// printed as it settles; a frame as long on the CPU as on the GPU must not make it scale down. Then the
+// upscaling: PostProcess with each UpscaleFilter and TemporalAA (after 16 jittered frames) at scales 0.5 and
+// 0.75 against a 4x supersampled image, full resolution being the baseline.
+// Those passes are timed finished (glFinish before each end), so even llvmpipe's numbers are theirs.
+inline int runDynamicResolutionBenchmark()
+{
+    const int width = 1920, height = 1080;
+    const unsigned int frames = 60;
+
+    Shader geometryShader("ssaoGeometry.vs", "ssaoGeometry.frag");
+    PostProcess post;
+    post.bloom = false;
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 3.0f, 8.0f), glm::vec3(0.0f, 0.5f, -6.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    unsigned int FBO, output, reference;
+    glGenFramebuffers(1, &FBO);
+    unsigned int* targets[2] = { &output, &reference };
+    for (int i = 0; i < 2; i++)
+    {
+        glGenTextures(1, targets[i]);
+        glState().bindTexture(GL_TEXTURE_2D, *targets[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, output, 0);
+
+
+    {
+        cout << "dynamic resolution at " << width << "x" << height << ", " << frames << " frames" << endl;
+        DynamicResolution resolution(width, height);
+        GBuffer gBuffer(width, height, GBUFFER_CLASSIC, true);
+        SSAO ssao(width, height, 2, 16);
+        GpuTimer timer;
+        for (unsigned int frame = 0; frame < frames + 8; frame++)
+        {
+            timer.beginFrame();
+            if (frame == 8)
+            {
+                // full resolution measured, now hold the frame to 60% of it
+                timer.finish();
+                resolution.targetMilliseconds = 0.6f * (float)timer.average("frame");
+                cout << "  full resolution " << std::fixed << std::setprecision(3) << timer.average("frame") << " ms, target "
+                     << resolution.targetMilliseconds << " ms" << endl;
+                cout.unsetf(std::ios::fixed);
+            }
+            if (frame >= 8 && resolution.update(timer.last("frame")))
+            {
+                gBuffer.resize(resolution.renderWidth, resolution.renderHeight);
+                ssao.resize(resolution.renderWidth, resolution.renderHeight);
+                cout << "  frame " << frame - 8 << ": scale " << resolution.scale << ", " << resolution.renderWidth << "x" << resolution.renderHeight
+                     << ", last " << std::fixed << std::setprecision(3) << timer.last("frame") << " ms" << endl;
+                cout.unsetf(std::ios::fixed);
+            }
+            glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)gBuffer.width / gBuffer.height, 0.1f, 100.0f);
+            timer.begin("frame");
+            drawUpscaleBenchmarkScene(geometryShader, gBuffer, view, projection, projection);
+            ssao.compute(gBuffer, projection, view);
+            post.apply(gBuffer.normal, 0, FBO, width, height);
+            timer.end("frame");
+        }
+        timer.finish();
+        cout << "  settled at scale " << resolution.scale << ", last frame " << std::fixed << std::setprecision(3) << timer.last("frame") << " ms"
+             << endl;
+        cout.unsetf(std::ios::fixed);
+
+        // CPU-bound: the GPU time only follows the CPU's, a lower resolution would save nothing
+        DynamicResolution cpuBound(width, height, 10.0f), gpuBound(width, height, 10.0f);
+        bool gpuBoundScaled = false;
+        for (unsigned int frame = 0; frame < frames; frame++)
+        {
+            gpuBoundScaled |= gpuBound.update(20.0, 5.0);
+            if (cpuBound.update(20.0, 20.0))
+            {
+                cout << "  scaled down a CPU-bound frame" << endl;
+                return 1;
+            }
+        }
+        if (!gpuBoundScaled)
+        {
+            cout << "  didn't scale down a GPU-bound frame" << endl;
+            return 1;
+        }
+    }
+
+    // the reference, 2x2 texels a pixel averaged by the bilinear filter
+    {
+        GBuffer gBuffer(width * 2, height * 2, GBUFFER_CLASSIC, true);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+        drawUpscaleBenchmarkScene(geometryShader, gBuffer, view, projection, projection);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reference, 0);
+        post.upscale = UPSCALE_BILINEAR;
+        post.apply(gBuffer.normal, 0, FBO, width, height);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, output, 0);
+    }
+    const float scales[3] = { 1.0f, 0.75f, 0.5f };
+    const char* filters[2] = { "bilinear", "edge adaptive" };
+    cout << "upscaling to " << width << "x" << height << ", mean difference to 4x supersampling" << endl;
+    for (int s = 0; s < 3; s++)
+    {
+        int renderWidth = (int)(width * scales[s] + 0.5f), renderHeight = (int)(height * scales[s] + 0.5f);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)renderWidth / renderHeight, 0.1f, 100.0f);
+        GBuffer gBuffer(renderWidth, renderHeight, GBUFFER_CLASSIC, true);
+        drawUpscaleBenchmarkScene(geometryShader, gBuffer, view, projection, projection);
+        cout << "  scale " << scales[s] << ", " << renderWidth << "x" << renderHeight << endl;
+        for (int f = 0; f < (s == 0 ? 1 : 2); f++)
+        {
+            post.upscale = (UpscaleFilter)f;
+            glFinish(); // the scene isn't part of it
+            GpuTimer timer;
+            for (unsigned int frame = 0; frame < 8; frame++)
+            {
+                timer.beginFrame();
+                timer.begin("post");
+                post.apply(gBuffer.normal, 0, FBO, width, height);
+                glFinish(); // so llvmpipe has drawn it by the end timestamp
+                timer.end("post");
+            }
+            timer.finish();
+            cout << "    " << std::left << std::setw(16) << (s == 0 ? "none" : filters[f]) << std::right << std::fixed << std::setprecision(3)
+                 << timer.average("post") << " ms, " << std::setprecision(5) << meanColorDifference(output, reference, width, height) << endl;
+            cout.unsetf(std::ios::fixed);
+        }
+
+        TemporalAA taa(width, height);
+        Camera camera;
+        camera.Jitter = true;
+        GpuTimer timer;
+        for (unsigned int frame = 0; frame < 16; frame++)
+        {
+            drawUpscaleBenchmarkScene(geometryShader, gBuffer, view, projection, camera.GetJitteredProjection(projection, renderWidth, renderHeight));
+            timer.beginFrame();
+            taa.jitter = camera.GetJitter();
+            glFinish();
+            timer.begin("taa");
+            taa.apply(gBuffer.normal, gBuffer.velocity, gBuffer.depth);
+            glFinish();
+            timer.end("taa");
+            camera.NextJitter();
+        }
+        timer.finish();
+        post.apply(taa.result, 0, FBO, width, height);
+        cout << "    " << std::left << std::setw(16) << "taa" << std::right << std::fixed << std::setprecision(3) << timer.average("taa")
+             << " ms, " << std::setprecision(5) << meanColorDifference(output, reference, width, height) << endl;
+        cout.unsetf(std::ios::fixed);
+    }
+
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &output);
+    glDeleteTextures(1, &reference);
+    glState().invalidate();
+    return 0;
+}
+
+// runs the GPU benchmark named on the command line (the GL context must be current), returns -1 when there is none
+inline int runGpuBenchmarks(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bench-ssao") == 0)
+            return runSSAOBenchmark();
+        if (strcmp(argv[i], "--bench-bloom") == 0)
+            return runBloomBenchmark();
+        if (strcmp(argv[i], "--bench-post") == 0)
+            return runPostProcessBenchmark();
+        if (strcmp(argv[i], "--bench-aa") == 0)
+            return runAntiAliasingBenchmark();
+        if (strcmp(argv[i], "--bench-temporal") == 0)
+            return runTemporalBenchmark();
+        if (strcmp(argv[i], "--bench-dynres") == 0)
+            return runDynamicResolutionBenchmark();
+    }
+    return -1;
+}
+#endif
@@ -0,0 +1,160 @@
+
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "shader.h"
+#include "glstate.h"
+#include "primitives.h"
+#include "gputimer.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Progressive bloom over a chain of ever smaller textures, instead of blurring the bright pass at full
+// resolution.
+//
+// apply() downsamples the bright pass into levels of 1/2, 1/4, ... of the screen with the 13 tap filter of
+// bloomDownsample.frag (a Karis average on the first level, so single hot pixels don't flicker), then walks back
+// up: every level gets the next smaller one added with the 3x3 tent of bloomUpsample.frag. Both filters sample
+// between texels, so each bilinear fetch averages 4 of them. result ends up holding the sum of all levels at half
+// resolution: a blur as wide as the smallest level for a few percent of the work of the full resolution
+// ping-pong blur. The levels sum up, so the result is brighter than that blur; bloomFinal.frag scales it by
+// bloomStrength (1 / levels keeps the overall brightness).
+// The levels are R11F_G11F_B10F, bloom has no use for alpha or half float precision.
+class Bloom
+{
+public:
+    static const int MAX_LEVELS = 8;
+
+    float filterRadius;  // of the upsampling tent, in texels of the smaller level
+    unsigned int result; // level 0, half the screen resolution; filter it linearly when compositing
+    int width, height;   // of the screen
+
+    Bloom(int screenWidth, int screenHeight, int levelCount = 6)
+        : filterRadius(1.0f), result(0), width(0), height(0), requestedLevels(levelCount),
+          downsampleShader("blur.vs", "bloomDownsample.frag"), upsampleShader("blur.vs", "bloomUpsample.frag")
+    {
+        glGenFramebuffers(1, &FBO);
+        downsampleShader.use();
+        downsampleShader.setInt("srcTexture", 0);
+        upsampleShader.use();
+        upsampleShader.setInt("srcTexture", 0);
+        resize(screenWidth, screenHeight);
+    }
+
+    // reallocates the levels for a new screen size; levels stop early where they would get smaller than 1 texel
+    void resize(int screenWidth, int screenHeight)
+    {
+        if (screenWidth == width && screenHeight == height && !levels.empty())
+            return;
+        width = std::max(1, screenWidth);
+        height = std::max(1, screenHeight);
+        release();
+        int levelWidth = width, levelHeight = height;
+        for (int i = 0; i < std::min(requestedLevels, (int)MAX_LEVELS); i++)
+        {
+            if (levelWidth < 2 || levelHeight < 2)
+                break;
+            levelWidth /= 2;
+            levelHeight /= 2;
+            Level level;
+            level.width = levelWidth;
+            level.height = levelHeight;
+            glGenTextures(1, &level.texture);
+            glState().bindTexture(GL_TEXTURE_2D, level.texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, levelWidth, levelHeight, 0, GL_RGB, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            levels.push_back(level);
+        }
+        result = levels.empty() ? 0 : levels[0].texture;
+    }
+
+    int levelCount() const
+    {
+        return (int)levels.size();
+    }
+
+    // blooms brightTexture (the bright pass, screen sized and linearly filtered). Uses its own framebuffer and
+    // viewport, so rebind yours afterwards. With a timer every level is timed as "bloom down <level>" and
+    // "bloom up <level>".
+    void apply(unsigned int brightTexture, GpuTimer* timer = 0)
+    {
+        if (levels.empty())
+            return;
+        glState().disable(GL_DEPTH_TEST);
+        glState().disable(GL_BLEND);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        // 1. down the chain, every level filtered from the one above it
+        downsampleShader.use();
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            string name = "bloom down " + std::to_string(i);
+            if (timer)
+                timer->begin(name);
+            downsampleShader.setBool("karisAverage", i == 0);
+            glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, i == 0 ? brightTexture : levels[i - 1].texture);
+            draw(levels[i]);
+            if (timer)
+                timer->end(name);
+        }
+
+        // 2. back up, adding every level to the next larger one
+        upsampleShader.use();
+        upsampleShader.setFloat("filterRadius", filterRadius);
+        glState().enable(GL_BLEND);
+        glState().blendFunc(GL_ONE, GL_ONE);
+        for (size_t i = levels.size() - 1; i > 0; i--)
+        {
+            string name = "bloom up " + std::to_string(i - 1);
+            if (timer)
+                timer->begin(name);
+            glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, levels[i].texture);
+            draw(levels[i - 1]);
+            if (timer)
+                timer->end(name);
+        }
+        glState().disable(GL_BLEND);
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState().enable(GL_DEPTH_TEST);
+    }
+
+private:
+    struct Level {
+        unsigned int texture;
+        int width, height;
+    };
+
+    vector<Level> levels;
+    int requestedLevels;
+    unsigned int FBO;
+    Shader downsampleShader, upsampleShader;
+
+    void draw(const Level& level)
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, level.texture, 0);
+        glState().viewport(0, 0, level.width, level.height);
+        Primitives::Quad().draw();
+    }
+
+    void release()
+    {
+        for (size_t i = 0; i < levels.size(); i++)
+            glDeleteTextures(1, &levels[i].texture);
+        if (!levels.empty())
+            glState().invalidate(); // some of them may still be bound
+        levels.clear();
+        result = 0;
+    }
+};
+#endif
@@ -0,0 +1,70 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture; // the next larger level (or the bright pass)
+uniform bool karisAverage;    // for the first level: weighs the 5 boxes down by their brightness against fireflies
+
+float luma(vec3 c)
+{
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// the box average weighted by 1 / (1 + luma), so a single very bright texel can't dominate its box
+vec3 karis(vec3 box, float weight, inout float total)
+{
+    float w = weight / (1.0 + luma(box));
+    total += w;
+    return box * w;
+}
+
+// 13 tap downsample filter (Jimenez, Next Generation Post Processing in Call of Duty: Advanced Warfare):
+// the taps sit on the corners of source texels, so each bilinear fetch averages 4 of them and the 13 fetches
+// cover a 6x6 texel footprint as 5 overlapping 4x4 boxes
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(srcTexture, 0));
+    float x = texel.x;
+    float y = texel.y;
+
+    // a - b - c
+    // - j - k -
+    // d - e - f
+    // - l - m -
+    // g - h - i
+    vec3 a = texture(srcTexture, TexCoords + vec2(-2.0 * x,  2.0 * y)).rgb;
+    vec3 b = texture(srcTexture, TexCoords + vec2( 0.0,      2.0 * y)).rgb;
+    vec3 c = texture(srcTexture, TexCoords + vec2( 2.0 * x,  2.0 * y)).rgb;
+    vec3 d = texture(srcTexture, TexCoords + vec2(-2.0 * x,  0.0)).rgb;
+    vec3 e = texture(srcTexture, TexCoords).rgb;
+    vec3 f = texture(srcTexture, TexCoords + vec2( 2.0 * x,  0.0)).rgb;
+    vec3 g = texture(srcTexture, TexCoords + vec2(-2.0 * x, -2.0 * y)).rgb;
+    vec3 h = texture(srcTexture, TexCoords + vec2( 0.0,     -2.0 * y)).rgb;
+    vec3 i = texture(srcTexture, TexCoords + vec2( 2.0 * x, -2.0 * y)).rgb;
+    vec3 j = texture(srcTexture, TexCoords + vec2(-x,  y)).rgb;
+    vec3 k = texture(srcTexture, TexCoords + vec2( x,  y)).rgb;
+    vec3 l = texture(srcTexture, TexCoords + vec2(-x, -y)).rgb;
+    vec3 m = texture(srcTexture, TexCoords + vec2( x, -y)).rgb;
+
+    vec3 result;
+    if (karisAverage)
+    {
+        float total = 0.0;
+        result  = karis((a + b + d + e) * 0.25, 0.125, total);
+        result += karis((b + c + e + f) * 0.25, 0.125, total);
+        result += karis((d + e + g + h) * 0.25, 0.125, total);
+        result += karis((e + f + h + i) * 0.25, 0.125, total);
+        result += karis((j + k + l + m) * 0.25, 0.5, total);
+        result /= total;
+    }
+    else
+    {
+        // the same 5 boxes with weights 0.125, 0.125, 0.125, 0.125, 0.5 folded into the taps
+        result  = e * 0.125;
+        result += (a + c + g + i) * 0.03125;
+        result += (b + d + f + h) * 0.0625;
+        result += (j + k + l + m) * 0.125;
+    }
+    FragColor = vec4(max(result, vec3(0.0001)), 1.0);
+}
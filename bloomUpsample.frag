@@ -0,0 +1,34 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture; // the next smaller level, already holding everything below it
+uniform float filterRadius;   // of the tent, in source texels
+
+// 3x3 tent filter, added to the level below with additive blending (Jimenez, Next Generation Post Processing in
+// Call of Duty: Advanced Warfare). With bilinear fetches between texels it covers 4x4 source texels in 9 taps.
+void main()
+{
+    vec2 offset = filterRadius / vec2(textureSize(srcTexture, 0));
+    float x = offset.x;
+    float y = offset.y;
+
+    // a - b - c
+    // d - e - f
+    // g - h - i
+    vec3 a = texture(srcTexture, TexCoords + vec2(-x,  y)).rgb;
+    vec3 b = texture(srcTexture, TexCoords + vec2( 0.0, y)).rgb;
+    vec3 c = texture(srcTexture, TexCoords + vec2( x,  y)).rgb;
+    vec3 d = texture(srcTexture, TexCoords + vec2(-x,  0.0)).rgb;
+    vec3 e = texture(srcTexture, TexCoords).rgb;
+    vec3 f = texture(srcTexture, TexCoords + vec2( x,  0.0)).rgb;
+    vec3 g = texture(srcTexture, TexCoords + vec2(-x, -y)).rgb;
+    vec3 h = texture(srcTexture, TexCoords + vec2( 0.0, -y)).rgb;
+    vec3 i = texture(srcTexture, TexCoords + vec2( x, -y)).rgb;
+
+    vec3 result = e * 4.0;
+    result += (b + d + f + h) * 2.0;
+    result += (a + c + g + i);
+    FragColor = vec4(result * (1.0 / 16.0), 1.0);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor;
+
+// occlusion query proxy, only the depth test matters (color writes are off)
+void main()
+{
+    FragColor = vec4(1.0);
+}
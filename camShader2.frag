@@ -19,6 +19,10 @@ uniform sampler2D normalMap;
 
 uniform float far_plane;
 uniform bool shadows;
+// temporal filtering, for TemporalAA (temporal.h) to converge: only shadowSamples of the 20 offsets per frame
+// (0 for all of them), a different run of them every temporalFrame
+uniform int shadowSamples;
+uniform int temporalFrame;
 //                                                                 render without passing as many samples since is expenisve.
 // make hte pcf alogrithm to take fix ed maount of samples from sampleOffsetDirections and use it on the cubemap, which saves us samples
 // brings back same r esults if not better more performant
@@ -69,12 +73,13 @@ float ShadowCalculation(vec3 fragPos)
     // shadow /= (samples * samples * samples);
     float shadow = 0.0;
     float bias = 0.15;
-    int samples = 20;
+    int samples = shadowSamples > 0 ? min(shadowSamples, 20) : 20;
+    int first = (temporalFrame * samples) % 20;
     float viewDistance = length(viewPos - fragPos);
     float diskRadius = (1.0 + (viewDistance / far_plane)) / 25.0;
     for(int i = 0; i < samples; ++i)
     {
-        float closestDepth = texture(depthMap, fragToLight + gridSamplingDisk[i] * diskRadius).r;
+        float closestDepth = texture(depthMap, fragToLight + gridSamplingDisk[(first + i) % 20] * diskRadius).r;
         closestDepth *= far_plane;   // undo mapping [0;1]
         if(currentDepth - bias > closestDepth)
             shadow += 1.0;
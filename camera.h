@@ -21,6 +21,22 @@ const float PITCH = 0.0f;
 const float SPEED = 2.5f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
+const unsigned int JITTER_LENGTH = 8;
+
+// element index (from 1) of the Halton sequence in base, in [0, 1): low discrepancy, so any run of consecutive
+// elements covers the interval evenly
+inline float halton(unsigned int index, unsigned int base)
+{
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0)
+    {
+        fraction /= base;
+        result += fraction * (index % base);
+        index /= base;
+    }
+    return result;
+}
 
 
 // An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
@@ -40,9 +56,12 @@ public:
     float MovementSpeed;
     float MouseSensitivity;
     float Zoom;
+    // sub-pixel jitter of the projection for temporal anti-aliasing (temporal.h)
+    bool Jitter;
+    unsigned int JitterFrame;
 
     // constructor with vectors
-    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM), Jitter(false), JitterFrame(0)
     {
         Position = position;
         WorldUp = up;
@@ -51,7 +70,7 @@ public:
         updateCameraVectors();
     }
     // constructor with scalar values
-    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM), Jitter(false), JitterFrame(0)
     {
         Position = glm::vec3(posX, posY, posZ);
         WorldUp = glm::vec3(upX, upY, upZ);
@@ -67,6 +86,32 @@ public:
         return inLookAt(Position, Position + Front, Up);
     }
 
+    // this frame's sub-pixel offset in pixels, in [-0.5, 0.5): the Halton (2, 3) sequence repeating every
+    // JITTER_LENGTH frames, 0 without Jitter
+    glm::vec2 GetJitter() const
+    {
+        if (!Jitter)
+            return glm::vec2(0.0f);
+        unsigned int index = JitterFrame % JITTER_LENGTH + 1;
+        return glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f;
+    }
+
+    // projection shifted by GetJitter() for a width x height target. Draw with it, but keep the unjittered one
+    // for velocities and reprojection.
+    glm::mat4 GetJitteredProjection(glm::mat4 projection, int width, int height) const
+    {
+        glm::vec2 jitter = GetJitter();
+        // a translation in ndc, one pixel is 2 / size there
+        glm::mat4 offset = glm::translate(glm::mat4(1.0f), glm::vec3(jitter.x * 2.0f / width, jitter.y * 2.0f / height, 0.0f));
+        return offset * projection;
+    }
+
+    // steps the jitter sequence, once per frame
+    void NextJitter()
+    {
+        JitterFrame++;
+    }
+
     //practice question to replace builtin glm::lookAt with our own built one:
     glm::mat4 inLookAt(const glm::vec3 pos, glm::vec3 target, glm::vec3 up) {
         glm::vec3 zaxis = glm::normalize(pos - target);
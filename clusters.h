@@ -0,0 +1,434 @@
+
+
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "glstate.h"
+#include "culling.h"
+#include "workers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// A point light as the clustered shaders read it: 48 bytes, three RGBA32F texels of the light buffer texture.
+struct PointLight {
+    glm::vec3 position;
+    float radius;    // no light beyond this distance, which is what clustering culls with
+    glm::vec3 color;
+    float linear;    // attenuation 1 / (1 + linear d + quadratic d^2) of the Blinn-Phong deferred pass,
+    float quadratic; // the PBR shader uses 1 / d^2 windowed to 0 at the radius instead
+    float padding[3];
+
+    PointLight() : position(0.0f), radius(1.0f), color(1.0f), linear(0.0f), quadratic(0.0f)
+    {
+        padding[0] = padding[1] = padding[2] = 0.0f;
+    }
+    PointLight(const glm::vec3& p, const glm::vec3& c, float r, float l = 0.0f, float q = 0.0f)
+        : position(p), radius(r), color(c), linear(l), quadratic(q)
+    {
+        padding[0] = padding[1] = padding[2] = 0.0f;
+    }
+};
+
+// Light culling for a perspective camera: the view frustum is cut into TILES_X x TILES_Y screen tiles and
+// SLICES depth slices (exponentially spaced, so clusters stay roughly cube shaped), and every light is listed
+// in each cluster its sphere may touch. A pixel then only shades the lights of its own cluster.
+//
+// Built on the CPU in two steps: each light's view space sphere is turned into a range of tiles and slices
+// (4 lights at a time with SSE, split across the worker threads), then each thread fills the clusters of its
+// slices. The result is one compact list: cells holds (first index, count) per cluster and indices the light
+// indices, cluster after cluster. The pure CPU part lives here so the benchmark can run it without a GL context;
+// ClusteredLights uploads it for the shaders.
+class LightClusterGrid
+{
+public:
+    static const unsigned int TILES_X = 16;
+    static const unsigned int TILES_Y = 9;
+    static const unsigned int SLICES = 24;
+    static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+    vector<uint32_t> cells;   // per cluster (x fastest, then y, then slice): first index, light count
+    vector<uint32_t> indices; // light indices of all clusters
+
+    // per light, the range of clusters it may touch; empty (z0 > z1) when it is outside the frustum
+    struct LightRange {
+        uint8_t x0, x1, y0, y1, z0, z1;
+    };
+    vector<LightRange> ranges;
+
+    // statistics of the last build
+    size_t visibleLights;       // lights touching the frustum
+    uint32_t maxClusterLights;  // longest list of a single cluster
+
+    LightClusterGrid() : visibleLights(0), maxClusterLights(0)
+    {
+        setProjection(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        cells.assign(2 * CLUSTER_COUNT, 0);
+        sliceIndices.resize(SLICES);
+        sliceLights.resize(SLICES);
+    }
+
+    // the camera the clusters are built for, as in glm::perspective
+    void setProjection(float fovy, float aspect, float near, float far)
+    {
+        nearPlane = near;
+        farPlane = far;
+        tanHalfY = std::tan(fovy * 0.5f);
+        tanHalfX = tanHalfY * aspect;
+        sliceScale = SLICES / std::log(far / near);
+        sliceBias = -std::log(near) * sliceScale;
+        // the planes between tiles go through the eye: a point is right of boundary k when x + z * a > 0
+        for (unsigned int k = 0; k <= TILES_X; k++)
+            boundaryPlane(-1.0f + 2.0f * k / TILES_X, tanHalfX, boundaryX[k], boundaryNormX[k]);
+        for (unsigned int k = 0; k <= TILES_Y; k++)
+            boundaryPlane(-1.0f + 2.0f * k / TILES_Y, tanHalfY, boundaryY[k], boundaryNormY[k]);
+    }
+
+    // slice = log(view depth) * sliceScale + sliceBias, the same formula the shaders use
+    float getSliceScale() const
+    {
+        return sliceScale;
+    }
+    float getSliceBias() const
+    {
+        return sliceBias;
+    }
+
+    unsigned int slice(float depth) const
+    {
+        float s = std::floor(std::log(std::max(depth, nearPlane)) * sliceScale + sliceBias);
+        return (unsigned int)std::min(std::max(s, 0.0f), (float)(SLICES - 1));
+    }
+    static unsigned int cluster(unsigned int x, unsigned int y, unsigned int z)
+    {
+        return (z * TILES_Y + y) * TILES_X + x;
+    }
+    // the cluster of a view space point in front of the camera
+    unsigned int clusterAt(const glm::vec3& viewPosition) const
+    {
+        float depth = -viewPosition.z;
+        float ndcX = viewPosition.x / (depth * tanHalfX), ndcY = viewPosition.y / (depth * tanHalfY);
+        unsigned int x = (unsigned int)std::min(std::max((ndcX * 0.5f + 0.5f) * TILES_X, 0.0f), TILES_X - 1.0f);
+        unsigned int y = (unsigned int)std::min(std::max((ndcY * 0.5f + 0.5f) * TILES_Y, 0.0f), TILES_Y - 1.0f);
+        return cluster(x, y, slice(depth));
+    }
+
+    // assigns the lights to the clusters of a camera with this view matrix
+    void build(const vector<PointLight>& lights, const glm::mat4& view)
+    {
+        ranges.resize(lights.size());
+        computeRanges(lights, view, 0, lights.size());
+        bucketBySlice();
+        binSlices(0, SLICES);
+        merge();
+    }
+    void build(const vector<PointLight>& lights, const glm::mat4& view, WorkerPool& pool)
+    {
+        ranges.resize(lights.size());
+        pool.parallelFor(lights.size(), [this, &lights, &view](size_t begin, size_t end) { computeRanges(lights, view, begin, end); }, 4);
+        bucketBySlice();
+        pool.parallelFor(SLICES, [this](size_t begin, size_t end) { binSlices(begin, end); });
+        merge();
+    }
+
+    // reference kernel, one light at a time
+    void computeRangesScalar(const vector<PointLight>& lights, const glm::mat4& view, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            glm::vec3 c = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+            float r = lights[i].radius;
+            unsigned int rightX = 0, leftX = 0, rightY = 0, leftY = 0;
+            for (unsigned int k = 0; k <= TILES_X; k++)
+            {
+                float d = (c.x + c.z * boundaryX[k]) * boundaryNormX[k];
+                rightX += d > r;
+                leftX += d < -r;
+            }
+            for (unsigned int k = 0; k <= TILES_Y; k++)
+            {
+                float d = (c.y + c.z * boundaryY[k]) * boundaryNormY[k];
+                rightY += d > r;
+                leftY += d < -r;
+            }
+            setRange(i, c.z, r, rightX, leftX, rightY, leftY);
+        }
+    }
+
+#ifdef CULLING_SSE
+    // same as computeRangesScalar, four lights per iteration
+    void computeRangesSSE(const vector<PointLight>& lights, const glm::mat4& view, size_t begin, size_t end)
+    {
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            const PointLight* l = &lights[i];
+            __m128 px = _mm_setr_ps(l[0].position.x, l[1].position.x, l[2].position.x, l[3].position.x);
+            __m128 py = _mm_setr_ps(l[0].position.y, l[1].position.y, l[2].position.y, l[3].position.y);
+            __m128 pz = _mm_setr_ps(l[0].position.z, l[1].position.z, l[2].position.z, l[3].position.z);
+            __m128 r = _mm_setr_ps(l[0].radius, l[1].radius, l[2].radius, l[3].radius);
+            __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+            __m128 c[3];
+            for (int row = 0; row < 3; row++)
+            {
+                c[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(view[0][row])), _mm_mul_ps(py, _mm_set1_ps(view[1][row]))),
+                                    _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(view[2][row])), _mm_set1_ps(view[3][row])));
+            }
+            // the compare masks are -1 where true, so subtracting them counts
+            __m128i rightX = _mm_setzero_si128(), leftX = _mm_setzero_si128();
+            __m128i rightY = _mm_setzero_si128(), leftY = _mm_setzero_si128();
+            for (unsigned int k = 0; k <= TILES_X; k++)
+            {
+                __m128 d = _mm_mul_ps(_mm_add_ps(c[0], _mm_mul_ps(c[2], _mm_set1_ps(boundaryX[k]))), _mm_set1_ps(boundaryNormX[k]));
+                rightX = _mm_sub_epi32(rightX, _mm_castps_si128(_mm_cmpgt_ps(d, r)));
+                leftX = _mm_sub_epi32(leftX, _mm_castps_si128(_mm_cmplt_ps(d, negR)));
+            }
+            for (unsigned int k = 0; k <= TILES_Y; k++)
+            {
+                __m128 d = _mm_mul_ps(_mm_add_ps(c[1], _mm_mul_ps(c[2], _mm_set1_ps(boundaryY[k]))), _mm_set1_ps(boundaryNormY[k]));
+                rightY = _mm_sub_epi32(rightY, _mm_castps_si128(_mm_cmpgt_ps(d, r)));
+                leftY = _mm_sub_epi32(leftY, _mm_castps_si128(_mm_cmplt_ps(d, negR)));
+            }
+            float z[4], radius[4];
+            uint32_t rx[4], lx[4], ry[4], ly[4];
+            _mm_storeu_ps(z, c[2]);
+            _mm_storeu_ps(radius, r);
+            _mm_storeu_si128((__m128i*)rx, rightX);
+            _mm_storeu_si128((__m128i*)lx, leftX);
+            _mm_storeu_si128((__m128i*)ry, rightY);
+            _mm_storeu_si128((__m128i*)ly, leftY);
+            for (int lane = 0; lane < 4; lane++)
+                setRange(i + lane, z[lane], radius[lane], rx[lane], lx[lane], ry[lane], ly[lane]);
+        }
+        computeRangesScalar(lights, view, i, end);
+    }
+#endif
+
+    // lights [begin, end) with the fastest kernel available
+    void computeRanges(const vector<PointLight>& lights, const glm::mat4& view, size_t begin, size_t end)
+    {
+#ifdef CULLING_SSE
+        computeRangesSSE(lights, view, begin, end);
+#else
+        computeRangesScalar(lights, view, begin, end);
+#endif
+    }
+
+private:
+    float nearPlane, farPlane, tanHalfX, tanHalfY;
+    float sliceScale, sliceBias;
+    float boundaryX[TILES_X + 1], boundaryNormX[TILES_X + 1];
+    float boundaryY[TILES_Y + 1], boundaryNormY[TILES_Y + 1];
+    vector<vector<uint32_t>> sliceLights;  // the lights touching each slice
+    vector<vector<uint32_t>> sliceIndices; // each slice's lists, built by one thread
+
+    static void boundaryPlane(float ndc, float tanHalf, float& a, float& norm)
+    {
+        a = ndc * tanHalf;
+        norm = 1.0f / std::sqrt(1.0f + a * a);
+    }
+
+    // turns the plane counts of light i into its cluster range. The boundaries are ordered left to right only
+    // in front of the eye, so a sphere reaching behind it gets all tiles.
+    void setRange(size_t i, float viewZ, float r, unsigned int rightX, unsigned int leftX, unsigned int rightY, unsigned int leftY)
+    {
+        LightRange& range = ranges[i];
+        float nearest = -viewZ - r, farthest = -viewZ + r;
+        if (farthest < nearPlane || nearest > farPlane || rightX > TILES_X || leftX > TILES_X || rightY > TILES_Y || leftY > TILES_Y)
+        {
+            range.z0 = 1;
+            range.z1 = 0;
+            return;
+        }
+        if (viewZ + r > 0.0f)
+        {
+            range.x0 = range.y0 = 0;
+            range.x1 = TILES_X - 1;
+            range.y1 = TILES_Y - 1;
+        }
+        else
+        {
+            range.x0 = (uint8_t)(rightX > 0 ? rightX - 1 : 0);
+            range.x1 = (uint8_t)(TILES_X - std::max(leftX, 1u));
+            range.y0 = (uint8_t)(rightY > 0 ? rightY - 1 : 0);
+            range.y1 = (uint8_t)(TILES_Y - std::max(leftY, 1u));
+        }
+        range.z0 = (uint8_t)slice(std::max(nearest, nearPlane));
+        range.z1 = (uint8_t)slice(std::min(farthest, farPlane));
+    }
+
+    // most lights span one or two slices, so each slice only looks at its own
+    void bucketBySlice()
+    {
+        for (unsigned int z = 0; z < SLICES; z++)
+            sliceLights[z].clear();
+        for (size_t i = 0; i < ranges.size(); i++)
+            for (unsigned int z = ranges[i].z0; z <= ranges[i].z1; z++)
+                sliceLights[z].push_back((uint32_t)i);
+    }
+
+    // fills the cells of slices [begin, end): counts, offsets within the slice, then the indices
+    void binSlices(size_t begin, size_t end)
+    {
+        const unsigned int sliceClusters = TILES_X * TILES_Y;
+        for (size_t z = begin; z < end; z++)
+        {
+            uint32_t* cell = &cells[2 * z * sliceClusters];
+            for (unsigned int c = 0; c < sliceClusters; c++)
+                cell[2 * c + 1] = 0;
+            for (size_t l = 0; l < sliceLights[z].size(); l++)
+            {
+                uint32_t i = sliceLights[z][l];
+                const LightRange& range = ranges[i];
+                for (unsigned int y = range.y0; y <= range.y1; y++)
+                    for (unsigned int x = range.x0; x <= range.x1; x++)
+                        cell[2 * (y * TILES_X + x) + 1]++;
+            }
+            uint32_t offset = 0;
+            for (unsigned int c = 0; c < sliceClusters; c++)
+            {
+                cell[2 * c] = offset;
+                offset += cell[2 * c + 1];
+                cell[2 * c + 1] = 0;
+            }
+            vector<uint32_t>& list = sliceIndices[z];
+            list.resize(offset);
+            for (size_t l = 0; l < sliceLights[z].size(); l++)
+            {
+                uint32_t i = sliceLights[z][l];
+                const LightRange& range = ranges[i];
+                for (unsigned int y = range.y0; y <= range.y1; y++)
+                {
+                    for (unsigned int x = range.x0; x <= range.x1; x++)
+                    {
+                        uint32_t* c = &cell[2 * (y * TILES_X + x)];
+                        list[c[0] + c[1]++] = i;
+                    }
+                }
+            }
+        }
+    }
+
+    // concatenates the slices' lists into indices and makes the cell offsets global
+    void merge()
+    {
+        const unsigned int sliceClusters = TILES_X * TILES_Y;
+        size_t total = 0;
+        for (unsigned int z = 0; z < SLICES; z++)
+            total += sliceIndices[z].size();
+        indices.resize(total);
+        maxClusterLights = 0;
+        uint32_t base = 0;
+        for (unsigned int z = 0; z < SLICES; z++)
+        {
+            if (!sliceIndices[z].empty())
+                memcpy(&indices[base], &sliceIndices[z][0], sliceIndices[z].size() * sizeof(uint32_t));
+            uint32_t* cell = &cells[2 * z * sliceClusters];
+            for (unsigned int c = 0; c < sliceClusters; c++)
+            {
+                cell[2 * c] += base;
+                maxClusterLights = std::max(maxClusterLights, cell[2 * c + 1]);
+            }
+            base += (uint32_t)sliceIndices[z].size();
+        }
+        visibleLights = 0;
+        for (size_t i = 0; i < ranges.size(); i++)
+            visibleLights += ranges[i].z0 <= ranges[i].z1;
+    }
+};
+
+// The cluster grid on the GPU, as three buffer textures (so it works on a 3.3 context): the lights
+// (samplerBuffer, 3 RGBA32F texels each), the cells (usamplerBuffer, RG32UI) and the light indices
+// (usamplerBuffer, R32UI). All three are re-uploaded every frame, orphaning the old storage.
+// A shader reads them through the clusterLights/clusterCells/clusterIndices samplers and the cluster*
+// uniforms that bind() sets, see pbr.frag or deferredShading.frag for the lookup.
+class ClusteredLights
+{
+public:
+    static const unsigned int LIGHTS_UNIT = 9;
+    static const unsigned int CELLS_UNIT = 10;
+    static const unsigned int INDICES_UNIT = 11;
+
+    LightClusterGrid grid;
+    size_t lightCount;
+
+    ClusteredLights() : lightCount(0)
+    {
+        createBufferTexture(lightBuffer, lightTexture, GL_RGBA32F);
+        createBufferTexture(cellBuffer, cellTexture, GL_RG32UI);
+        createBufferTexture(indexBuffer, indexTexture, GL_R32UI);
+    }
+
+    void setProjection(float fovy, float aspect, float near, float far)
+    {
+        grid.setProjection(fovy, aspect, near, far);
+    }
+
+    // clusters the lights for this frame's view and uploads everything
+    void update(const vector<PointLight>& lights, const glm::mat4& view, WorkerPool& pool)
+    {
+        grid.build(lights, view, pool);
+        upload(lights);
+    }
+    void update(const vector<PointLight>& lights, const glm::mat4& view)
+    {
+        grid.build(lights, view);
+        upload(lights);
+    }
+
+    // binds the buffer textures and sets the lookup uniforms; viewport is the size of the target being shaded
+    void bind(Shader& shader, int viewportWidth, int viewportHeight) const
+    {
+        shader.use();
+        shader.setInt("clusterLights", LIGHTS_UNIT);
+        shader.setInt("clusterCells", CELLS_UNIT);
+        shader.setInt("clusterIndices", INDICES_UNIT);
+        shader.setVec2("clusterTileScale", (float)LightClusterGrid::TILES_X / viewportWidth, (float)LightClusterGrid::TILES_Y / viewportHeight);
+        shader.setVec2("clusterSliceParams", grid.getSliceScale(), grid.getSliceBias());
+        glState().bindTexture(GL_TEXTURE0 + LIGHTS_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+        glState().bindTexture(GL_TEXTURE0 + CELLS_UNIT, GL_TEXTURE_BUFFER, cellTexture);
+        glState().bindTexture(GL_TEXTURE0 + INDICES_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+    }
+
+private:
+    unsigned int lightBuffer, lightTexture;
+    unsigned int cellBuffer, cellTexture;
+    unsigned int indexBuffer, indexTexture;
+
+    static void createBufferTexture(unsigned int& buffer, unsigned int& texture, GLenum format)
+    {
+        glGenBuffers(1, &buffer);
+        glState().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glState().bindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    }
+
+    static void uploadBuffer(unsigned int buffer, const void* data, size_t size)
+    {
+        glState().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // a fresh store every frame, so the GPU can keep reading last frame's
+        glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t)16), NULL, GL_STREAM_DRAW);
+        if (size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+
+    void upload(const vector<PointLight>& lights)
+    {
+        lightCount = lights.size();
+        uploadBuffer(lightBuffer, lights.empty() ? 0 : &lights[0], lights.size() * sizeof(PointLight));
+        uploadBuffer(cellBuffer, &grid.cells[0], grid.cells.size() * sizeof(uint32_t));
+        uploadBuffer(indexBuffer, grid.indices.empty() ? 0 : &grid.indices[0], grid.indices.size() * sizeof(uint32_t));
+    }
+};
+#endif
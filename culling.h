@@ -0,0 +1,326 @@
+
+
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// SSE2 is part of every x86-64 target, AVX only when the compiler is told to use it (/arch:AVX, -mavx)
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define CULLING_SSE 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define CULLING_AVX 1
+#include <immintrin.h>
+#endif
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+
+    BoundingSphere() : center(0.0f), radius(0.0f)
+    {
+    }
+    BoundingSphere(const glm::vec3& c, float r) : center(c), radius(r)
+    {
+    }
+
+    // the sphere after a model transform, the radius grows with the largest axis scale
+    BoundingSphere transformed(const glm::mat4& model) const
+    {
+        float sx = glm::dot(glm::vec3(model[0]), glm::vec3(model[0]));
+        float sy = glm::dot(glm::vec3(model[1]), glm::vec3(model[1]));
+        float sz = glm::dot(glm::vec3(model[2]), glm::vec3(model[2]));
+        float scale = std::sqrt(glm::max(sx, glm::max(sy, sz)));
+        return BoundingSphere(glm::vec3(model * glm::vec4(center, 1.0f)), radius * scale);
+    }
+};
+
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    // an empty box, grows with the first point added
+    AABB() : min(FLT_MAX), max(-FLT_MAX)
+    {
+    }
+
+    void add(const glm::vec3& p)
+    {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    void add(const AABB& box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+    bool empty() const
+    {
+        return min.x > max.x;
+    }
+    glm::vec3 center() const
+    {
+        return (min + max) * 0.5f;
+    }
+    glm::vec3 extents() const
+    {
+        return (max - min) * 0.5f;
+    }
+    // sphere around the box, used when a tighter one from the vertices isn't available
+    BoundingSphere sphere() const
+    {
+        return BoundingSphere(center(), glm::length(extents()));
+    }
+};
+
+// bounds of a point cloud: the box, and a sphere around the box center whose radius is the distance
+// to the farthest point (tighter than the sphere around the box corners)
+template <typename Point, typename GetPosition>
+void computeBounds(const vector<Point>& points, GetPosition position, AABB& box, BoundingSphere& sphere)
+{
+    box = AABB();
+    for (size_t i = 0; i < points.size(); i++)
+        box.add(position(points[i]));
+    if (box.empty())
+    {
+        sphere = BoundingSphere();
+        return;
+    }
+    glm::vec3 c = box.center();
+    float radius2 = 0.0f;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        glm::vec3 d = position(points[i]) - c;
+        radius2 = glm::max(radius2, glm::dot(d, d));
+    }
+    sphere = BoundingSphere(c, std::sqrt(radius2));
+}
+
+// The 6 planes of a view frustum in world space, pointing inwards (a point is inside when
+// dot(plane.xyz, p) + plane.w >= 0 for all of them). Extracted from projection * view, so it
+// matches whatever the camera and projection matrix are.
+class Frustum
+{
+public:
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    Frustum()
+    {
+        for (unsigned int i = 0; i < 6; i++)
+            planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    explicit Frustum(const glm::mat4& viewProjection)
+    {
+        // rows of the matrix (glm is column major, so row i is m[0][i], m[1][i], ...)
+        glm::vec4 row[4];
+        for (unsigned int i = 0; i < 4; i++)
+            row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        planes[0] = row[3] + row[0];
+        planes[1] = row[3] - row[0];
+        planes[2] = row[3] + row[1];
+        planes[3] = row[3] - row[1];
+        planes[4] = row[3] + row[2];
+        planes[5] = row[3] - row[2];
+        // normalize so plane distances are real distances and can be compared with a radius
+        for (unsigned int i = 0; i < 6; i++)
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+
+    bool intersects(const BoundingSphere& sphere) const
+    {
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            if (glm::dot(glm::vec3(planes[i]), sphere.center) + planes[i].w < -sphere.radius)
+                return false;
+        }
+        return true;
+    }
+
+    bool intersects(const AABB& box) const
+    {
+        glm::vec3 c = box.center();
+        glm::vec3 e = box.extents();
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            glm::vec3 n(planes[i]);
+            // projected radius of the box onto the plane normal
+            float r = e.x * std::fabs(n.x) + e.y * std::fabs(n.y) + e.z * std::fabs(n.z);
+            if (glm::dot(n, c) + planes[i].w < -r)
+                return false;
+        }
+        return true;
+    }
+};
+
+// Bounding spheres of many instances in structure-of-arrays layout, so the culling kernel loads
+// 4 (SSE) or 8 (AVX) spheres per register. Storage is padded to a multiple of 8 with spheres that
+// can never be visible, so the kernels don't need a scalar tail loop.
+class SphereSet
+{
+public:
+    vector<float> x, y, z, radius;
+
+    SphereSet() : count(0)
+    {
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    void resize(size_t n)
+    {
+        count = n;
+        size_t padded = (n + 7) & ~(size_t)7;
+        x.resize(padded, 0.0f);
+        y.resize(padded, 0.0f);
+        z.resize(padded, 0.0f);
+        radius.resize(padded, 0.0f);
+        for (size_t i = n; i < padded; i++)
+            radius[i] = -FLT_MAX;
+    }
+
+    void set(size_t i, const BoundingSphere& sphere)
+    {
+        x[i] = sphere.center.x;
+        y[i] = sphere.center.y;
+        z[i] = sphere.center.z;
+        radius[i] = sphere.radius;
+    }
+
+    BoundingSphere get(size_t i) const
+    {
+        return BoundingSphere(glm::vec3(x[i], y[i], z[i]), radius[i]);
+    }
+
+private:
+    size_t count;
+};
+
+// reference kernel, one sphere at a time
+inline size_t cullSpheresScalar(const Frustum& frustum, const SphereSet& spheres, vector<uint32_t>& visible)
+{
+    visible.resize(spheres.x.size());
+    uint32_t* out = visible.empty() ? 0 : &visible[0];
+    size_t n = 0;
+    for (size_t i = 0; i < spheres.size(); i++)
+    {
+        out[n] = (uint32_t)i;
+        n += frustum.intersects(spheres.get(i)) ? 1 : 0;
+    }
+    visible.resize(n);
+    return n;
+}
+
+#ifdef CULLING_SSE
+// 4 spheres per iteration. The visible indices are written branch free: every lane writes its
+// index to the next free slot and only advances the cursor when it passed all 6 planes.
+inline size_t cullSpheresSSE(const Frustum& frustum, const SphereSet& spheres, vector<uint32_t>& visible)
+{
+    size_t padded = spheres.x.size();
+    visible.resize(padded + 4);
+    uint32_t* out = &visible[0];
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (unsigned int p = 0; p < 6; p++)
+    {
+        px[p] = _mm_set1_ps(frustum.planes[p].x);
+        py[p] = _mm_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+    const float* xs = padded ? &spheres.x[0] : 0;
+    const float* ys = padded ? &spheres.y[0] : 0;
+    const float* zs = padded ? &spheres.z[0] : 0;
+    const float* rs = padded ? &spheres.radius[0] : 0;
+    size_t n = 0;
+    for (size_t i = 0; i < padded; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128 z = _mm_loadu_ps(zs + i);
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(rs + i));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (unsigned int p = 0; p < 6; p++)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, px[p]), _mm_mul_ps(y, py[p])), _mm_add_ps(_mm_mul_ps(z, pz[p]), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negRadius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (unsigned int lane = 0; lane < 4; lane++)
+        {
+            out[n] = (uint32_t)(i + lane);
+            n += (mask >> lane) & 1;
+        }
+    }
+    visible.resize(n);
+    return n;
+}
+#endif
+
+#ifdef CULLING_AVX
+// same as the SSE kernel, 8 spheres per iteration
+inline size_t cullSpheresAVX(const Frustum& frustum, const SphereSet& spheres, vector<uint32_t>& visible)
+{
+    size_t padded = spheres.x.size();
+    visible.resize(padded + 8);
+    uint32_t* out = &visible[0];
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (unsigned int p = 0; p < 6; p++)
+    {
+        px[p] = _mm256_set1_ps(frustum.planes[p].x);
+        py[p] = _mm256_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+    const float* xs = padded ? &spheres.x[0] : 0;
+    const float* ys = padded ? &spheres.y[0] : 0;
+    const float* zs = padded ? &spheres.z[0] : 0;
+    const float* rs = padded ? &spheres.radius[0] : 0;
+    size_t n = 0;
+    for (size_t i = 0; i < padded; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 z = _mm256_loadu_ps(zs + i);
+        __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(rs + i));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (unsigned int p = 0; p < 6; p++)
+        {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, px[p]), _mm256_mul_ps(y, py[p])), _mm256_add_ps(_mm256_mul_ps(z, pz[p]), pw[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negRadius, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (unsigned int lane = 0; lane < 8; lane++)
+        {
+            out[n] = (uint32_t)(i + lane);
+            n += (mask >> lane) & 1;
+        }
+    }
+    visible.resize(n);
+    return n;
+}
+#endif
+
+// writes the indices of the spheres touching the frustum to visible (in increasing order) and returns
+// how many there are, using the widest kernel the build supports
+inline size_t cullSpheres(const Frustum& frustum, const SphereSet& spheres, vector<uint32_t>& visible)
+{
+#if defined(CULLING_AVX)
+    return cullSpheresAVX(frustum, spheres, visible);
+#elif defined(CULLING_SSE)
+    return cullSpheresSSE(frustum, spheres, visible);
+#else
+    return cullSpheresScalar(frustum, spheres, visible);
+#endif
+}
+#endif
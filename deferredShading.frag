@@ -9,44 +9,96 @@ uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedoSpec;
 
-struct Light {
-    vec3 Position;
-    vec3 Color;
-    
-    float Linear;
-    float Quadratic;
-    float Radius;
-};
-const int NR_LIGHTS = 32;
-uniform Light lights[NR_LIGHTS];
 uniform vec3 viewPos;
+uniform mat4 view;
+
+// clustered point lights (ClusteredLights in clusters.h)
+uniform samplerBuffer clusterLights;   // 3 texels per light: position + radius, color + linear, quadratic
+uniform usamplerBuffer clusterCells;   // per cluster: first index, light count
+uniform usamplerBuffer clusterIndices; // light indices of all clusters
+uniform vec2 clusterTileScale;         // tiles per pixel
+uniform vec2 clusterSliceParams;       // slice = log(view depth) * x + y
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24); // LightClusterGrid::TILES_X, TILES_Y, SLICES
+
+// compact G-buffer (GBuffer in gbuffer.h): the position is rebuilt from the depth buffer with the inverse
+// projection, the normal is octahedral encoded into [0,1]^2
+uniform bool compactGBuffer;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+uniform mat4 inverseView;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 octahedralDecode(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
+
+vec3 viewPositionFromDepth(vec2 uv)
+{
+    vec4 position = inverseProjection * vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+vec3 gBufferNormal(vec2 uv)
+{
+    vec4 normal = texture(gNormal, uv);
+    return compactGBuffer ? octahedralDecode(normal.xy) : normal.xyz;
+}
 
 void main()
 {             
     // retrieve data from gbuffer
-    vec3 FragPos = texture(gPosition, TexCoords).rgb;
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
+    vec3 FragPos;
+    float viewDepth;
+    if (compactGBuffer)
+    {
+        vec3 viewPosition = viewPositionFromDepth(TexCoords);
+        FragPos = (inverseView * vec4(viewPosition, 1.0)).xyz;
+        viewDepth = -viewPosition.z;
+    }
+    else
+    {
+        FragPos = texture(gPosition, TexCoords).rgb;
+        viewDepth = -(view * vec4(FragPos, 1.0)).z;
+    }
+    vec3 Normal = gBufferNormal(TexCoords);
     vec3 Diffuse = texture(gAlbedoSpec, TexCoords).rgb;
     float Specular = texture(gAlbedoSpec, TexCoords).a;
     
     // then calculate lighting as usual
     vec3 lighting  = Diffuse * 0.1; // hard-coded ambient component
     vec3 viewDir  = normalize(viewPos - FragPos);
-    for(int i = 0; i < NR_LIGHTS; ++i)
+    // only the lights of this pixel's cluster can reach it
+    ivec3 clusterCoord = ivec3(ivec2(gl_FragCoord.xy * clusterTileScale), int(log(viewDepth) * clusterSliceParams.x + clusterSliceParams.y));
+    clusterCoord = clamp(clusterCoord, ivec3(0), CLUSTER_GRID - 1);
+    uvec2 cell = texelFetch(clusterCells, (clusterCoord.z * CLUSTER_GRID.y + clusterCoord.y) * CLUSTER_GRID.x + clusterCoord.x).xy;
+    for(uint i = 0u; i < cell.y; ++i)
     {
+        int light = int(texelFetch(clusterIndices, int(cell.x + i)).r);
+        vec4 positionRadius = texelFetch(clusterLights, 3 * light);
+        vec4 colorLinear = texelFetch(clusterLights, 3 * light + 1);
+        float quadratic = texelFetch(clusterLights, 3 * light + 2).r;
         // calculate distance between light source and current fragment
-        float distance = length(lights[i].Position - FragPos);
-        if(distance < lights[i].Radius)
+        float distance = length(positionRadius.xyz - FragPos);
+        if(distance < positionRadius.w)
         {
             // diffuse
-            vec3 lightDir = normalize(lights[i].Position - FragPos);
-            vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * lights[i].Color;
+            vec3 lightDir = normalize(positionRadius.xyz - FragPos);
+            vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * colorLinear.rgb;
             // specular
             vec3 halfwayDir = normalize(lightDir + viewDir);  
             float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
-            vec3 specular = lights[i].Color * spec * Specular;
+            vec3 specular = colorLinear.rgb * spec * Specular;
             // attenuation
-            float attenuation = 1.0 / (1.0 + lights[i].Linear * distance + lights[i].Quadratic * distance * distance);
+            float attenuation = 1.0 / (1.0 + colorLinear.a * distance + quadratic * distance * distance);
             diffuse *= attenuation;
             specular *= attenuation;
             lighting += diffuse + specular;
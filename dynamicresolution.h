@@ -0,0 +1,123 @@
+
+
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include "gputimer.h"
+
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// Dynamic resolution: the 3D passes (G-buffer, lighting, SSAO, bloom) render at renderWidth x renderHeight, a
+// scale of the window that follows the GPU frame time, and the result is scaled up to the window at the end -
+// by PostProcess::upscale (postprocess.h) on its way through tone mapping, or by TemporalAA (temporal.h), whose
+// history stays at window size and gathers the full resolution over the jitter sequence.
+//
+// The controller assumes a frame's GPU time grows with its pixel count, so the scale that would just meet the
+// target is scale * sqrt(target / measured). It goes down as soon as the measured (smoothed) time is over
+// the target, and up only once it is well under, so it doesn't oscillate around it. The scale moves in steps:
+// every change reallocates the render targets (through their resize()), and the few sizes in between are
+// all it ever makes. GpuTimer results are GpuTimer::FRAMES frames late, so after a change it waits for
+// measurements of the new size before it changes again.
+//
+// The frame time is a GpuTimer timestamp pair around the GPU work only, issued after the frame's CPU work. It
+// still counts the time the GPU waits for commands in between: in a CPU-bound frame the GPU starves, the
+// measured time follows the CPU, and a lower resolution saves nothing. The controller can't tell the two apart
+// from the GPU time alone, so keep CPU work out of the timed range, and pass update() the CPU time of the frame
+// (without the wait for the swap): while that is as long as the GPU time, it doesn't scale down.
+//
+// Per frame:
+//   ... CPU work: input, simulation, culling ...
+//   (cpuMs: what the CPU spent on the last frame, its work and draw calls, without the swap)
+//   timer.beginFrame();
+//   if (resolution.update(timer.last("frame"), cpuMs))
+//       { gBuffer.resize(resolution.renderWidth, resolution.renderHeight); ssao.resize(...); bloom.resize(...); }
+//   timer.begin("frame");
+//   ... 3D passes at renderWidth x renderHeight, the projection jittered for that size ...
+//   post.apply(hdrScene, bloom.result, 0, resolution.windowWidth, resolution.windowHeight);
+//   timer.end("frame");
+// and setWindowSize() from the framebuffer size callback.
+class DynamicResolution
+{
+public:
+    float targetMilliseconds; // GPU time a frame should stay under, 16.6 for 60 Hz
+    float minScale, maxScale; // of the window's width and height
+    float step;               // the scale changes in multiples of this
+    float headroom;           // scales up only while the frame takes less than this part of the target
+    float scale;
+    int windowWidth, windowHeight;
+    int renderWidth, renderHeight;
+
+    DynamicResolution(int width, int height, float targetMs = 16.6f)
+        : targetMilliseconds(targetMs), minScale(0.5f), maxScale(1.0f), step(0.05f), headroom(0.85f), scale(1.0f),
+          windowWidth(0), windowHeight(0), renderWidth(0), renderHeight(0), smoothedMilliseconds(0.0), settleFrames(0)
+    {
+        setWindowSize(width, height);
+    }
+
+    // for the framebuffer size callback; keeps the scale. Returns whether the render size changed.
+    bool setWindowSize(int width, int height)
+    {
+        windowWidth = std::max(1, width);
+        windowHeight = std::max(1, height);
+        return applyScale();
+    }
+
+    // feeds the GPU time of the last measured frame (GpuTimer::last, 0 while there is none yet) and picks the
+    // scale for the next one. Returns whether the render size changed, the render targets need a resize() then.
+    // cpuMilliseconds is the CPU time of a recent frame, 0 if unknown; a GPU that takes no longer than that is
+    // likely waiting for the CPU, and the scale doesn't go down for it.
+    bool update(double measuredMilliseconds, double cpuMilliseconds = 0.0)
+    {
+        if (measuredMilliseconds <= 0.0)
+            return false;
+        if (settleFrames > 0)
+        {
+            // still frames of the old size
+            settleFrames--;
+            return false;
+        }
+        smoothedMilliseconds = smoothedMilliseconds > 0.0 ? smoothedMilliseconds * 0.8 + measuredMilliseconds * 0.2
+                                                          : measuredMilliseconds;
+
+        float wanted = scale * (float)std::sqrt(targetMilliseconds / smoothedMilliseconds);
+        if (smoothedMilliseconds < targetMilliseconds * headroom)
+            wanted *= std::sqrt(headroom); // aims below the target, not right at it
+        else if (smoothedMilliseconds <= targetMilliseconds || cpuMilliseconds >= smoothedMilliseconds * CPU_BOUND)
+            return false;
+        wanted = std::floor(wanted / step + 0.001f) * step;
+        wanted = std::min(maxScale, std::max(minScale, wanted));
+        if (std::fabs(wanted - scale) < step * 0.5f)
+            return false;
+        scale = wanted;
+        return applyScale();
+    }
+
+    // the smoothed frame time the controller works with
+    double frameMilliseconds() const
+    {
+        return smoothedMilliseconds;
+    }
+
+private:
+    // a frame whose CPU time is at least this part of the GPU time counts as CPU-bound
+    static constexpr double CPU_BOUND = 0.9;
+
+    double smoothedMilliseconds;
+    unsigned int settleFrames;
+
+    bool applyScale()
+    {
+        int width = std::max(1, (int)(windowWidth * scale + 0.5f));
+        int height = std::max(1, (int)(windowHeight * scale + 0.5f));
+        if (width == renderWidth && height == renderHeight)
+            return false;
+        renderWidth = width;
+        renderHeight = height;
+        settleFrames = GpuTimer::FRAMES + 1;
+        smoothedMilliseconds = 0.0;
+        return true;
+    }
+};
+#endif
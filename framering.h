@@ -0,0 +1,193 @@
+
+
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "glstate.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// A piece of the current frame's region: write size bytes to data, then draw from buffer at offset
+// (glBindBufferRange for uniform blocks, InstanceLayout::attach for instance data, a vertex pointer for
+// streamed vertices). data is 0 when the frame ran out of space.
+struct RingAllocation {
+    void* data;
+    unsigned int buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+// One buffer for all of a frame's dynamic data (per-draw constants, instance data, streamed vertices),
+// split in FRAME_REGIONS regions that are used round robin. Allocations are just a bump of the region's head,
+// and a fence at the end of every frame tells when the GPU is done reading a region, so by the time the
+// CPU comes back to it (FRAME_REGIONS frames later) it can be overwritten without stalling.
+// With GL 4.4 the buffer is mapped persistently and coherently and writes land in it directly. Before that
+// writes go to a staging copy, and flush() copies the new part with an unsynchronized glMapBufferRange
+// (the fences already guarantee the GPU isn't reading it). Either way call flush() (bindRange does) before
+// drawing from the allocations.
+class FrameRingBuffer
+{
+public:
+    static const unsigned int FRAME_REGIONS = 3;
+
+    unsigned int ID;
+    size_t frameSize;      // bytes per region, the most one frame can allocate
+    bool persistent;       // persistently mapped (GL 4.4) or staged
+    size_t uniformAlignment;
+
+    // telemetry: bytes allocated this frame, last frame and at most, frames that found their region still
+    // in use by the GPU (and the time spent waiting for it), allocations that didn't fit
+    size_t bytesWritten;
+    size_t lastFrameBytes;
+    size_t peakFrameBytes;
+    unsigned int stalls;
+    double stallMs;
+    unsigned int overflows;
+
+    explicit FrameRingBuffer(size_t bytesPerFrame)
+        : ID(0), frameSize(bytesPerFrame), persistent(GLAD_GL_VERSION_4_4 != 0), uniformAlignment(256),
+          bytesWritten(0), lastFrameBytes(0), peakFrameBytes(0), stalls(0), stallMs(0.0), overflows(0),
+          region(0), head(0), flushed(0), mapped(0)
+    {
+        for (unsigned int i = 0; i < FRAME_REGIONS; i++)
+            fences[i] = 0;
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if (alignment > 0)
+            uniformAlignment = (size_t)alignment;
+
+        glGenBuffers(1, &ID);
+        glState().bindBuffer(GL_ARRAY_BUFFER, ID);
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, frameSize * FRAME_REGIONS, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, frameSize * FRAME_REGIONS, flags);
+        }
+        else
+        {
+            glBufferData(GL_ARRAY_BUFFER, frameSize * FRAME_REGIONS, NULL, GL_STREAM_DRAW);
+            staging.resize(frameSize);
+        }
+    }
+
+    // moves on to the next region, waiting for the GPU only if it is still reading it
+    void beginFrame()
+    {
+        lastFrameBytes = bytesWritten;
+        if (bytesWritten > peakFrameBytes)
+            peakFrameBytes = bytesWritten;
+        bytesWritten = 0;
+        region = (region + 1) % FRAME_REGIONS;
+        head = flushed = 0;
+        waitForRegion(region);
+    }
+
+    // fences everything drawn from this frame's region, call after the frame's last draw
+    void endFrame()
+    {
+        flush();
+        if (fences[region])
+            glDeleteSync(fences[region]);
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // size bytes from the current region, the offset a multiple of alignment (a power of two)
+    RingAllocation allocate(size_t size, size_t alignment = 16)
+    {
+        RingAllocation allocation = { 0, ID, 0, (GLsizeiptr)size };
+        size_t start = (head + alignment - 1) & ~(alignment - 1);
+        if (start + size > frameSize)
+        {
+            overflows++;
+            return allocation;
+        }
+        head = start + size;
+        bytesWritten += size;
+        allocation.offset = (GLintptr)(regionOffset() + start);
+        allocation.data = persistent ? mapped + allocation.offset : &staging[start];
+        return allocation;
+    }
+
+    // an allocation holding a copy of value, aligned for use as a uniform block
+    template <typename T>
+    RingAllocation push(const T& value)
+    {
+        RingAllocation allocation = allocate(sizeof(T), uniformAlignment);
+        if (allocation.data)
+            memcpy(allocation.data, &value, sizeof(T));
+        return allocation;
+    }
+
+    // makes everything written since the last flush visible to the GPU
+    void flush()
+    {
+        if (persistent || head == flushed)
+            return;
+        // nothing the GPU may still read lives in this range, so there is nothing to synchronize with
+        glState().bindBuffer(GL_ARRAY_BUFFER, ID);
+        void* destination = glMapBufferRange(GL_ARRAY_BUFFER, regionOffset() + flushed, head - flushed,
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (destination)
+        {
+            memcpy(destination, &staging[flushed], head - flushed);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        flushed = head;
+    }
+
+    // binds an allocation to an indexed uniform block / storage block binding
+    void bindRange(GLenum target, unsigned int index, const RingAllocation& allocation)
+    {
+        if (!allocation.data)
+            return;
+        flush();
+        glState().bindBufferRange(target, index, allocation.buffer, allocation.offset, allocation.size);
+    }
+
+    void printStats() const
+    {
+        std::cout << "frame ring: " << lastFrameBytes << " bytes last frame (peak " << peakFrameBytes << " of " << frameSize
+                  << "), " << stalls << " stalls (" << stallMs << " ms), " << overflows << " overflows" << std::endl;
+    }
+
+private:
+    unsigned int region;
+    size_t head;    // bytes allocated in the current region
+    size_t flushed; // bytes of them already copied to the buffer (staged mode)
+    unsigned char* mapped;
+    GLsync fences[FRAME_REGIONS];
+    vector<unsigned char> staging;
+
+    size_t regionOffset() const
+    {
+        return (size_t)region * frameSize;
+    }
+
+    void waitForRegion(unsigned int r)
+    {
+        if (!fences[r])
+            return;
+        // the usual case: the GPU finished with this region frames ago
+        GLenum status = glClientWaitSync(fences[r], 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            stalls++;
+            chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+            while (glClientWaitSync(fences[r], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+            {
+            }
+            stallMs += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+        }
+        glDeleteSync(fences[r]);
+        fences[r] = 0;
+    }
+};
+#endif
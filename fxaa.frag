@@ -0,0 +1,134 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// FXAA 3.11 (Lottes), the PC quality path: find the edge through the pixel, walk along it in both directions to
+// its ends and move the lookup across the edge by how close the pixel is to the nearer end. Runs on the tone
+// mapped, gamma encoded image, luma is computed from it.
+uniform sampler2D image;
+uniform vec2 texelSize;
+uniform float edgeThreshold;    // minimum local contrast relative to the brightest neighbour
+uniform float edgeThresholdMin; // ... and absolute, so dark areas are left alone
+uniform float subpixelQuality;  // how much of the subpixel aliasing to remove, 0 - 1
+
+const int STEPS = 12;
+const float QUALITY[STEPS] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+float lumaAt(vec2 uv)
+{
+    return luma(textureLod(image, uv, 0.0).rgb);
+}
+
+void main()
+{
+    vec3 colorCenter = textureLod(image, TexCoords, 0.0).rgb;
+    float lumaCenter = luma(colorCenter);
+    float lumaDown = luma(textureLodOffset(image, TexCoords, 0.0, ivec2(0, -1)).rgb);
+    float lumaUp = luma(textureLodOffset(image, TexCoords, 0.0, ivec2(0, 1)).rgb);
+    float lumaLeft = luma(textureLodOffset(image, TexCoords, 0.0, ivec2(-1, 0)).rgb);
+    float lumaRight = luma(textureLodOffset(image, TexCoords, 0.0, ivec2(1, 0)).rgb);
+
+    // no visible edge: leave the pixel as it is
+    float lumaMin = min(lumaCenter, min(min(lumaDown, lumaUp), min(lumaLeft, lumaRight)));
+    float lumaMax = max(lumaCenter, max(max(lumaDown, lumaUp), max(lumaLeft, lumaRight)));
+    float lumaRange = lumaMax - lumaMin;
+    if (lumaRange < max(edgeThresholdMin, lumaMax * edgeThreshold))
+    {
+        FragColor = vec4(colorCenter, 1.0);
+        return;
+    }
+
+    float lumaDownLeft = luma(textureLodOffset(image, TexCoords, 0.0, ivec2(-1, -1)).rgb);
+    float lumaUpRight = luma(textureLodOffset(image, TexCoords, 0.0, ivec2(1, 1)).rgb);
+    float lumaUpLeft = luma(textureLodOffset(image, TexCoords, 0.0, ivec2(-1, 1)).rgb);
+    float lumaDownRight = luma(textureLodOffset(image, TexCoords, 0.0, ivec2(1, -1)).rgb);
+    float lumaDownUp = lumaDown + lumaUp;
+    float lumaLeftRight = lumaLeft + lumaRight;
+    float lumaLeftCorners = lumaDownLeft + lumaUpLeft;
+    float lumaDownCorners = lumaDownLeft + lumaDownRight;
+    float lumaRightCorners = lumaDownRight + lumaUpRight;
+    float lumaUpCorners = lumaUpRight + lumaUpLeft;
+
+    // 1. is the edge horizontal or vertical, and on which side of the pixel
+    float edgeHorizontal = abs(-2.0 * lumaLeft + lumaLeftCorners) + abs(-2.0 * lumaCenter + lumaDownUp) * 2.0 +
+                           abs(-2.0 * lumaRight + lumaRightCorners);
+    float edgeVertical = abs(-2.0 * lumaUp + lumaUpCorners) + abs(-2.0 * lumaCenter + lumaLeftRight) * 2.0 +
+                         abs(-2.0 * lumaDown + lumaDownCorners);
+    bool isHorizontal = edgeHorizontal >= edgeVertical;
+
+    float luma1 = isHorizontal ? lumaDown : lumaLeft;
+    float luma2 = isHorizontal ? lumaUp : lumaRight;
+    float gradient1 = luma1 - lumaCenter;
+    float gradient2 = luma2 - lumaCenter;
+    bool is1Steepest = abs(gradient1) >= abs(gradient2);
+    float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+
+    float stepLength = isHorizontal ? texelSize.y : texelSize.x;
+    float lumaLocalAverage;
+    if (is1Steepest)
+    {
+        stepLength = -stepLength;
+        lumaLocalAverage = 0.5 * (luma1 + lumaCenter);
+    }
+    else
+        lumaLocalAverage = 0.5 * (luma2 + lumaCenter);
+
+    // 2. walk along the edge, half a pixel towards it, until the luma leaves the edge's average at both ends
+    vec2 edgeUV = TexCoords;
+    if (isHorizontal)
+        edgeUV.y += stepLength * 0.5;
+    else
+        edgeUV.x += stepLength * 0.5;
+    vec2 offset = isHorizontal ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);
+    vec2 uv1 = edgeUV - offset * QUALITY[0];
+    vec2 uv2 = edgeUV + offset * QUALITY[0];
+    float lumaEnd1 = lumaAt(uv1) - lumaLocalAverage;
+    float lumaEnd2 = lumaAt(uv2) - lumaLocalAverage;
+    bool reached1 = abs(lumaEnd1) >= gradientScaled;
+    bool reached2 = abs(lumaEnd2) >= gradientScaled;
+    if (!reached1)
+        uv1 -= offset * QUALITY[1];
+    if (!reached2)
+        uv2 += offset * QUALITY[1];
+    for (int i = 2; i < STEPS && !(reached1 && reached2); i++)
+    {
+        if (!reached1)
+            lumaEnd1 = lumaAt(uv1) - lumaLocalAverage;
+        if (!reached2)
+            lumaEnd2 = lumaAt(uv2) - lumaLocalAverage;
+        reached1 = abs(lumaEnd1) >= gradientScaled;
+        reached2 = abs(lumaEnd2) >= gradientScaled;
+        if (!reached1)
+            uv1 -= offset * QUALITY[i];
+        if (!reached2)
+            uv2 += offset * QUALITY[i];
+    }
+
+    // 3. the closer end decides how far to move across the edge, if the luma changes the right way there
+    float distance1 = isHorizontal ? TexCoords.x - uv1.x : TexCoords.y - uv1.y;
+    float distance2 = isHorizontal ? uv2.x - TexCoords.x : uv2.y - TexCoords.y;
+    bool isDirection1 = distance1 < distance2;
+    float pixelOffset = -min(distance1, distance2) / (distance1 + distance2) + 0.5;
+    bool isLumaCenterSmaller = lumaCenter < lumaLocalAverage;
+    bool correctVariation = ((isDirection1 ? lumaEnd1 : lumaEnd2) < 0.0) != isLumaCenterSmaller;
+    float finalOffset = correctVariation ? pixelOffset : 0.0;
+
+    // 4. subpixel aliasing: blend by how much the pixel stands out from its 3x3 neighbourhood
+    float lumaAverage = (1.0 / 12.0) * (2.0 * (lumaDownUp + lumaLeftRight) + lumaLeftCorners + lumaRightCorners);
+    float subpixel = clamp(abs(lumaAverage - lumaCenter) / lumaRange, 0.0, 1.0);
+    subpixel = (-2.0 * subpixel + 3.0) * subpixel * subpixel;
+    finalOffset = max(finalOffset, subpixel * subpixel * subpixelQuality);
+
+    vec2 finalUV = TexCoords;
+    if (isHorizontal)
+        finalUV.y += finalOffset * stepLength;
+    else
+        finalUV.x += finalOffset * stepLength;
+    FragColor = vec4(textureLod(image, finalUV, 0.0).rgb, 1.0);
+}
@@ -0,0 +1,177 @@
+
+
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "glstate.h"
+
+#include <algorithm>
+#include <iostream>
+using namespace std;
+
+enum GBufferLayout {
+    GBUFFER_CLASSIC, // RGBA16F position, RGBA16F normal, RGBA8 albedo + specular: 20 bytes per pixel
+    GBUFFER_COMPACT  // RG16 octahedral normal, RGBA8 albedo + specular: 8 bytes per pixel
+};
+
+// Framebuffer for the geometry pass of deferred shading and SSAO.
+//
+// The classic layout stores the position, which costs 8 bytes per pixel to write and again to read in every
+// pass (65 times per pixel in ssao.frag). The compact layout doesn't store it at all: the passes rebuild it
+// from the depth buffer, which the geometry pass writes anyway, with the inverse projection. Normals are
+// octahedral encoded into two 16 bit unorm channels (about 0.005 degrees of error) and the specular
+// intensity stays in the albedo's alpha. Both layouts keep the depth in a texture (4 bytes per pixel).
+//
+// The shaders writing and reading the G-buffer (gbuffer.frag, ssaoGeometry.frag, ssao.frag, ssaoLighting.frag,
+// deferredShading.frag) handle both layouts, switched by their compactGBuffer uniform; the decode helpers
+// sit at the top of the readers. Attachment and output locations are the same in both layouts, the compact
+// one just doesn't draw to the position target.
+//
+// With a velocity target (RG16F, attachment 3) the geometry shaders (gbuffer.vs/.frag, ssaoGeometry.vs/.frag)
+// also write how far each pixel moved on screen since the last frame, for the reprojection of temporal.h. They
+// need setMotion() every frame, and previousModel with movingObject for objects that moved.
+class GBuffer
+{
+public:
+    // the units bind() uses, the position unit holds the depth texture in the compact layout
+    static const unsigned int POSITION_UNIT = 0;
+    static const unsigned int NORMAL_UNIT = 1;
+    static const unsigned int ALBEDO_UNIT = 2;
+
+    unsigned int FBO;
+    unsigned int position; // 0 in the compact layout
+    unsigned int normal;
+    unsigned int albedoSpec;
+    unsigned int depth;
+    unsigned int velocity; // 0 without the velocity target
+    int width, height;
+    GBufferLayout layout;
+    bool hasVelocity;
+
+    GBuffer(int bufferWidth, int bufferHeight, GBufferLayout bufferLayout = GBUFFER_COMPACT, bool velocityTarget = false)
+        : FBO(0), position(0), normal(0), albedoSpec(0), depth(0), velocity(0), width(0), height(0), layout(bufferLayout),
+          hasVelocity(velocityTarget)
+    {
+        glGenFramebuffers(1, &FBO);
+        resize(bufferWidth, bufferHeight);
+    }
+    ~GBuffer()
+    {
+        unsigned int textures[5] = { position, normal, albedoSpec, depth, velocity };
+        glDeleteTextures(5, textures);
+        glDeleteFramebuffers(1, &FBO);
+        glState().invalidate(); // the targets and the framebuffer may still be bound
+    }
+
+    // color bytes per pixel of a layout, written once by the geometry pass and read by every pass after it
+    static unsigned int bytesPerPixel(GBufferLayout bufferLayout)
+    {
+        return bufferLayout == GBUFFER_COMPACT ? 4 + 4 : 8 + 8 + 4;
+    }
+    unsigned int bytesPerPixel() const
+    {
+        return bytesPerPixel(layout);
+    }
+
+    // reallocates the targets for a new screen size
+    void resize(int bufferWidth, int bufferHeight)
+    {
+        if (bufferWidth == width && bufferHeight == height)
+            return;
+        width = std::max(1, bufferWidth);
+        height = std::max(1, bufferHeight);
+        if (depth)
+        {
+            unsigned int textures[5] = { position, normal, albedoSpec, depth, velocity };
+            glDeleteTextures(5, textures);
+            glState().invalidate(); // some of them may still be bound
+        }
+        position = 0;
+        if (layout == GBUFFER_CLASSIC)
+        {
+            position = createTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT);
+            normal = createTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT);
+        }
+        else
+            normal = createTarget(GL_RG16, GL_RG, GL_UNSIGNED_SHORT);
+        albedoSpec = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+        velocity = hasVelocity ? createTarget(GL_RG16F, GL_RG, GL_FLOAT) : 0;
+
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, position, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, albedoSpec, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, velocity, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        // the compact layout throws the shaders' position output away, and without the target the velocity
+        unsigned int attachments[4] = { position ? (unsigned int)GL_COLOR_ATTACHMENT0 : (unsigned int)GL_NONE, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2,
+                                        velocity ? (unsigned int)GL_COLOR_ATTACHMENT3 : (unsigned int)GL_NONE };
+        glDrawBuffers(4, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::GBUFFER:: Framebuffer not complete!" << std::endl;
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds and clears the G-buffer for the geometry pass, with a viewport of its size
+    void begin()
+    {
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glState().viewport(0, 0, width, height);
+        glState().depthMask(GL_TRUE);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // tells a shader writing the G-buffer which layout to write
+    void setLayout(Shader& shader) const
+    {
+        shader.use();
+        shader.setBool("compactGBuffer", layout == GBUFFER_COMPACT);
+    }
+
+    // the matrices the geometry shaders compute velocities from: this and the last frame's view projection, both
+    // without jitter. Resets movingObject, set it (and previousModel) only around the draws of objects that moved.
+    void setMotion(Shader& shader, const glm::mat4& viewProjection, const glm::mat4& previousViewProjection) const
+    {
+        shader.use();
+        shader.setMat4("currentViewProjection", viewProjection);
+        shader.setMat4("previousViewProjection", previousViewProjection);
+        shader.setBool("movingObject", false);
+    }
+
+    // binds the targets for a pass reading the G-buffer, and sets its samplers, layout and the matrices the
+    // position reconstruction needs (projection and view of the geometry pass)
+    void bind(Shader& shader, const glm::mat4& projection, const glm::mat4& view) const
+    {
+        setLayout(shader);
+        shader.setInt("gPosition", POSITION_UNIT);
+        shader.setInt("gDepth", POSITION_UNIT);
+        shader.setInt("gNormal", NORMAL_UNIT);
+        shader.setInt("gAlbedoSpec", ALBEDO_UNIT);
+        shader.setMat4("inverseProjection", glm::inverse(projection));
+        shader.setMat4("inverseView", glm::inverse(view));
+        glState().bindTexture(GL_TEXTURE0 + POSITION_UNIT, GL_TEXTURE_2D, layout == GBUFFER_COMPACT ? depth : position);
+        glState().bindTexture(GL_TEXTURE0 + NORMAL_UNIT, GL_TEXTURE_2D, normal);
+        glState().bindTexture(GL_TEXTURE0 + ALBEDO_UNIT, GL_TEXTURE_2D, albedoSpec);
+    }
+
+private:
+    unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState().bindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+};
+#endif
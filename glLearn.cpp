@@ -9,6 +9,30 @@
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
+#include "glstate.h"
+#include "renderqueue.h"
+#include "primitives.h"
+#include "culling.h"
+#include "asteroids.h"
+#include "gpuculling.h"
+#include "instancing.h"
+#include "benchmark.h"
+#include "framering.h"
+#include "hiz.h"
+#include "softocclusion.h"
+#include "occlusionquery.h"
+#include "impostor.h"
+#include "clusters.h"
+#include "gbuffer.h"
+#include "visibility.h"
+#include "ssao.h"
+#include "bloom.h"
+#include "postprocess.h"
+#include "autoexposure.h"
+#include "antialiasing.h"
+#include "temporal.h"
+#include "dynamicresolution.h"
+#include "gputimer.h"
 
 #include <string>
 #include <vector>
@@ -19,6 +43,7 @@ using namespace std;
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <random>
+#include <algorithm>
 
 
 
@@ -36,10 +61,25 @@ unsigned int loadCubemap(vector<std::string> faces);
 //render stuff for shadow mapping
 void renderSphere();
 void renderCube();
+void renderQuad();
 
 // meshes
 unsigned int planeVAO;
 
+// per-instance data of the pbr spheres (instanced attributes 8 and 9 of pbrInstanced.vs)
+struct PBRInstance {
+	glm::vec4 positionScale; // world position, uniform scale
+	glm::vec4 material;      // metallic, roughness, unused, unused
+};
+
+// per-frame constants of the pbr and skybox shaders, uniform block FrameConstants (std140, so vec3s are padded to vec4)
+const unsigned int FRAME_CONSTANTS_BINDING = 0;
+struct FrameConstants {
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 camPos;
+};
+
 //camera position stuff
 Camera camera(glm::vec3(0.0f, 0.0f, 5.0f));
 bool firstMove = true;
@@ -51,6 +91,7 @@ float bloom = 1.0f;
 //delta time!!!!
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+float lastStatsTime = 0.0f;
 
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f); // light source location
 bool spotlightActive;
@@ -63,7 +104,14 @@ float ourLerp(float a, float b, float f)
 
 
 static const int WIDTH = 1000, HEIGHT = 800;
-int main() {
+// the window's framebuffer size, kept by framebuffer_size_callback; 0 x 0 while minimized
+int windowWidth = WIDTH, windowHeight = HEIGHT;
+int main(int argc, char** argv) {
+	// headless benchmarks (--bench-cull, ...) run instead of the renderer
+	int benchmarkResult = runBenchmarks(argc, argv);
+	if (benchmarkResult >= 0)
+		return benchmarkResult;
+
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
@@ -101,22 +149,31 @@ int main() {
 		return -1;
 	}
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL); // set depth function to less than AND equal for skybox depth trick.
+	// GPU benchmarks (--bench-ssao) need the context but not the scene
+	benchmarkResult = runGpuBenchmarks(argc, argv);
+	if (benchmarkResult >= 0)
+	{
+		glfwTerminate();
+		return benchmarkResult;
+	}
 
-	Shader pbrShader("pbr.vs", "pbr.frag");
+	glState().enable(GL_DEPTH_TEST);
+	glState().depthFunc(GL_LEQUAL); // set depth function to less than AND equal for skybox depth trick.
+
+	Shader pbrShader("pbrInstanced.vs", "pbr.frag");
 	Shader equirectangularToCubemapShader("cubemap.vs", "equirectangularToCubemap.frag");
 	Shader irradianceShader("cubemap.vs", "irradianceConvolution.frag");
 	Shader backgroundShader("background.vs", "background.frag");
 
 
 	pbrShader.use();
-	pbrShader.setInt("irradianceMap", 0);
 	pbrShader.setVec3("albedo", 0.5f, 0.0f, 0.0f);
 	pbrShader.setFloat("ao", 1.0f);
+	pbrShader.setBlockBinding("FrameConstants", FRAME_CONSTANTS_BINDING);
+	backgroundShader.setBlockBinding("FrameConstants", FRAME_CONSTANTS_BINDING);
 
-	backgroundShader.use();
-	backgroundShader.setInt("environmentMap", 0);
+	// all per-frame dynamic data is allocated from here, three frames in flight
+	FrameRingBuffer frameRing(64 * 1024);
 
 	// lights
 	// ------
@@ -132,10 +189,50 @@ int main() {
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f)
 	};
+	// the pbr shader reads its lights from the clustered light lists, built on the worker threads every frame
+	vector<PointLight> pointLights;
+	for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+		pointLights.push_back(PointLight(lightPositions[i], lightColors[i], 60.0f));
+	ClusteredLights clusteredLights;
+	WorkerPool workers;
 	int nrRows = 7;
 	int nrColumns = 7;
 	float spacing = 2.5;
 
+	// pbr: per-instance transforms and material parameters, rows*column spheres with varying
+	// metallic/roughness values followed by the light markers (simply the same sphere at the light positions,
+	// this looks a bit off as we use the same shader, but it'll make their positions obvious)
+	// ----------------------------------------------------------------------------------------------------------
+	vector<PBRInstance> pbrInstances;
+	pbrInstances.reserve(nrRows * nrColumns + sizeof(lightPositions) / sizeof(lightPositions[0]));
+	for (int row = 0; row < nrRows; ++row)
+	{
+		for (int col = 0; col < nrColumns; ++col)
+		{
+			// we clamp the roughness to 0.025 - 1.0 as perfectly smooth surfaces (roughness of 0.0) tend to look a bit off
+			// on direct lighting.
+			PBRInstance instance;
+			instance.positionScale = glm::vec4((float)(col - (nrColumns / 2)) * spacing, (float)(row - (nrRows / 2)) * spacing, -2.0f, 1.0f);
+			instance.material = glm::vec4((float)row / (float)nrRows, glm::clamp((float)col / (float)nrColumns, 0.05f, 1.0f), 0.0f, 0.0f);
+			pbrInstances.push_back(instance);
+		}
+	}
+	for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+	{
+		// the light markers use the material of the last grid sphere
+		PBRInstance instance;
+		instance.positionScale = glm::vec4(lightPositions[i], 0.5f);
+		instance.material = glm::vec4((float)(nrRows - 1) / (float)nrRows, glm::clamp((float)(nrColumns - 1) / (float)nrColumns, 0.05f, 1.0f), 0.0f, 0.0f);
+		pbrInstances.push_back(instance);
+	}
+	// every sphere gets the LOD level of its own size on screen, so the instances are regrouped by level
+	// each frame and the buffer is rewritten; each level's VAO then reads its own slice of it
+	InstanceBuffer pbrInstanceBuffer(InstanceLayout(sizeof(PBRInstance))
+		.add(4, GL_FLOAT, offsetof(PBRInstance, positionScale))
+		.add(4, GL_FLOAT, offsetof(PBRInstance, material)), (unsigned int)pbrInstances.size(), INSTANCES_STREAM);
+	vector<PBRInstance> pbrInstancesByLevel(pbrInstances.size());
+	vector<unsigned int> pbrInstanceLevels(pbrInstances.size());
+
 	// pbr: setup framebuffer
 	// ----------------------
 	unsigned int captureFBO;
@@ -143,7 +240,7 @@ int main() {
 	glGenFramebuffers(1, &captureFBO);
 	glGenRenderbuffers(1, &captureRBO);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
 	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
@@ -157,7 +254,7 @@ int main() {
 	if (data)
 	{
 		glGenTextures(1, &hdrTexture);
-		glBindTexture(GL_TEXTURE_2D, hdrTexture);
+		glState().bindTexture(GL_TEXTURE_2D, hdrTexture);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data); // note how we specify the texture's data value to be float
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -176,7 +273,7 @@ int main() {
 	// ---------------------------------------------------------
 	unsigned int envCubemap;
 	glGenTextures(1, &envCubemap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+	glState().bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 	for (unsigned int i = 0; i < 6; ++i)
 	{
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
@@ -205,11 +302,11 @@ int main() {
 	equirectangularToCubemapShader.use();
 	equirectangularToCubemapShader.setInt("equirectangularMap", 0);
 	equirectangularToCubemapShader.setMat4("projection", captureProjection);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, hdrTexture);
+	glState().activeTexture(GL_TEXTURE0);
+	glState().bindTexture(GL_TEXTURE_2D, hdrTexture);
 
-	glViewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	glState().viewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
+	glState().bindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	for (unsigned int i = 0; i < 6; ++i)
 	{
 		equirectangularToCubemapShader.setMat4("view", captureViews[i]);
@@ -218,13 +315,13 @@ int main() {
 
 		renderCube();
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	// pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
 	// --------------------------------------------------------------------------------
 	unsigned int irradianceMap;
 	glGenTextures(1, &irradianceMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+	glState().bindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
 	for (unsigned int i = 0; i < 6; ++i)
 	{
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
@@ -235,7 +332,7 @@ int main() {
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
 
@@ -244,11 +341,11 @@ int main() {
 	irradianceShader.use();
 	irradianceShader.setInt("environmentMap", 0);
 	irradianceShader.setMat4("projection", captureProjection);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+	glState().activeTexture(GL_TEXTURE0);
+	glState().bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 
-	glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	glState().viewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
+	glState().bindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	for (unsigned int i = 0; i < 6; ++i)
 	{
 		irradianceShader.setMat4("view", captureViews[i]);
@@ -257,20 +354,25 @@ int main() {
 
 		renderCube();
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	// initialize static shader uniforms before rendering
 	// --------------------------------------------------
 	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
-	pbrShader.use();
-	pbrShader.setMat4("projection", projection);
-	backgroundShader.use();
-	backgroundShader.setMat4("projection", projection);
+	clusteredLights.setProjection(glm::radians(camera.Zoom), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
+
+	// materials: the sampler uniforms are resolved once here, binding them later is only a compare when nothing changed
+	Material& pbrMaterial = Material::Create(pbrShader, { { "irradianceMap", GL_TEXTURE_CUBE_MAP, irradianceMap } });
+	Material& skyboxMaterial = Material::Create(backgroundShader, { { "environmentMap", GL_TEXTURE_CUBE_MAP, envCubemap } });
+	//Material& skyboxMaterial = Material::Create(backgroundShader, { { "environmentMap", GL_TEXTURE_CUBE_MAP, irradianceMap } }); // display irradiance map
+	RenderQueue renderQueue;
 
 	// then before rendering, configure the viewport to the original framebuffer's screen dimensions
 	int scrWidth, scrHeight;
 	glfwGetFramebufferSize(window, &scrWidth, &scrHeight);
-	glViewport(0, 0, scrWidth, scrHeight);
+	glState().viewport(0, 0, scrWidth, scrHeight);
+	windowWidth = scrWidth;
+	windowHeight = scrHeight;
 
 
 //	
@@ -279,12 +381,37 @@ int main() {
 
 	while (!glfwWindowShouldClose(window))
 	{
+		// minimized: nothing to draw into until the window comes back
+		if (windowWidth == 0 || windowHeight == 0)
+		{
+			glfwWaitEvents();
+			continue;
+		}
+		// resized: everything sized by the window follows
+		if (windowWidth != scrWidth || windowHeight != scrHeight)
+		{
+			scrWidth = windowWidth;
+			scrHeight = windowHeight;
+			projection = glm::perspective(glm::radians(camera.Zoom), (float)scrWidth / (float)scrHeight, 0.1f, 100.0f);
+			clusteredLights.setProjection(glm::radians(camera.Zoom), (float)scrWidth / (float)scrHeight, 0.1f, 100.0f);
+		}
+
 		// per-frame time logic
 		// --------------------
 		float currentFrame = static_cast<float>(glfwGetTime());
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
+		// frame stats, printed once a second
+		glState().beginFrame();
+		frameRing.beginFrame();
+		if (currentFrame - lastStatsTime >= 1.0f)
+		{
+			glState().printStats();
+			frameRing.printStats();
+			lastStatsTime = currentFrame;
+		}
+
 		// input
 		// -----
 		processInput(window);
@@ -296,64 +423,56 @@ int main() {
 
 		// render scene, supplying the convoluted irradiance map to the final shader.
 		// ------------------------------------------------------------------------------------------
-		pbrShader.use();
+		// the camera goes to both shaders through one uniform block instead of a glUniform call each
 		glm::mat4 view = camera.GetViewMatrix();
-		pbrShader.setMat4("view", view);
-		pbrShader.setVec3("camPos", camera.Position);
-
-		// bind pre-computed IBL data
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-
-		// render rows*column number of spheres with varying metallic/roughness values scaled by rows and columns respectively
-		glm::mat4 model = glm::mat4(1.0f);
-		for (int row = 0; row < nrRows; ++row)
+		FrameConstants constants;
+		constants.projection = projection;
+		constants.view = view;
+		constants.camPos = glm::vec4(camera.Position, 1.0f);
+		frameRing.bindRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, frameRing.push(constants));
+		clusteredLights.update(pointLights, view, workers);
+		clusteredLights.bind(pbrShader, scrWidth, scrHeight);
+		renderQueue.begin(view, 0.1f, 100.0f);
+
+		// render every pbr sphere (material grid and light markers), each tessellated for its own size on
+		// screen: the instances are grouped by LOD level and every level used is one instanced draw
+		unsigned int levelCounts[Primitives::SPHERE_LOD_COUNT] = { 0 };
+		for (unsigned int i = 0; i < pbrInstances.size(); ++i)
 		{
-			pbrShader.setFloat("metallic", (float)row / (float)nrRows);
-			for (int col = 0; col < nrColumns; ++col)
-			{
-				// we clamp the roughness to 0.025 - 1.0 as perfectly smooth surfaces (roughness of 0.0) tend to look a bit off
-				// on direct lighting.
-				pbrShader.setFloat("roughness", glm::clamp((float)col / (float)nrColumns, 0.05f, 1.0f));
-
-				model = glm::mat4(1.0f);
-				model = glm::translate(model, glm::vec3(
-					(float)(col - (nrColumns / 2)) * spacing,
-					(float)(row - (nrRows / 2)) * spacing,
-					-2.0f
-				));
-				pbrShader.setMat4("model", model);
-				pbrShader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(model))));
-				renderSphere();
-			}
+			float distance = glm::length(glm::vec3(pbrInstances[i].positionScale) - camera.Position);
+			float radiusPixels = Primitives::ProjectedRadius(pbrInstances[i].positionScale.w, distance, glm::radians(camera.Zoom), (float)scrHeight);
+			pbrInstanceLevels[i] = Primitives::SphereLODForScreenSize(radiusPixels);
+			levelCounts[pbrInstanceLevels[i]]++;
 		}
-
-
-		// render light source (simply re-render sphere at light positions)
-		// this looks a bit off as we use the same shader, but it'll make their positions obvious and 
-		// keeps the codeprint small.
-		for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+		unsigned int levelFirst[Primitives::SPHERE_LOD_COUNT];
+		unsigned int levelNext[Primitives::SPHERE_LOD_COUNT];
+		for (unsigned int level = 0, first = 0; level < Primitives::SPHERE_LOD_COUNT; first += levelCounts[level++])
+			levelFirst[level] = levelNext[level] = first;
+		for (unsigned int i = 0; i < pbrInstances.size(); ++i)
+			pbrInstancesByLevel[levelNext[pbrInstanceLevels[i]]++] = pbrInstances[i];
+		pbrInstanceBuffer.update(pbrInstancesByLevel);
+		for (unsigned int level = 0; level < Primitives::SPHERE_LOD_COUNT; level++)
 		{
-			glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
-			newPos = lightPositions[i];
-			pbrShader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-			pbrShader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
-
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, newPos);
-			model = glm::scale(model, glm::vec3(0.5f));
-			pbrShader.setMat4("model", model);
-			pbrShader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(model))));
-			renderSphere();
+			if (levelCounts[level] == 0)
+				continue;
+			const Primitive& sphere = Primitives::SphereLOD(level);
+			pbrInstanceBuffer.layout.attach(sphere.VAO, pbrInstanceBuffer.ID, pbrInstanceBuffer.regionOffset() + levelFirst[level] * sizeof(PBRInstance));
+			DrawItem spheres = sphere.drawItem();
+			spheres.shader = &pbrShader;
+			spheres.material = &pbrMaterial;
+			spheres.instanceCount = levelCounts[level];
+			renderQueue.submit(PASS_OPAQUE, spheres, glm::vec3(0.0f, 0.0f, -2.0f));
 		}
 
-		// render skybox (render as last to prevent overdraw)
-		backgroundShader.use();
-		backgroundShader.setMat4("view", view);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-		//glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap); // display irradiance map
-		renderCube();
+		// render skybox (background pass, after all opaque geometry to prevent overdraw)
+		DrawItem skybox = Primitives::Cube().drawItem();
+		skybox.shader = &backgroundShader;
+		skybox.material = &skyboxMaterial;
+		renderQueue.submit(PASS_BACKGROUND, skybox);
+
+		renderQueue.sort();
+		renderQueue.flush();
+		frameRing.endFrame();
 
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -437,176 +556,23 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 }
 // renders (and builds at first invocation) a sphere
 // -------------------------------------------------
-unsigned int sphereVAO = 0;
-unsigned int indexCount;
 void renderSphere()
 {
-	if (sphereVAO == 0)
-	{
-		glGenVertexArrays(1, &sphereVAO);
-
-		unsigned int vbo, ebo;
-		glGenBuffers(1, &vbo);
-		glGenBuffers(1, &ebo);
-
-		std::vector<glm::vec3> positions;
-		std::vector<glm::vec2> uv;
-		std::vector<glm::vec3> normals;
-		std::vector<unsigned int> indices;
-
-		const unsigned int X_SEGMENTS = 64;
-		const unsigned int Y_SEGMENTS = 64;
-		const float PI = 3.14159265359f;
-		for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
-		{
-			for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
-			{
-				float xSegment = (float)x / (float)X_SEGMENTS;
-				float ySegment = (float)y / (float)Y_SEGMENTS;
-				float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-				float yPos = std::cos(ySegment * PI);
-				float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-
-				positions.push_back(glm::vec3(xPos, yPos, zPos));
-				uv.push_back(glm::vec2(xSegment, ySegment));
-				normals.push_back(glm::vec3(xPos, yPos, zPos));
-			}
-		}
-
-		bool oddRow = false;
-		for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
-		{
-			if (!oddRow) // even rows: y == 0, y == 2; and so on
-			{
-				for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
-				{
-					indices.push_back(y * (X_SEGMENTS + 1) + x);
-					indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-				}
-			}
-			else
-			{
-				for (int x = X_SEGMENTS; x >= 0; --x)
-				{
-					indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-					indices.push_back(y * (X_SEGMENTS + 1) + x);
-				}
-			}
-			oddRow = !oddRow;
-		}
-		indexCount = static_cast<unsigned int>(indices.size());
-
-		std::vector<float> data;
-		for (unsigned int i = 0; i < positions.size(); ++i)
-		{
-			data.push_back(positions[i].x);
-			data.push_back(positions[i].y);
-			data.push_back(positions[i].z);
-			if (normals.size() > 0)
-			{
-				data.push_back(normals[i].x);
-				data.push_back(normals[i].y);
-				data.push_back(normals[i].z);
-			}
-			if (uv.size() > 0)
-			{
-				data.push_back(uv[i].x);
-				data.push_back(uv[i].y);
-			}
-		}
-		glBindVertexArray(sphereVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-		unsigned int stride = (3 + 2 + 3) * sizeof(float);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-	}
-
-	glBindVertexArray(sphereVAO);
-	glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+	Primitives::Sphere().draw();
 }
 
-
-
 // renderCube() renders a 1x1 3D cube in NDC.
 // -------------------------------------------------
-unsigned int cubeVAO = 0;
-unsigned int cubeVBO = 0;
 void renderCube()
 {
-	// initialize (if necessary)
-	if (cubeVAO == 0)
-	{
-		float vertices[] = {
-			// back face
-			-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-			 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-			 1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
-			 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-			-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-			-1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
-			// front face
-			-1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-			 1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
-			 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-			 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-			-1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
-			-1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-			// left face
-			-1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-			-1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
-			-1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-			-1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-			-1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-			-1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-			// right face
-			 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-			 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-			 1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
-			 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-			 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-			 1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
-			 // bottom face
-			 -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-			  1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
-			  1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-			  1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-			 -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-			 -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-			 // top face
-			 -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-			  1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-			  1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
-			  1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-			 -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-			 -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
-		};
-		glGenVertexArrays(1, &cubeVAO);
-		glGenBuffers(1, &cubeVBO);
-		// fill buffer
-		glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-		// link vertex attributes
-		glBindVertexArray(cubeVAO);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-	}
-	// render Cube
-	glBindVertexArray(cubeVAO);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
+	Primitives::Cube().draw();
+}
+
+// renderQuad() renders a 1x1 XY quad in NDC
+// -----------------------------------------
+void renderQuad()
+{
+	Primitives::Quad().draw();
 }
 
 
@@ -641,7 +607,10 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 
 //handles viewport resizing on window resizing
 void framebuffer_size_callback(GLFWwindow* widnow, int WIDTH, int HEIGHT) {
-	glViewport(0, 0, WIDTH, HEIGHT);
+	glState().viewport(0, 0, WIDTH, HEIGHT);
+	// the render loop resizes what depends on it before the next frame
+	windowWidth = WIDTH;
+	windowHeight = HEIGHT;
 
 }
 
@@ -671,7 +640,7 @@ unsigned int loadTexture(char const* path, bool gammaCorrection)
 			internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
 			dataFormat = GL_RGBA;
 		}
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		glState().bindTexture(GL_TEXTURE_2D, textureID);
 		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -696,7 +665,7 @@ unsigned int loadCubemap(vector<std::string> faces)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++)
@@ -2068,67 +2037,19 @@ glEnableVertexAttribArray(2);*/
 //
 ////asteroids - without instancing
 //unsigned int amount = 100000;
-//glm::mat4* modelMatrices;
-//modelMatrices = new glm::mat4[amount];
-//srand(glfwGetTime());
 //float radius = 150.0;
 //offset = 25.0f;
-//for (unsigned int i = 0; i < amount; i++)
-//{
-//	//here we create the translation for our asteroids.
-//	glm::mat4 model = glm::mat4(1.0);
-//	float angle = (float)i / (float)amount * 360.0f;
-//	float displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-//	float x = sin(angle) * radius + displacement;
-//	displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-//	float y = displacement * 0.4f; // keep height of field smaller compared to width of x and z
-//	displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-//	float z = cos(angle) * radius + displacement;
-//	model = glm::translate(model, glm::vec3(x, y, z));
-//
-//	//scale asteroids
-//	float scale = (rand() % 20) / 100.0 + 0.05f;
-//	model = glm::scale(model, glm::vec3(scale));
-//
-//	//rotation
-//	float rotAngle = (rand() % 360);
-//	model = glm::rotate(model, rotAngle, glm::vec3(0.4f, 0.6f, 0.8f));
-//
-//	//add to the list of matrices
-//	modelMatrices[i] = model;
-//}
+//// compact transforms and a world space bounding sphere per rock, see asteroids.h
+//AsteroidField asteroids;
+//asteroids.generate(amount, radius, offset, rock.boundingSphere, (unsigned int)glfwGetTime());
+//vector<uint32_t> visibleAsteroids;
+//vector<CompactInstance> visibleRocks(amount);
 //
-////setting attribues for the mat4 layout attribute instanced arrays:
-//// vertex buffer object
-//unsigned int buffer;
-//glGenBuffers(1, &buffer);
-//glBindBuffer(GL_ARRAY_BUFFER, buffer);
-//glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
+//// instance buffer of 32 byte compact transforms (locations 8-9, clear of the mesh's tangent/bone attributes at 3-6),
+//// refilled every frame with the rocks that survive culling; instancedCompact.vs rebuilds the transform
+//InstanceBuffer asteroidInstances(InstanceLayout::Compact(), amount, INSTANCES_STREAM);
 //
-//for (unsigned int i = 0; i < rock.meshes.size(); i++)
-//{
-//	unsigned int VAO = rock.meshes[i].VAO; // not that good but works here
-//	glBindVertexArray(VAO);
-//	// vertex attributes
-//	std::size_t vec4Size = sizeof(glm::vec4);
-//	glEnableVertexAttribArray(3);
-//	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)0);
-//	glEnableVertexAttribArray(4);
-//	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(1 * vec4Size));
-//	glEnableVertexAttribArray(5);
-//	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(2 * vec4Size));
-//	glEnableVertexAttribArray(6);
-//	glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(3 * vec4Size));
-//
-//	glVertexAttribDivisor(3, 1);
-//	glVertexAttribDivisor(4, 1);
-//	glVertexAttribDivisor(5, 1);
-//	glVertexAttribDivisor(6, 1);
-//
-//	glBindVertexArray(0);
-//}
-//
-//Shader shader("simpleVert.vs", "default.frag");
+//Shader shader("instancedCompact.vs", "default.frag");
 
 
 
@@ -2142,30 +2063,103 @@ glEnableVertexAttribArray(2);*/
 //
 //
 //// draw planet
+//Frustum frustum(projection * view);
 //shader.use();
 //glm::mat4 model = glm::mat4(1.0f);
 //model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
 //model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
 //shader.setMat4("model", model);
-//planet.Draw(shader);
+//planet.Draw(shader, frustum, model);
 //
 ////// draw meteorites wihtout isntances
 ////for (unsigned int i = 0; i < amount; i++)
 ////{
-////	shader.setMat4("model", modelMatrices[i]);
-////	rock.Draw(shader);
+////	shader.setMat4("model", asteroids.instances[i].matrix());
+////	rock.Draw(shader, frustum, asteroids.instances[i].matrix());
 ////}
 //
-//shader.use();
-//shader.setInt("texture_diffuse1", 0);
-//glActiveTexture(GL_TEXTURE0);
-//glBindTexture(GL_TEXTURE_2D, rock.textures_loaded[0].id); // GL_TEXTURE_2D_MULTISAMPLED for msaa!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+//// cull the rocks against the view frustum and upload only the visible ones
+//size_t visibleCount = cullSpheres(frustum, asteroids.bounds, visibleAsteroids);
+//// optional: drop the rocks hidden behind the planet too, rasterized on the CPU into a small depth buffer
+//// (see softocclusion.h; occlusionBuffer, planetOccluder = Occluder::Sphere() and workers are made once)
+//occlusionBuffer.begin(projection * view);
+//occlusionBuffer.addOccluder(planetOccluder, model);
+//occlusionBuffer.rasterize(workers);
+//visibleCount = occlusionBuffer.cullSpheres(asteroids.bounds, visibleAsteroids);
+//// optional: rocks further than impostorDistance are drawn as octahedral impostors, one quad each
+//// (see impostor.h; rockImpostor(rock), impostorShader("impostor.vs", "impostor.frag") and a second compact
+//// InstanceBuffer impostorInstances are made once, and the impostor shader gets projection, view and camPos)
+//size_t nearCount = partitionByDistance(asteroids.bounds, &visibleAsteroids[0], visibleCount, camera.Position, impostorDistance);
+//for (size_t i = nearCount; i < visibleCount; i++)
+//	visibleRocks[i - nearCount] = asteroids.instances[visibleAsteroids[i]];
+//impostorInstances.update(&visibleRocks[0], (unsigned int)(visibleCount - nearCount));
+//rockImpostor.DrawInstanced(impostorShader, impostorInstances);
+//visibleCount = nearCount;
+//for (size_t i = 0; i < visibleCount; i++)
+//	visibleRocks[i] = asteroids.instances[visibleAsteroids[i]];
+//asteroidInstances.update(&visibleRocks[0], (unsigned int)visibleCount);
+//
 ////draw with instaces!
-//for (unsigned int i = 0; i < rock.meshes.size(); i++) {
-//	glBindVertexArray(rock.meshes[i].VAO);
-//	glDrawElementsInstanced(GL_TRIANGLES, rock.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, amount);
-//	glBindVertexArray(0);
-//}
+//rock.DrawInstanced(shader, asteroidInstances);
+//
+//// a heavy model that may hide behind the planet: drawn under a hardware occlusion query on its box
+//// (see occlusionquery.h; occlusionQueries is made once, beginFrame(projection, view) at the start of the frame)
+//glm::mat4 shipModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -80.0f));
+//shader.use();
+//shader.setMat4("model", shipModel);
+//occlusionQueries.draw(backpack, shader, frustum, shipModel);
+//
+//// visibility buffer alternative: the geometry pass writes only depth and a triangle ID per pixel, whatever the
+//// overdraw, and resolve() shades every pixel once (see visibility.h; visibilityBuffer(WIDTH, HEIGHT) is made once,
+//// clusteredLights as in the PBR lesson)
+//visibilityBuffer.begin(projection, view);
+//visibilityBuffer.draw(planet, model);
+//visibilityBuffer.drawInstanced(rock, asteroidInstances);
+//visibilityBuffer.draw(backpack, shipModel);
+//clusteredLights.update(pointLights, view);
+//visibilityBuffer.resolve(clusteredLights, camera.Position);
+//glBindFramebuffer(GL_READ_FRAMEBUFFER, visibilityBuffer.resolveFBO);
+//glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+//glBlitFramebuffer(0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+//// GPU driven alternative: culling and LOD selection in a compute pass, all rocks in one multi-draw (see gpuculling.h).
+//// setup, once:
+//InstanceCuller rockCuller({ &rock }, { 1000.0f });
+//rockCuller.setInstances(asteroids.modelMatrices());
+//Shader cullShader("instancedCull.vs", "default.frag");
+//// every frame:
+//cullShader.use();
+//cullShader.setMat4("projection", projection);
+//cullShader.setMat4("view", view);
+//rockCuller.cull(projection, view, camera.Position);
+//rockCuller.draw(cullShader);
+//
+//// with occlusion culling the scene renders into sceneFBO (depth texture sceneDepth) in two phases, rocks behind
+//// the planet are then never drawn. setup, once:
+//HiZPyramid depthPyramid(WIDTH, HEIGHT);
+//rockCuller.setOcclusion(&depthPyramid);
+//// every frame: last frame's visible rocks and the planet first, they are the occluders
+//glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+//planet.Draw(shader, frustum, model);
+//rockCuller.cull(projection, view, camera.Position, CULL_EARLY);
+//rockCuller.draw(cullShader);
+//// then everything else that isn't behind them
+//depthPyramid.build(sceneDepth);
+//glState().bindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+//glState().viewport(0, 0, WIDTH, HEIGHT);
+//rockCuller.cull(projection, view, camera.Position, CULL_LATE);
+//rockCuller.draw(cullShader);
+
+//// animated alternative: the rocks orbit and spin, simulated on all cores straight into a persistently mapped buffer
+//// (see AsteroidSimulation in asteroids.h), setup, once:
+//AsteroidSimulation ring;
+//ring.generate(amount, radius, offset, (uint64_t)glfwGetTime());
+//WorkerPool workers;
+//InstanceBuffer ringInstances(InstanceLayout::Compact(), amount, INSTANCES_PERSISTENT);
+//// every frame:
+//ring.update(deltaTime, (CompactInstance*)ringInstances.beginUpdate(amount), workers);
+//ringInstances.endUpdate();
+//rock.DrawInstanced(shader, ringInstances);
 
 
 
@@ -2310,6 +2304,12 @@ glEnableVertexAttribArray(2);*/
 		//glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
 		//glBindFramebuffer(GL_DRAW_FRAMEBUFFER, intermediateFBO);
 		//glBlitFramebuffer(0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		//// (PostProcess::apply(textureColorBufferMultiSampled, 0, 0, WIDTH, HEIGHT, 4) resolves and draws to the
+		//// window in one pass without the intermediate framebuffer; TONEMAP_NONE and gamma 1 for this LDR scene)
+		//// (or keep the scene single sampled, which also works for the deferred and SSAO G-buffers, and let
+		//// AntiAliasing aa(WIDTH, HEIGHT, AA_SMAA) filter the tone mapped image:
+		//// post.apply(sceneTexture, 0, aa.target(0), WIDTH, HEIGHT, aa.sceneSamples()); aa.apply(0);
+		//// aa.mode switches between AA_NONE, AA_MSAA (needs the 4x framebuffer above), AA_FXAA and AA_SMAA at runtime)
 
 		//// 3. now render quad with scene's visuals as its texture image
 		//glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -2675,6 +2675,13 @@ glEnableVertexAttribArray(2);*/
 	//lightColors.push_back(glm::vec3(10.0f, 0.0f, 0.0f));
 	//lightColors.push_back(glm::vec3(0.0f, 0.0f, 15.0f));
 	//lightColors.push_back(glm::vec3(0.0f, 5.0f, 0.0f));
+	//// the lighting shader reads them from the clustered light lists, the radius is where the falloff reaches 0
+	//vector<PointLight> pointLights;
+	//for (unsigned int i = 0; i < lightPositions.size(); i++)
+	//	pointLights.push_back(PointLight(lightPositions[i], lightColors[i], 15.0f));
+	//ClusteredLights clusteredLights;
+	//clusteredLights.setProjection(glm::radians(camera.Zoom), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
+	//WorkerPool workers;
 
 
 	//// shader configuration
@@ -2686,6 +2693,14 @@ glEnableVertexAttribArray(2);*/
 	//shaderBloomFinal.use();
 	//shaderBloomFinal.setInt("scene", 0);
 	//shaderBloomFinal.setInt("bloomBlur", 1);
+	//// or the mip chain bloom (bloom.h) in place of the ping-pong framebuffers:
+	//Bloom bloomChain(WIDTH, HEIGHT, 6);
+	//// and the fused post-processing pass (postprocess.h) in place of shaderBloomFinal:
+	//PostProcess post;
+	//AutoExposure autoExposure; // measures the HDR scene every frame, exposure then only compensates
+	//// and with dynamic resolution (dynamicresolution.h) hdrFBO's targets and bloomChain follow its render size:
+	//DynamicResolution resolution(WIDTH, HEIGHT, 16.6f); // setWindowSize(windowWidth, windowHeight) after a resize
+	//GpuTimer timer;
 
 //glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
 //glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -2695,14 +2710,11 @@ glEnableVertexAttribArray(2);*/
 //shader.use();
 //shader.setMat4("projection", projection);
 //shader.setMat4("view", view);
+//// assign the lights to the clusters of this view; bind() leaves another unit active, so it goes before the texture binds
+//clusteredLights.update(pointLights, view, workers);
+//clusteredLights.bind(shader, WIDTH, HEIGHT);
 //glActiveTexture(GL_TEXTURE0);
 //glBindTexture(GL_TEXTURE_2D, woodTexture);
-//// set lighting uniforms
-//for (unsigned int i = 0; i < lightPositions.size(); i++)
-//{
-//	shader.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-//	shader.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
-//}
 //shader.setVec3("viewPos", camera.Position);
 //// create one large cube that acts as the floor
 //model = glm::mat4(1.0f);
@@ -2780,6 +2792,25 @@ glEnableVertexAttribArray(2);*/
    //		first_iteration = false;
    //}
    //glBindFramebuffer(GL_FRAMEBUFFER, 0);
+   //// with the mip chain bloom, 2. is
+   ////bloomChain.apply(colorBuffers[1]);
+   //// and 3. binds bloomChain.result on unit 1 with bloomStrength 1.0f / bloomChain.levelCount()
+   //// or with the fused pass, 3. is
+   ////autoExposure.update(colorBuffers[0], WIDTH, HEIGHT, deltaTime);
+   ////post.autoExposure = autoExposure.exposureTexture();
+   ////post.exposure = exposure;
+   ////post.bloom = bloom > 0.0f;
+   ////post.bloomStrength = 1.0f / bloomChain.levelCount();
+   ////post.apply(colorBuffers[0], bloomChain.result, 0, WIDTH, HEIGHT);
+   //// with dynamic resolution everything before it draws at resolution.renderWidth x renderHeight, between
+   ////timer.beginFrame();
+   ////if (resolution.update(timer.last("frame")))
+   ////	bloomChain.resize(resolution.renderWidth, resolution.renderHeight); // and reallocate colorBuffers and rboDepth
+   ////timer.begin("frame"); // after the frame's CPU work, or the GPU's wait for it counts as frame time
+   //// and timer.end("frame") after post.apply(colorBuffers[0], bloomChain.result, 0, windowWidth, windowHeight), which scales
+   //// the scene up by post.upscale (UPSCALE_EDGE or UPSCALE_BILINEAR). With TemporalAA at window size in front of it,
+   //// taa.jitter = camera.GetJitter() and the scene drawn with camera.GetJitteredProjection(projection, renderWidth,
+   //// renderHeight), that is the upscale instead.
 
    //// 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
    //// --------------------------------------------------------------------------------------------------------------------------
@@ -2794,6 +2825,8 @@ glEnableVertexAttribArray(2);*/
    //renderQuad();
 
    //std::cout << "bloom: " << (bloom ? "on" : "off") << "| exposure: " << exposure << std::endl;
+   ////if (autoExposure.readbackAvailable) // a few frames old, never waits for the GPU
+   ////	std::cout << "scene luminance: " << autoExposure.readbackLuminance << "| exposure: " << autoExposure.readbackExposure << std::endl;
 
 
 
@@ -2811,48 +2844,11 @@ glEnableVertexAttribArray(2);*/
 //// -----------
 //	Model backpack("backpack/backpack.obj");
 //
-//	// configure g-buffer framebuffer
+//	// configure g-buffer framebuffer: the compact layout keeps normals octahedral encoded and rebuilds positions
+//	// from depth, 8 instead of 20 bytes per pixel (GBUFFER_CLASSIC for the position target)
 //	// ------------------------------
-//	unsigned int gBuffer;
-//	glGenFramebuffers(1, &gBuffer);
-//	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-//	unsigned int gPosition, gNormal, gAlbedo;
-//	// position color buffer
-//	glGenTextures(1, &gPosition);
-//	glBindTexture(GL_TEXTURE_2D, gPosition);
-//	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, WIDTH, HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-//	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
-//	// normal color buffer
-//	glGenTextures(1, &gNormal);
-//	glBindTexture(GL_TEXTURE_2D, gNormal);
-//	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, WIDTH, HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-//	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
-//	// color + specular color buffer
-//	glGenTextures(1, &gAlbedo);
-//	glBindTexture(GL_TEXTURE_2D, gAlbedo);
-//	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, WIDTH, HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-//	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedo, 0);
-//	// tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
-//	unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-//	glDrawBuffers(3, attachments);
-//	// create and attach depth buffer (renderbuffer)
-//	unsigned int rboDepth;
-//	glGenRenderbuffers(1, &rboDepth);
-//	glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-//	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, WIDTH, HEIGHT);
-//	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-//	// finally check if framebuffer is complete
-//	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-//		std::cout << "Framebuffer not complete!" << std::endl;
-//	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+//	GBuffer gBuffer(WIDTH, HEIGHT, GBUFFER_COMPACT);
+//	std::cout << "g-buffer: " << gBuffer.bytesPerPixel() << " bytes per pixel + depth" << std::endl;
 //
 //	// also create framebuffer to hold SSAO processing stage 
 //	// -----------------------------------------------------
@@ -2922,21 +2918,19 @@ glEnableVertexAttribArray(2);*/
 //
 //	// shader configuration
 //	// --------------------
+//	// (the g-buffer samplers are set by gBuffer.bind)
 //	shaderLightingPass.use();
-//	shaderLightingPass.setInt("gPosition", 0);
-//	shaderLightingPass.setInt("gNormal", 1);
-//	shaderLightingPass.setInt("gAlbedo", 2);
 //	shaderLightingPass.setInt("ssao", 3);
 //	shaderSSAO.use();
-//	shaderSSAO.setInt("gPosition", 0);
-//	shaderSSAO.setInt("gNormal", 1);
-//	shaderSSAO.setInt("texNoise", 2);
+//	shaderSSAO.setInt("texNoise", 3);
+//	gBuffer.setLayout(shaderGeometryPass);
 //	shaderSSAOBlur.use();
 //	shaderSSAOBlur.setInt("ssaoInput", 0);
+//	// or the reduced resolution pipeline (ssao.h) in place of the ssao and blur stages above:
+//	SSAO ssao(WIDTH, HEIGHT, 2, 16); // resolution divisor, samples; both can change between frames
 
 //1. geometry pass - gbuffer (geometry, color)
-		//glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-		//glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		//gBuffer.begin();
 		//glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)WIDTH / (float)HEIGHT, 0.1f, 50.0f);
 		//glm::mat4 view = camera.GetViewMatrix();
 		//glm::mat4 model = glm::mat4(1.0f);
@@ -2968,11 +2962,9 @@ glEnableVertexAttribArray(2);*/
 		//for (unsigned int i = 0; i < 64; ++i)
 		//	shaderSSAO.setVec3("samples[" + std::to_string(i) + "]", ssaoKernel[i]);
 		//shaderSSAO.setMat4("projection", projection);
-		//glActiveTexture(GL_TEXTURE0);
-		//glBindTexture(GL_TEXTURE_2D, gPosition);
-		//glActiveTexture(GL_TEXTURE1);
-		//glBindTexture(GL_TEXTURE_2D, gNormal);
-		//glActiveTexture(GL_TEXTURE2);
+		//shaderSSAO.setVec2("noiseScale", WIDTH / 4.0f, HEIGHT / 4.0f);
+		//gBuffer.bind(shaderSSAO, projection, view);
+		//glActiveTexture(GL_TEXTURE3);
 		//glBindTexture(GL_TEXTURE_2D, noiseTexture);
 		//renderQuad();
 		//glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -2998,15 +2990,19 @@ glEnableVertexAttribArray(2);*/
 		//const float quadratic = 0.032f;
 		//shaderLightingPass.setFloat("light.Linear", linear);
 		//shaderLightingPass.setFloat("light.Quadratic", quadratic);
-		//glActiveTexture(GL_TEXTURE0);
-		//glBindTexture(GL_TEXTURE_2D, gPosition);
-		//glActiveTexture(GL_TEXTURE1);
-		//glBindTexture(GL_TEXTURE_2D, gNormal);
-		//glActiveTexture(GL_TEXTURE2);
-		//glBindTexture(GL_TEXTURE_2D, gAlbedo);
+		//gBuffer.bind(shaderLightingPass, projection, view);
 		//glActiveTexture(GL_TEXTURE3); // add extra SSAO texture to lighting pass
 		//glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
 		//renderQuad();
+		//// with the reduced resolution pipeline, 2. and 3. are
+		////ssao.compute(gBuffer, projection, view);
+		//// and the lighting pass reads ssao.result on unit 3 instead of ssaoColorBufferBlur
+		//// temporally (temporal.h), with GBuffer(WIDTH, HEIGHT, GBUFFER_COMPACT, true), TemporalAccumulation aoHistory(WIDTH, HEIGHT)
+		//// and ssao.temporal = true; ssao.kernelSize = 8;, after drawing with camera.GetJitteredProjection(projection, WIDTH, HEIGHT):
+		////gBuffer.setMotion(shaderGeometryPass, projection * view, previousViewProjection);
+		////ssao.compute(gBuffer, jittered, view);
+		////aoHistory.apply(ssao.result, gBuffer.velocity, gBuffer.depth, jittered); // the lighting pass reads aoHistory.result
+		////previousViewProjection = projection * view; camera.NextJitter();
 
 //gl_PointSize: draws a point on screen, we set its size, if we set its size to the clip spaces z for example, it will get biggere the further we're from it
 //gl_VertexID: an In variable for hte vertex shader that we can use to index which vertex we're working on
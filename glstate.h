@@ -0,0 +1,391 @@
+
+
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <iostream>
+
+// A thin shadow copy of the GL state the engine touches: program, VAO, buffer bindings, texture units,
+// framebuffers, viewport and depth/stencil/blend state. Every call compares against what is already
+// current and only reaches the driver when something actually changes.
+// All engine code binds through glState() instead of calling glBind*/glUseProgram directly; if something
+// does bypass it (or deletes a bound object), call invalidate() so the next call of each kind is issued.
+class GLStateCache
+{
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+
+    // number of GL calls that went through / were dropped this frame and last frame
+    unsigned int issued;
+    unsigned int elided;
+    unsigned int lastIssued;
+    unsigned int lastElided;
+    // material whose textures are currently bound (0 = none), see Material::bind()
+    unsigned int boundMaterial;
+
+    GLStateCache() : issued(0), elided(0), lastIssued(0), lastElided(0)
+    {
+        invalidate();
+    }
+
+    // forget everything we know, the next call of every kind is issued
+    void invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        for (unsigned int i = 0; i < NUM_BUFFER_TARGETS; i++)
+            buffers[i] = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+            for (unsigned int j = 0; j < NUM_TEXTURE_TARGETS; j++)
+                textures[i][j] = UNKNOWN;
+        readFramebuffer = drawFramebuffer = UNKNOWN;
+        viewportRect[0] = viewportRect[1] = viewportRect[2] = viewportRect[3] = -1;
+        for (unsigned int i = 0; i < NUM_CAPABILITIES; i++)
+            capabilities[i] = -1;
+        depthFn = UNKNOWN;
+        depthWrite = -1;
+        blendSrc = blendDst = UNKNOWN;
+        stencilFn = UNKNOWN;
+        stencilRef = -1;
+        stencilReadMask = UNKNOWN;
+        stencilFail = stencilDepthFail = stencilPass = UNKNOWN;
+        stencilWriteMask = UNKNOWN;
+        restartIndex = UNKNOWN;
+        boundMaterial = 0;
+    }
+
+    // rolls the per-frame counters over, call once at the start of every frame
+    void beginFrame()
+    {
+        lastIssued = issued;
+        lastElided = elided;
+        issued = 0;
+        elided = 0;
+    }
+
+    void printStats() const
+    {
+        std::cout << "gl state: " << lastIssued << " calls issued, " << lastElided << " redundant calls elided" << std::endl;
+    }
+
+    // programs and vertex arrays
+    // ------------------------------------------------------------------------
+    void useProgram(unsigned int id)
+    {
+        if (!changed(program, id))
+            return;
+        glUseProgram(id);
+    }
+    void bindVertexArray(unsigned int vao)
+    {
+        if (!changed(vertexArray, vao))
+            return;
+        glBindVertexArray(vao);
+        // the element buffer binding is part of the VAO, so we no longer know what it is
+        buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+
+    // buffers
+    // ------------------------------------------------------------------------
+    void bindBuffer(GLenum target, unsigned int buffer)
+    {
+        unsigned int slot = bufferSlot(target);
+        if (slot == NUM_BUFFER_TARGETS)
+        {
+            issued++;
+            glBindBuffer(target, buffer);
+            return;
+        }
+        if (!changed(buffers[slot], buffer))
+            return;
+        glBindBuffer(target, buffer);
+    }
+
+    // indexed binding of a uniform/storage block, which also replaces the target's generic binding
+    void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer)
+    {
+        unsigned int slot = bufferSlot(target);
+        if (slot != NUM_BUFFER_TARGETS)
+            buffers[slot] = buffer;
+        issued++;
+        glBindBufferBase(target, index, buffer);
+    }
+    void bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size)
+    {
+        unsigned int slot = bufferSlot(target);
+        if (slot != NUM_BUFFER_TARGETS)
+            buffers[slot] = buffer;
+        issued++;
+        glBindBufferRange(target, index, buffer, offset, size);
+    }
+
+    // textures, units are given as GL_TEXTURE0 + i just like glActiveTexture
+    // ------------------------------------------------------------------------
+    void activeTexture(GLenum unit)
+    {
+        if (!changed(activeUnit, unit - GL_TEXTURE0))
+            return;
+        glActiveTexture(unit);
+    }
+    // binds to the currently active unit
+    void bindTexture(GLenum target, unsigned int texture)
+    {
+        unsigned int slot = textureSlot(target);
+        if (activeUnit >= MAX_TEXTURE_UNITS || slot == NUM_TEXTURE_TARGETS)
+        {
+            issued++;
+            boundMaterial = 0;
+            glBindTexture(target, texture);
+            return;
+        }
+        if (!changed(textures[activeUnit][slot], texture))
+            return;
+        boundMaterial = 0;
+        glBindTexture(target, texture);
+    }
+    void bindTexture(GLenum unit, GLenum target, unsigned int texture)
+    {
+        unsigned int slot = textureSlot(target);
+        unsigned int index = unit - GL_TEXTURE0;
+        // only switch the active unit when the binding on it actually has to change
+        if (index < MAX_TEXTURE_UNITS && slot != NUM_TEXTURE_TARGETS && textures[index][slot] == texture)
+        {
+            elided++;
+            return;
+        }
+        activeTexture(unit);
+        bindTexture(target, texture);
+    }
+
+    // framebuffers and viewport
+    // ------------------------------------------------------------------------
+    void bindFramebuffer(GLenum target, unsigned int fbo)
+    {
+        bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+        bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+        if ((!read || readFramebuffer == fbo) && (!draw || drawFramebuffer == fbo))
+        {
+            elided++;
+            return;
+        }
+        if (read)
+            readFramebuffer = fbo;
+        if (draw)
+            drawFramebuffer = fbo;
+        issued++;
+        glBindFramebuffer(target, fbo);
+    }
+    void viewport(int x, int y, int width, int height)
+    {
+        if (viewportRect[0] == x && viewportRect[1] == y && viewportRect[2] == width && viewportRect[3] == height)
+        {
+            elided++;
+            return;
+        }
+        viewportRect[0] = x; viewportRect[1] = y; viewportRect[2] = width; viewportRect[3] = height;
+        issued++;
+        glViewport(x, y, width, height);
+    }
+
+    // fixed function state
+    // ------------------------------------------------------------------------
+    void enable(GLenum cap)
+    {
+        setCapability(cap, true);
+    }
+    void disable(GLenum cap)
+    {
+        setCapability(cap, false);
+    }
+    void depthFunc(GLenum func)
+    {
+        if (!changed(depthFn, func))
+            return;
+        glDepthFunc(func);
+    }
+    void depthMask(GLboolean flag)
+    {
+        if (depthWrite == (int)flag)
+        {
+            elided++;
+            return;
+        }
+        depthWrite = flag;
+        issued++;
+        glDepthMask(flag);
+    }
+    void blendFunc(GLenum sfactor, GLenum dfactor)
+    {
+        if (blendSrc == sfactor && blendDst == dfactor)
+        {
+            elided++;
+            return;
+        }
+        blendSrc = sfactor;
+        blendDst = dfactor;
+        issued++;
+        glBlendFunc(sfactor, dfactor);
+    }
+    void stencilFunc(GLenum func, int ref, unsigned int mask)
+    {
+        if (stencilFn == func && stencilRef == ref && stencilReadMask == mask)
+        {
+            elided++;
+            return;
+        }
+        stencilFn = func;
+        stencilRef = ref;
+        stencilReadMask = mask;
+        issued++;
+        glStencilFunc(func, ref, mask);
+    }
+    void stencilOp(GLenum sfail, GLenum dpfail, GLenum dppass)
+    {
+        if (stencilFail == sfail && stencilDepthFail == dpfail && stencilPass == dppass)
+        {
+            elided++;
+            return;
+        }
+        stencilFail = sfail;
+        stencilDepthFail = dpfail;
+        stencilPass = dppass;
+        issued++;
+        glStencilOp(sfail, dpfail, dppass);
+    }
+    void stencilMask(unsigned int mask)
+    {
+        if (!changed(stencilWriteMask, mask))
+            return;
+        glStencilMask(mask);
+    }
+
+    // primitive restart for an indexed draw of the given index type. On GL 4.3+ the fixed restart index
+    // (all ones of the index type) simply stays enabled. Older contexts only have a programmable index,
+    // so 0xFFFF is switched on for 16 bit draws and off for 32 bit ones, where 65535 can be a real vertex.
+    void primitiveRestart(GLenum indexType)
+    {
+        if (GLAD_GL_VERSION_4_3)
+        {
+            enable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+            return;
+        }
+        if (indexType != GL_UNSIGNED_SHORT)
+        {
+            disable(GL_PRIMITIVE_RESTART);
+            return;
+        }
+        if (changed(restartIndex, 0xFFFF))
+            glPrimitiveRestartIndex(0xFFFF);
+        enable(GL_PRIMITIVE_RESTART);
+    }
+
+private:
+    static const unsigned int NUM_BUFFER_TARGETS = 8;
+    static const unsigned int NUM_TEXTURE_TARGETS = 5;
+    static const unsigned int NUM_CAPABILITIES = 8;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int buffers[NUM_BUFFER_TARGETS];
+    unsigned int activeUnit;
+    unsigned int textures[MAX_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+    unsigned int readFramebuffer, drawFramebuffer;
+    int viewportRect[4];
+    int capabilities[NUM_CAPABILITIES];
+    unsigned int depthFn;
+    int depthWrite;
+    unsigned int blendSrc, blendDst;
+    unsigned int stencilFn;
+    int stencilRef;
+    unsigned int stencilReadMask;
+    unsigned int stencilFail, stencilDepthFail, stencilPass;
+    unsigned int stencilWriteMask;
+    unsigned int restartIndex;
+
+    // updates the shadow value and counts the call, returns false when the call can be dropped
+    bool changed(unsigned int& current, unsigned int value)
+    {
+        if (current == value)
+        {
+            elided++;
+            return false;
+        }
+        current = value;
+        issued++;
+        return true;
+    }
+
+    void setCapability(GLenum cap, bool on)
+    {
+        unsigned int slot = capabilitySlot(cap);
+        if (slot != NUM_CAPABILITIES)
+        {
+            if (capabilities[slot] == (int)on)
+            {
+                elided++;
+                return;
+            }
+            capabilities[slot] = on;
+        }
+        issued++;
+        if (on)
+            glEnable(cap);
+        else
+            glDisable(cap);
+    }
+
+    static unsigned int bufferSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER:          return 0;
+        case GL_ELEMENT_ARRAY_BUFFER:  return 1;
+        case GL_UNIFORM_BUFFER:        return 2;
+        case GL_SHADER_STORAGE_BUFFER: return 3;
+        case GL_DRAW_INDIRECT_BUFFER:  return 4;
+        case GL_PIXEL_PACK_BUFFER:     return 5;
+        case GL_PIXEL_UNPACK_BUFFER:   return 6;
+        case GL_TEXTURE_BUFFER:        return 7;
+        default:                       return NUM_BUFFER_TARGETS;
+        }
+    }
+    static unsigned int textureSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D:             return 0;
+        case GL_TEXTURE_CUBE_MAP:       return 1;
+        case GL_TEXTURE_2D_MULTISAMPLE: return 2;
+        case GL_TEXTURE_2D_ARRAY:       return 3;
+        case GL_TEXTURE_BUFFER:         return 4;
+        default:                        return NUM_TEXTURE_TARGETS;
+        }
+    }
+    static unsigned int capabilitySlot(GLenum cap)
+    {
+        switch (cap)
+        {
+        case GL_DEPTH_TEST:         return 0;
+        case GL_STENCIL_TEST:       return 1;
+        case GL_BLEND:              return 2;
+        case GL_CULL_FACE:          return 3;
+        case GL_MULTISAMPLE:        return 4;
+        case GL_FRAMEBUFFER_SRGB:   return 5;
+        case GL_PRIMITIVE_RESTART:  return 6;
+        case GL_PRIMITIVE_RESTART_FIXED_INDEX: return 7;
+        default:                    return NUM_CAPABILITIES;
+        }
+    }
+};
+
+// the one state cache of the (single) GL context
+inline GLStateCache& glState()
+{
+    static GLStateCache cache;
+    return cache;
+}
+#endif
@@ -0,0 +1,330 @@
+
+
+#ifndef GPUCULLING_H
+#define GPUCULLING_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "model.h"
+#include "material.h"
+#include "glstate.h"
+#include "culling.h"
+#include "instancing.h"
+#include "hiz.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+// layout of one glMultiDrawElementsIndirect command, as the GL spec defines it
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+// Two-phase occlusion culling with a depth pyramid: CULL_EARLY draws what was visible last frame, then the
+// pyramid is built from that depth, and CULL_LATE tests everything else against it and draws what turned out
+// visible (and remembers the visible set for the next frame). Nothing that becomes visible is ever a frame late,
+// so there is no popping when the camera moves fast; CULL_ALL is plain frustum culling in one pass.
+enum CullPhase {
+    CULL_ALL,
+    CULL_EARLY,
+    CULL_LATE
+};
+
+// Culls and draws a huge number of instances of one model (with up to MAX_LODS levels of detail).
+//
+// All meshes of all LODs are merged into one vertex/index buffer and one VAO. Every frame a compute pass
+// tests each instance against the frustum, picks its LOD by distance and appends the instance index to
+// that LOD's slice of the visible list, counting it in the LOD's indirect draw command. One
+// glMultiDrawElementsIndirect then draws everything, so the CPU does no per-instance work at all and its
+// cost doesn't grow with the instance count. The vertex shader (instancedCull.vs) reads the visible index
+// at attribute 8 and fetches the instance matrix from a buffer texture.
+//
+// Compute shaders and multi-draw-indirect need GL 4.3; on older contexts the same lists are built on the CPU
+// with the SIMD culling kernel and drawn with one glDrawElementsInstancedBaseVertex per mesh and LOD
+// (without occlusion culling: CULL_EARLY does the whole job and CULL_LATE draws nothing).
+class InstanceCuller
+{
+public:
+    static const unsigned int MAX_LODS = 4;
+    static const unsigned int INSTANCE_INDEX_ATTRIBUTE = INSTANCE_ATTRIBUTE_FIRST;
+    static const unsigned int INSTANCE_MATRIX_UNIT = 15; // texture unit of the instance matrix buffer texture
+
+    bool gpuCulling; // compute pass + multi-draw-indirect, false on pre-4.3 contexts
+
+    // lodDistances[i] is the distance up to which lods[i] is used, instances beyond the last one are dropped
+    InstanceCuller(const vector<Model*>& lods, const vector<float>& lodDistances)
+        : gpuCulling(GLAD_GL_VERSION_4_3 != 0), cullShader(0), occlusion(0), lodCount(0), instanceCount(0), capacity(0),
+          instanceBuffer(0), instanceTexture(0), visibleBuffer(0), commandBuffer(0), visibilityBuffer(0), commandSet(0)
+    {
+        lodCount = (unsigned int)glm::min(lods.size(), (size_t)MAX_LODS);
+        for (unsigned int l = 0; l < lodCount; l++)
+            distances[l] = l < lodDistances.size() ? lodDistances[l] : 1e30f;
+        for (unsigned int l = 0; l < MAX_LODS; l++)
+            lodVisible[l] = 0;
+        source = lods[0];
+        bounds = lods[0]->boundingSphere;
+        glGenBuffers(1, &instanceBuffer);
+        glGenBuffers(1, &visibleBuffer);
+        glGenTextures(1, &instanceTexture);
+        // the buffer texture views instanceBuffer for good, setInstances() only reallocates the buffer's storage
+        glState().bindBuffer(GL_TEXTURE_BUFFER, instanceBuffer);
+        glState().activeTexture(GL_TEXTURE0 + INSTANCE_MATRIX_UNIT);
+        glState().bindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceBuffer);
+        mergeMeshes(lods);
+        if (gpuCulling)
+        {
+            cullShader = new Shader("cullInstances.comp");
+            glGenBuffers(1, &commandBuffer);
+            glGenBuffers(1, &visibilityBuffer);
+            // two sets of commands, the late phase must not overwrite what the early draw is still reading
+            glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, 2 * commands.size() * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+        }
+    }
+
+    // the depth pyramid the late phase tests against, built from this frame's depth after the early draw
+    void setOcclusion(HiZPyramid* pyramid)
+    {
+        occlusion = pyramid;
+    }
+
+    // uploads the model matrices of all instances, call again whenever they change
+    void setInstances(const vector<glm::mat4>& models)
+    {
+        instanceCount = (unsigned int)models.size();
+        if (instanceCount > capacity)
+        {
+            capacity = instanceCount;
+            // every LOD gets a slice of the visible list big enough for all instances, once for each phase
+            glState().bindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+            glBufferData(GL_ARRAY_BUFFER, 2 * (size_t)capacity * lodCount * sizeof(uint32_t), NULL, GL_DYNAMIC_DRAW);
+            for (unsigned int l = 0; l < lodCount; l++)
+                for (unsigned int c = lodFirstCommand[l]; c < lodFirstCommand[l + 1]; c++)
+                    commands[c].baseInstance = l * capacity;
+        }
+        glState().bindBuffer(GL_TEXTURE_BUFFER, instanceBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, models.size() * sizeof(glm::mat4), models.empty() ? NULL : &models[0], GL_STATIC_DRAW);
+        if (gpuCulling)
+        {
+            // nothing was visible last frame, the first late phase draws everything that passes
+            vector<uint32_t> history(instanceCount, 0);
+            glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, visibilityBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, history.size() * sizeof(uint32_t), history.empty() ? NULL : &history[0], GL_DYNAMIC_DRAW);
+        }
+        else
+        {
+            // the CPU path culls from its own copy of the bounds
+            spheres.resize(models.size());
+            for (size_t i = 0; i < models.size(); i++)
+                spheres.set(i, bounds.transformed(models[i]));
+        }
+    }
+
+    // builds the visible lists and draw commands of this frame (or of one of its phases)
+    void cull(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPosition, CullPhase phase = CULL_ALL)
+    {
+        Frustum frustum(projection * view);
+        if (gpuCulling)
+            cullOnGPU(frustum, projection * view, cameraPosition, phase);
+        else if (phase == CULL_LATE)
+        {
+            for (unsigned int l = 0; l < lodCount; l++)
+                lodVisible[l] = 0;
+        }
+        else
+            cullOnCPU(frustum, cameraPosition);
+    }
+
+    // draws the visible instances with the model's first material; shader should be (based on) instancedCull.vs
+    void draw(Shader& shader)
+    {
+        shader.use();
+        shader.setInt("instanceMatrices", INSTANCE_MATRIX_UNIT);
+        if (!source->meshes.empty())
+            source->meshes[0].getMaterial(shader).bind();
+        glState().bindTexture(GL_TEXTURE0 + INSTANCE_MATRIX_UNIT, GL_TEXTURE_BUFFER, instanceTexture);
+        glState().bindVertexArray(VAO);
+        glState().primitiveRestart(GL_UNSIGNED_INT);
+        if (gpuCulling)
+        {
+            glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(commandSet * commands.size() * sizeof(DrawElementsIndirectCommand)),
+                (GLsizei)commands.size(), 0);
+            return;
+        }
+        glState().bindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+        for (unsigned int l = 0; l < lodCount; l++)
+        {
+            if (lodVisible[l] == 0)
+                continue;
+            // no base instance before 4.2, so the index attribute is pointed at the LOD's slice instead
+            glVertexAttribIPointer(INSTANCE_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, (void*)((size_t)l * capacity * sizeof(uint32_t)));
+            for (unsigned int c = lodFirstCommand[l]; c < lodFirstCommand[l + 1]; c++)
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, commands[c].count, GL_UNSIGNED_INT,
+                    (void*)((size_t)commands[c].firstIndex * sizeof(unsigned int)), lodVisible[l], commands[c].baseVertex);
+        }
+    }
+
+private:
+    Shader* cullShader;
+    HiZPyramid* occlusion;
+    Model* source;
+    BoundingSphere bounds;
+    unsigned int lodCount;
+    float distances[MAX_LODS];
+    unsigned int lodFirstCommand[MAX_LODS + 1]; // commands of LOD l are [lodFirstCommand[l], lodFirstCommand[l + 1])
+    unsigned int instanceCount, capacity;
+    unsigned int VAO, VBO, EBO;
+    unsigned int instanceBuffer, instanceTexture, visibleBuffer, commandBuffer;
+    unsigned int visibilityBuffer; // one uint per instance, visible in the last late phase
+    unsigned int commandSet;       // 1 for the late phase's commands and visible lists, 0 otherwise
+    vector<DrawElementsIndirectCommand> commands; // one per mesh and LOD, instanceCount is filled by culling
+    // CPU fallback
+    SphereSet spheres;
+    vector<uint32_t> visible;
+    vector<uint32_t> lodLists;
+    unsigned int lodVisible[MAX_LODS];
+
+    void mergeMeshes(const vector<Model*>& lods)
+    {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        for (unsigned int l = 0; l < lodCount; l++)
+        {
+            lodFirstCommand[l] = (unsigned int)commands.size();
+            for (unsigned int m = 0; m < lods[l]->meshes.size(); m++)
+            {
+                const Mesh& mesh = lods[l]->meshes[m];
+                DrawElementsIndirectCommand command;
+                command.count = (GLuint)mesh.indices.size();
+                command.instanceCount = 0;
+                command.firstIndex = (GLuint)indices.size();
+                command.baseVertex = (GLint)vertices.size();
+                command.baseInstance = 0;
+                commands.push_back(command);
+                vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+                indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+            }
+        }
+        lodFirstCommand[lodCount] = (unsigned int)commands.size();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glState().bindVertexArray(VAO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+        glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+        // positions, normals and texture coords, the same locations Mesh uses
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        // index of the visible instance, advanced once per instance
+        glState().bindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+        glEnableVertexAttribArray(INSTANCE_INDEX_ATTRIBUTE);
+        glVertexAttribIPointer(INSTANCE_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, (void*)0);
+        glVertexAttribDivisor(INSTANCE_INDEX_ATTRIBUTE, 1);
+        glState().bindVertexArray(0);
+    }
+
+    void cullOnGPU(const Frustum& frustum, const glm::mat4& viewProjection, const glm::vec3& cameraPosition, CullPhase phase)
+    {
+        // reset the instance counts (a few bytes per LOD, nothing per instance)
+        commandSet = phase == CULL_LATE ? 1 : 0;
+        size_t setOffset = commandSet * commands.size();
+        vector<DrawElementsIndirectCommand> reset(commands);
+        for (size_t c = 0; c < reset.size(); c++)
+        {
+            reset[c].instanceCount = 0;
+            reset[c].baseInstance += (GLuint)(commandSet * capacity * lodCount);
+        }
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, setOffset * sizeof(DrawElementsIndirectCommand), reset.size() * sizeof(DrawElementsIndirectCommand), &reset[0]);
+        if (instanceCount == 0)
+            return;
+
+        cullShader->use();
+        cullShader->setInt("instanceCount", (int)instanceCount);
+        cullShader->setInt("phase", (int)phase);
+        cullShader->setBool("useOcclusion", phase == CULL_LATE && occlusion != 0);
+        cullShader->setMat4("viewProjection", viewProjection);
+        cullShader->setInt("depthPyramid", HiZPyramid::TEXTURE_UNIT);
+        if (occlusion)
+            occlusion->bind();
+        for (unsigned int p = 0; p < 6; p++)
+            cullShader->setVec4("frustumPlanes[" + std::to_string(p) + "]", frustum.planes[p]);
+        cullShader->setVec4("boundingSphere", glm::vec4(bounds.center, bounds.radius));
+        cullShader->setVec3("cameraPosition", cameraPosition);
+        cullShader->setInt("lodCount", (int)lodCount);
+        for (unsigned int l = 0; l < lodCount; l++)
+        {
+            cullShader->setFloat("lodDistances[" + std::to_string(l) + "]", distances[l]);
+            cullShader->setInt("lodFirstCommand[" + std::to_string(l) + "]", (int)(setOffset + lodFirstCommand[l]));
+        }
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visibilityBuffer);
+        glDispatchCompute((instanceCount + 255) / 256, 1, 1);
+
+        // the pass counted into the first command of each LOD, the LOD's other meshes draw the same instances
+        bool fanOut = false;
+        for (unsigned int l = 0; l < lodCount; l++)
+            fanOut = fanOut || lodFirstCommand[l + 1] - lodFirstCommand[l] > 1;
+        if (fanOut)
+        {
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glState().bindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+            glState().bindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+            GLintptr countOffset = offsetof(DrawElementsIndirectCommand, instanceCount);
+            for (unsigned int l = 0; l < lodCount; l++)
+                for (unsigned int c = lodFirstCommand[l] + 1; c < lodFirstCommand[l + 1]; c++)
+                    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        (setOffset + lodFirstCommand[l]) * sizeof(DrawElementsIndirectCommand) + countOffset,
+                        (setOffset + c) * sizeof(DrawElementsIndirectCommand) + countOffset, sizeof(GLuint));
+        }
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void cullOnCPU(const Frustum& frustum, const glm::vec3& cameraPosition)
+    {
+        cullSpheres(frustum, spheres, visible);
+        lodLists.resize((size_t)capacity * lodCount);
+        for (unsigned int l = 0; l < lodCount; l++)
+            lodVisible[l] = 0;
+        for (size_t i = 0; i < visible.size(); i++)
+        {
+            glm::vec3 d = spheres.get(visible[i]).center - cameraPosition;
+            float distance = std::sqrt(glm::dot(d, d));
+            unsigned int l = 0;
+            while (l < lodCount && distance > distances[l])
+                l++;
+            if (l == lodCount)
+                continue;
+            lodLists[(size_t)l * capacity + lodVisible[l]++] = visible[i];
+        }
+        glState().bindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+        for (unsigned int l = 0; l < lodCount; l++)
+        {
+            if (lodVisible[l] > 0)
+                glBufferSubData(GL_ARRAY_BUFFER, (size_t)l * capacity * sizeof(uint32_t), lodVisible[l] * sizeof(uint32_t), &lodLists[(size_t)l * capacity]);
+        }
+    }
+};
+#endif
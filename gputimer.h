@@ -0,0 +1,162 @@
+
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// GPU time of render passes, measured with GL_TIMESTAMP queries around them. The queries of a frame are read
+// back FRAMES frames later, by when the GPU has long finished them, so timing never stalls the CPU; each pass
+// keeps its last time and a running average. Passes may nest or overlap, every begin/end pair has its own
+// queries.
+// A pass's time is the distance between its two timestamps on the GPU's timeline, so it includes any time the GPU
+// sat idle in between, waiting for the CPU to send more commands. Keep CPU work (culling, simulation, waiting on
+// fences) outside begin/end, or the pass is billed for it.
+class GpuTimer
+{
+public:
+    static const unsigned int FRAMES = 4; // frames the queries of one frame stay in flight
+
+    GpuTimer() : frame(0)
+    {
+    }
+    ~GpuTimer()
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+            glDeleteQueries(FRAMES * 2, passes[i].queries);
+    }
+
+    // reads back the passes of FRAMES frames ago, call once at the start of every frame
+    void beginFrame()
+    {
+        frame++;
+        collect(frame % FRAMES);
+    }
+
+    void begin(const string& name)
+    {
+        Pass& pass = find(name);
+        glQueryCounter(pass.queries[(frame % FRAMES) * 2], GL_TIMESTAMP);
+    }
+    void end(const string& name)
+    {
+        Pass& pass = find(name);
+        unsigned int slot = frame % FRAMES;
+        glQueryCounter(pass.queries[slot * 2 + 1], GL_TIMESTAMP);
+        pass.issued[slot] = true;
+    }
+
+    // begins or ends a pass on an optional timer, for code that takes a GpuTimer* that may be 0
+    static void mark(GpuTimer* timer, const string& pass, bool start)
+    {
+        if (!timer)
+            return;
+        if (start)
+            timer->begin(pass);
+        else
+            timer->end(pass);
+    }
+
+    // waits for everything issued and reads it back, for benchmarks
+    void finish()
+    {
+        glFinish();
+        for (unsigned int slot = 0; slot < FRAMES; slot++)
+            collect(slot);
+    }
+
+    // forgets the averages, e.g. after warming up
+    void reset()
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            passes[i].total = 0.0;
+            passes[i].samples = 0;
+        }
+    }
+
+    // last and average time of a pass in milliseconds, 0 before its first result is in
+    double last(const string& name) const
+    {
+        const Pass* pass = lookup(name);
+        return pass ? pass->last : 0.0;
+    }
+    double average(const string& name) const
+    {
+        const Pass* pass = lookup(name);
+        return pass && pass->samples ? pass->total / pass->samples : 0.0;
+    }
+
+    // the average of every pass, in the order they were first timed
+    void print() const
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+            std::cout << "    " << std::left << std::setw(24) << passes[i].name << std::right << std::fixed << std::setprecision(3)
+                      << average(passes[i].name) << " ms" << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+private:
+    struct Pass {
+        string name;
+        GLuint queries[FRAMES * 2]; // start and end timestamp per frame slot
+        bool issued[FRAMES];
+        double last;
+        double total;
+        unsigned int samples;
+    };
+
+    vector<Pass> passes;
+    unsigned int frame;
+
+    void collect(unsigned int slot)
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            Pass& pass = passes[i];
+            if (!pass.issued[slot])
+                continue;
+            GLuint64 start = 0, stop = 0;
+            glGetQueryObjectui64v(pass.queries[slot * 2], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(pass.queries[slot * 2 + 1], GL_QUERY_RESULT, &stop);
+            pass.issued[slot] = false;
+            pass.last = (stop - start) / 1000000.0;
+            pass.total += pass.last;
+            pass.samples++;
+        }
+    }
+
+    Pass& find(const string& name)
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].name == name)
+                return passes[i];
+        }
+        Pass pass;
+        pass.name = name;
+        glGenQueries(FRAMES * 2, pass.queries);
+        for (unsigned int slot = 0; slot < FRAMES; slot++)
+            pass.issued[slot] = false;
+        pass.last = pass.total = 0.0;
+        pass.samples = 0;
+        passes.push_back(pass);
+        return passes.back();
+    }
+    const Pass* lookup(const string& name) const
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].name == name)
+                return &passes[i];
+        }
+        return 0;
+    }
+};
+#endif
@@ -0,0 +1,121 @@
+
+
+#ifndef HIZ_H
+#define HIZ_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "shader.h"
+#include "glstate.h"
+#include "primitives.h"
+
+#include <algorithm>
+using namespace std;
+
+// Hierarchical depth buffer for occlusion culling: a mip chain of the scene's depth where every texel holds
+// the nearest (R) and farthest (G) depth of the 2x2 texels below it. Testing an object then takes four
+// texel fetches at the level where its screen rectangle spans at most 2x2 texels: if the object's nearest
+// depth is behind the farthest depth stored there, everything under it is closer and the object is hidden.
+// Built with one fragment shader pass per level (hizDownsample.frag), so it works on a 3.3 context; the tests
+// run in the instance culling compute pass (see InstanceCuller in gpuculling.h).
+class HiZPyramid
+{
+public:
+    static const unsigned int TEXTURE_UNIT = 14; // where the culling pass finds the pyramid
+
+    unsigned int texture;
+    int width, height; // of level 0, the same as the depth buffer
+    int levels;
+
+    HiZPyramid(int depthWidth, int depthHeight)
+        : texture(0), width(0), height(0), levels(0), shader("hdr.vs", "hizDownsample.frag")
+    {
+        glGenFramebuffers(1, &FBO);
+        resize(depthWidth, depthHeight);
+    }
+
+    // reallocates the pyramid for a new depth buffer size
+    void resize(int depthWidth, int depthHeight)
+    {
+        if (depthWidth == width && depthHeight == height)
+            return;
+        width = std::max(1, depthWidth);
+        height = std::max(1, depthHeight);
+        levels = 1;
+        while ((std::max(width, height) >> levels) > 0)
+            levels++;
+        if (texture)
+        {
+            glDeleteTextures(1, &texture);
+            glState().invalidate(); // it may still be bound, and the new texture can get its name
+        }
+        glGenTextures(1, &texture);
+        glState().bindTexture(GL_TEXTURE_2D, texture);
+        for (int level = 0; level < levels; level++)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RG32F, levelWidth(level), levelHeight(level), 0, GL_RG, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    }
+
+    int levelWidth(int level) const
+    {
+        return std::max(1, width >> level);
+    }
+    int levelHeight(int level) const
+    {
+        return std::max(1, height >> level);
+    }
+
+    // rebuilds every level from a depth texture of width x height. Uses its own framebuffer and viewport,
+    // so rebind yours afterwards.
+    void build(unsigned int depthTexture)
+    {
+        shader.use();
+        shader.setInt("source", 0);
+        glState().disable(GL_DEPTH_TEST);
+        glState().disable(GL_BLEND);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        // the level range is set on the bound texture of the active unit, which an elided bind doesn't switch to
+        glState().activeTexture(GL_TEXTURE0);
+        for (int level = 0; level < levels; level++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level);
+            glState().viewport(0, 0, levelWidth(level), levelHeight(level));
+            if (level == 0)
+            {
+                // level 0 is a copy of the depth buffer
+                shader.setBool("fromDepth", true);
+                glState().bindTexture(GL_TEXTURE_2D, depthTexture);
+            }
+            else
+            {
+                // only the level above may be read while this one is written, or it's a feedback loop
+                shader.setBool("fromDepth", false);
+                shader.setVec2("sourceSize", (float)levelWidth(level - 1), (float)levelHeight(level - 1));
+                glState().bindTexture(GL_TEXTURE_2D, texture);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            }
+            Primitives::Quad().draw();
+        }
+        glState().bindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glState().enable(GL_DEPTH_TEST);
+    }
+
+    // binds the pyramid for the culling pass
+    void bind() const
+    {
+        glState().bindTexture(GL_TEXTURE0 + TEXTURE_UNIT, GL_TEXTURE_2D, texture);
+    }
+
+private:
+    unsigned int FBO;
+    Shader shader;
+};
+#endif
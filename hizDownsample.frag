@@ -0,0 +1,42 @@
+#version 330 core
+out vec2 MinMaxDepth; // nearest, farthest
+
+in vec2 TexCoords;
+
+// level 0: the depth buffer; otherwise the pyramid with only the level above this one enabled
+uniform sampler2D source;
+uniform bool fromDepth;
+uniform vec2 sourceSize;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    if (fromDepth)
+    {
+        float depth = texelFetch(source, texel, 0).r;
+        MinMaxDepth = vec2(depth);
+        return;
+    }
+
+    // the 2x2 texels below this one; with an odd source size the last row/column also takes the
+    // texels left over, or an occluder on the edge would be lost
+    ivec2 size = ivec2(sourceSize);
+    ivec2 first = texel * 2;
+    ivec2 last = first + 1;
+    if ((size.x & 1) != 0 && last.x + 1 == size.x - 1)
+        last.x++;
+    if ((size.y & 1) != 0 && last.y + 1 == size.y - 1)
+        last.y++;
+    last = min(last, size - 1);
+
+    vec2 result = vec2(1.0, 0.0);
+    for (int y = first.y; y <= last.y; y++)
+    {
+        for (int x = first.x; x <= last.x; x++)
+        {
+            vec2 depth = texelFetch(source, ivec2(x, y), 0).rg;
+            result = vec2(min(result.x, depth.x), max(result.y, depth.y));
+        }
+    }
+    MinMaxDepth = result;
+}
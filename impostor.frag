@@ -0,0 +1,57 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 FrameUV[3];
+flat in vec2 FrameCell[3];
+flat in vec3 FrameWeights;
+in vec3 BillboardPos;
+flat in vec3 ToCamera;
+flat in vec4 Rotation;
+flat in float Radius;
+
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalDepthAtlas; // model space normal, depth 0..1 from the front to the back of the bounding sphere
+uniform float frames;
+uniform mat4 projection;
+uniform mat4 view;
+// optional lighting from the baked normals; 0 shows the albedo as is, like default.frag
+uniform float lighting;
+uniform vec3 lightDirection; // towards the light, world space
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    vec3 t = 2.0 * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+
+void main()
+{
+    vec4 albedo = vec4(0.0);
+    vec4 normalDepth = vec4(0.0);
+    for (int i = 0; i < 3; i++)
+    {
+        // clamped to the view, the neighbours' pixels belong to other directions
+        vec2 uv = (FrameCell[i] + clamp(FrameUV[i], 0.0, 1.0)) / frames;
+        vec4 albedoSample = texture(albedoAtlas, uv);
+        // weighted by coverage, so the empty background around the silhouettes doesn't pull the depth back
+        albedo += FrameWeights[i] * albedoSample;
+        normalDepth += FrameWeights[i] * albedoSample.a * texture(normalDepthAtlas, uv);
+    }
+    if (albedo.a < 0.5)
+        discard;
+    albedo.rgb /= albedo.a;
+    normalDepth /= albedo.a;
+
+    // the baked surface lies in front of or behind the quad, move the depth there
+    vec3 position = BillboardPos + ToCamera * (1.0 - 2.0 * normalDepth.a) * Radius;
+    vec4 clip = projection * view * vec4(position, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+    float shade = 1.0;
+    if (lighting > 0.0)
+    {
+        vec3 normal = normalize(rotate(Rotation, normalDepth.rgb * 2.0 - 1.0));
+        shade = mix(1.0, 0.2 + 0.8 * max(dot(normal, normalize(lightDirection)), 0.0), lighting);
+    }
+    FragColor = vec4(albedo.rgb * shade, 1.0);
+}
@@ -0,0 +1,206 @@
+
+
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+#include "model.h"
+#include "glstate.h"
+#include "culling.h"
+#include "instancing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+using namespace std;
+
+// the unit direction a point of the octahedral map ([-1,1]^2) stands for: the upper half of the octahedron
+// unfolds to the inner diamond, the lower half to the corners (same mapping as octahedralDecode in impostor.vs)
+inline glm::vec3 octahedralDecode(const glm::vec2& e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    if (n.z < 0.0f)
+    {
+        float x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        float y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+        n.x = x;
+        n.y = y;
+    }
+    return glm::normalize(n);
+}
+
+// Octahedral impostor of a model, for drawing far away instances as a single quad.
+//
+// The model is baked once from frames x frames view directions spread evenly over the sphere with an
+// octahedral map, each view an orthographic picture of the model's bounding sphere in its own cell of two
+// atlases: albedo (alpha = coverage) and model space normal + depth (0 at the front of the bounding sphere,
+// 1 at the back). At draw time every instance is a camera facing quad; impostor.vs finds the three baked
+// views around the direction the instance is seen from, and impostor.frag blends them, alpha tests the
+// silhouette and writes the baked depth so impostors intersect each other and the real meshes properly.
+// Instances use the CompactInstance layout, so the same culled instance lists feed meshes and impostors
+// (see partitionByDistance).
+class Impostor
+{
+public:
+    static const unsigned int ALBEDO_UNIT = 12;
+    static const unsigned int NORMAL_DEPTH_UNIT = 13;
+
+    unsigned int albedoAtlas;
+    unsigned int normalDepthAtlas;
+    int frames;    // views per side of the atlas
+    int frameSize; // pixels per side of a view
+    BoundingSphere bounds; // of the baked model, in model space
+
+    // bakes the model from framesPerSide^2 directions, frameResolution^2 pixels each. Cell centers never decode
+    // to +-Y (that is the edge of the map), so no view looks straight down lookAt's up axis. Uses its own
+    // framebuffer and viewport, so rebind yours afterwards.
+    Impostor(Model& model, int framesPerSide = 8, int frameResolution = 128)
+        : albedoAtlas(0), normalDepthAtlas(0), frames(std::max(framesPerSide, 2)), frameSize(frameResolution),
+          bounds(model.boundingSphere), VAO(0), VBO(0), attachedInstances(0), attachedOffset(0)
+    {
+        bake(model);
+
+        // a camera facing quad, corners in [-1,1]^2
+        float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glState().bindVertexArray(VAO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    }
+
+    // draws count instances (CompactInstance layout) as impostors. The shader (impostor.vs/impostor.frag)
+    // needs projection, view and camPos set.
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, unsigned int count)
+    {
+        if (count == 0)
+            return;
+        shader.use();
+        shader.setInt("albedoAtlas", ALBEDO_UNIT);
+        shader.setInt("normalDepthAtlas", NORMAL_DEPTH_UNIT);
+        shader.setFloat("frames", (float)frames);
+        shader.setVec4("bounds", glm::vec4(bounds.center, bounds.radius));
+        glState().bindTexture(GL_TEXTURE0 + ALBEDO_UNIT, GL_TEXTURE_2D, albedoAtlas);
+        glState().bindTexture(GL_TEXTURE0 + NORMAL_DEPTH_UNIT, GL_TEXTURE_2D, normalDepthAtlas);
+
+        glState().bindVertexArray(VAO);
+        // re-point the instance attributes only when the buffer (or its persistent region) changed
+        if (attachedInstances != instances.ID || attachedOffset != instances.regionOffset())
+        {
+            instances.attach(VAO);
+            attachedInstances = instances.ID;
+            attachedOffset = instances.regionOffset();
+        }
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    }
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances)
+    {
+        DrawInstanced(shader, instances, instances.count);
+    }
+
+private:
+    unsigned int VAO, VBO;
+    unsigned int attachedInstances;
+    size_t attachedOffset;
+
+    void bake(Model& model)
+    {
+        int size = frames * frameSize;
+        albedoAtlas = createAtlas(GL_RGBA8, GL_UNSIGNED_BYTE, size);
+        normalDepthAtlas = createAtlas(GL_RGBA16F, GL_FLOAT, size);
+
+        unsigned int FBO, depth;
+        glGenFramebuffers(1, &FBO);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoAtlas, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalDepthAtlas, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::IMPOSTOR:: Framebuffer not complete!" << std::endl;
+
+        // every view has its own region of the depth buffer, so one clear does for all of them
+        float clearAlbedo[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float clearNormalDepth[4] = { 0.5f, 0.5f, 1.0f, 1.0f };
+        float clearDepth = 1.0f;
+        glState().depthMask(GL_TRUE);
+        glClearBufferfv(GL_COLOR, 0, clearAlbedo);
+        glClearBufferfv(GL_COLOR, 1, clearNormalDepth);
+        glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+        glState().enable(GL_DEPTH_TEST);
+        glState().disable(GL_BLEND);
+
+        Shader bakeShader("impostorBake.vs", "impostorBake.frag");
+        bakeShader.use();
+        float r = bounds.radius;
+        // looking at the bounding sphere from 2r away: the front of the sphere is at depth 0, the back at 1
+        bakeShader.setMat4("projection", glm::ortho(-r, r, -r, r, r, 3.0f * r));
+        for (int y = 0; y < frames; y++)
+        {
+            for (int x = 0; x < frames; x++)
+            {
+                glm::vec3 direction = octahedralDecode(glm::vec2((x + 0.5f) / frames, (y + 0.5f) / frames) * 2.0f - 1.0f);
+                // impostor.vs rebuilds the same basis from the direction
+                bakeShader.setMat4("view", glm::lookAt(bounds.center + 2.0f * r * direction, bounds.center, glm::vec3(0.0f, 1.0f, 0.0f)));
+                glState().viewport(x * frameSize, y * frameSize, frameSize, frameSize);
+                model.Draw(bakeShader);
+            }
+        }
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, 0, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteRenderbuffers(1, &depth);
+
+        glState().bindTexture(GL_TEXTURE_2D, albedoAtlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glState().bindTexture(GL_TEXTURE_2D, normalDepthAtlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    unsigned int createAtlas(GLenum internalFormat, GLenum type, int size)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState().bindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size, size, 0, GL_RGBA, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+};
+
+// reorders indices[0..count) (instance indices, e.g. the output of cullSpheres) so the instances whose bounding
+// sphere center is closer to eye than distance come first, and returns how many of them there are.
+// The rest, [returned, count), are the far field to draw as impostors.
+inline size_t partitionByDistance(const SphereSet& spheres, uint32_t* indices, size_t count, const glm::vec3& eye, float distance)
+{
+    float distance2 = distance * distance;
+    size_t nearCount = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t index = indices[i];
+        float dx = spheres.x[index] - eye.x;
+        float dy = spheres.y[index] - eye.y;
+        float dz = spheres.z[index] - eye.z;
+        if (dx * dx + dy * dy + dz * dz < distance2)
+            std::swap(indices[i], indices[nearCount++]);
+    }
+    return nearCount;
+}
+#endif
@@ -0,0 +1,98 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;        // quad corner in [-1,1]^2
+layout (location = 8) in vec4 aPositionScale; // world position, uniform scale
+layout (location = 9) in vec4 aRotation;      // unit quaternion (xyz, w), see CompactInstance in instancing.h
+
+out vec2 FrameUV[3];          // the fragment's position in each of the three views, [0,1]^2 within the view
+flat out vec2 FrameCell[3];   // which views
+flat out vec3 FrameWeights;
+out vec3 BillboardPos;        // world position on the quad
+flat out vec3 ToCamera;
+flat out vec4 Rotation;
+flat out float Radius;        // world space radius of the bounding sphere
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 camPos;
+uniform vec4 bounds;  // model space bounding sphere the impostor was baked from
+uniform float frames; // views per side of the atlas
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    vec3 t = 2.0 * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+
+vec3 rotateInverse(vec4 q, vec3 v)
+{
+    return rotate(vec4(-q.xyz, q.w), v);
+}
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// same octahedral map as octahedralDecode in impostor.h
+vec2 octahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+}
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
+
+void main()
+{
+    Rotation = aRotation;
+    vec3 center = aPositionScale.xyz + aPositionScale.w * rotate(aRotation, bounds.xyz);
+    Radius = aPositionScale.w * bounds.w;
+    ToCamera = normalize(camPos - center);
+
+    // camera facing quad over the bounding sphere
+    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+    BillboardPos = center + (right * aCorner.x + up * aCorner.y) * Radius;
+    gl_Position = projection * view * vec4(BillboardPos, 1.0);
+
+    // the three views around the direction the instance is seen from (in model space), with barycentric weights
+    vec3 viewDirection = rotateInverse(aRotation, ToCamera);
+    vec2 grid = (octahedralEncode(viewDirection) * 0.5 + 0.5) * frames - 0.5;
+    vec2 cell = floor(grid);
+    vec2 f = grid - cell;
+    if (f.x + f.y < 1.0)
+    {
+        FrameCell[0] = cell;
+        FrameCell[1] = cell + vec2(1.0, 0.0);
+        FrameCell[2] = cell + vec2(0.0, 1.0);
+        FrameWeights = vec3(1.0 - f.x - f.y, f.x, f.y);
+    }
+    else
+    {
+        FrameCell[0] = cell + vec2(1.0, 1.0);
+        FrameCell[1] = cell + vec2(0.0, 1.0);
+        FrameCell[2] = cell + vec2(1.0, 0.0);
+        FrameWeights = vec3(f.x + f.y - 1.0, 1.0 - f.x, 1.0 - f.y);
+    }
+
+    // where the ray through this corner crosses each view's plane, in that view's image coordinates
+    vec3 corner = rotateInverse(aRotation, BillboardPos - center) / Radius;
+    vec3 ray = rotateInverse(aRotation, normalize(camPos - BillboardPos));
+    for (int i = 0; i < 3; i++)
+    {
+        FrameCell[i] = clamp(FrameCell[i], vec2(0.0), vec2(frames - 1.0));
+        vec3 direction = octahedralDecode((FrameCell[i] + 0.5) / frames * 2.0 - 1.0);
+        // the basis glm::lookAt gave the view when it was baked
+        vec3 forward = -direction;
+        vec3 s = normalize(cross(forward, vec3(0.0, 1.0, 0.0)));
+        vec3 u = cross(s, forward);
+        vec3 p = corner - ray * dot(corner, direction) / max(dot(ray, direction), 0.05);
+        FrameUV[i] = vec2(dot(p, s), dot(p, u)) * 0.5 + 0.5;
+    }
+}
@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalDepth;
+
+in vec2 TexCoords;
+in vec3 Normal;
+
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+    Albedo = vec4(texture(texture_diffuse1, TexCoords).rgb, 1.0);
+    // model space normal, and the orthographic (linear) depth within the bounding sphere
+    NormalDepth = vec4(normalize(Normal) * 0.5 + 0.5, gl_FragCoord.z);
+}
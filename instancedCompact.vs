@@ -0,0 +1,29 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 8) in vec4 aPositionScale; // world position, uniform scale
+layout (location = 9) in vec4 aRotation;      // unit quaternion (xyz, w), see CompactInstance in instancing.h
+
+out vec2 TexCoords;
+out vec3 WorldPos;
+out vec3 Normal;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+// rotates v by the unit quaternion q
+vec3 rotate(vec4 q, vec3 v)
+{
+    vec3 t = 2.0 * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+
+void main()
+{
+    TexCoords = aTexCoords;
+    WorldPos = aPositionScale.xyz + aPositionScale.w * rotate(aRotation, aPos);
+    // uniform scale, so the rotation alone is the normal transform
+    Normal = rotate(aRotation, aNormal);
+    gl_Position = projection * view * vec4(WorldPos, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 8) in uint aInstanceIndex; // written by the culling pass, one per visible instance
+
+out vec2 TexCoords;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform samplerBuffer instanceMatrices; // one mat4 per instance, stored as 4 RGBA32F texels
+
+void main()
+{
+    int base = int(aInstanceIndex) * 4;
+    mat4 model = mat4(texelFetch(instanceMatrices, base),
+                      texelFetch(instanceMatrices, base + 1),
+                      texelFetch(instanceMatrices, base + 2),
+                      texelFetch(instanceMatrices, base + 3));
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,281 @@
+
+
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "glstate.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// Per-instance attributes live in their own location range so they never collide with the mesh's
+// vertex attributes (Mesh::setupMesh uses 0..6: position, normal, texcoords, tangent, bitangent, bone ids, weights).
+const unsigned int INSTANCE_ATTRIBUTE_FIRST = 8;
+const unsigned int INSTANCE_ATTRIBUTE_LAST = 15; // GL guarantees at least 16 vertex attributes
+
+struct InstanceAttribute {
+    GLint size;        // components, 1..4
+    GLenum type;       // GL_FLOAT, GL_HALF_FLOAT, GL_UNSIGNED_INT, ...
+    unsigned int offset;
+    GLboolean normalized;
+    bool integer;      // read as int/uint in the shader (glVertexAttribIPointer)
+};
+
+// Rigid transform with uniform scale in 32 bytes instead of a 64 byte mat4. The vertex shader
+// (instancedCompact.vs) rebuilds world position and normal from it: p' = position + scale * rotate(rotation, p).
+struct CompactInstance {
+    glm::vec3 position;
+    float scale;
+    glm::vec4 rotation; // unit quaternion, xyz = axis * sin(angle / 2), w = cos(angle / 2)
+
+    CompactInstance() : position(0.0f), scale(1.0f), rotation(0.0f, 0.0f, 0.0f, 1.0f)
+    {
+    }
+    CompactInstance(const glm::vec3& p, float s, const glm::quat& q) : position(p), scale(s), rotation(q.x, q.y, q.z, q.w)
+    {
+    }
+
+    glm::quat quaternion() const
+    {
+        return glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+    }
+    // the equivalent model matrix, for code that still wants one
+    glm::mat4 matrix() const
+    {
+        glm::mat4 rotationScale = glm::mat4_cast(quaternion()) * scale;
+        rotationScale[3] = glm::vec4(position, 1.0f);
+        return rotationScale;
+    }
+};
+
+// The same transform in 24 bytes, the quaternion stored as 4 snorm16 values. Read with the same shader,
+// the normalized attribute arrives as a float vec4 (precision is about 3e-5, far below a pixel for a rock).
+struct PackedInstance {
+    glm::vec3 position;
+    float scale;
+    int16_t rotation[4];
+
+    PackedInstance()
+    {
+    }
+    explicit PackedInstance(const CompactInstance& instance) : position(instance.position), scale(instance.scale)
+    {
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            float q = glm::clamp(instance.rotation[i], -1.0f, 1.0f);
+            rotation[i] = (int16_t)std::floor(q * 32767.0f + 0.5f);
+        }
+    }
+};
+
+// How one instance is laid out in the buffer. Attribute i goes to location INSTANCE_ATTRIBUTE_FIRST + i,
+// the shader declares them in the same order from location 8 on.
+class InstanceLayout
+{
+public:
+    unsigned int stride;
+    vector<InstanceAttribute> attributes;
+
+    explicit InstanceLayout(unsigned int instanceSize) : stride(instanceSize)
+    {
+    }
+
+    InstanceLayout& add(GLint size, GLenum type, unsigned int offset, GLboolean normalized = GL_FALSE)
+    {
+        InstanceAttribute attribute = { size, type, offset, normalized, false };
+        attributes.push_back(attribute);
+        return *this;
+    }
+    InstanceLayout& addInteger(GLint size, GLenum type, unsigned int offset)
+    {
+        InstanceAttribute attribute = { size, type, offset, GL_FALSE, true };
+        attributes.push_back(attribute);
+        return *this;
+    }
+
+    // one mat4 model matrix per instance, locations 8..11 (a mat4 attribute takes 4 locations)
+    static InstanceLayout Matrix()
+    {
+        InstanceLayout layout(sizeof(glm::mat4));
+        for (unsigned int column = 0; column < 4; column++)
+            layout.add(4, GL_FLOAT, column * sizeof(glm::vec4));
+        return layout;
+    }
+
+    // CompactInstance: position and scale at location 8, rotation quaternion at 9
+    static InstanceLayout Compact()
+    {
+        InstanceLayout layout(sizeof(CompactInstance));
+        layout.add(4, GL_FLOAT, offsetof(CompactInstance, position));
+        layout.add(4, GL_FLOAT, offsetof(CompactInstance, rotation));
+        return layout;
+    }
+    // PackedInstance: same locations as Compact(), the quaternion as normalized shorts
+    static InstanceLayout Packed()
+    {
+        InstanceLayout layout(sizeof(PackedInstance));
+        layout.add(4, GL_FLOAT, offsetof(PackedInstance, position));
+        layout.add(4, GL_SHORT, offsetof(PackedInstance, rotation), GL_TRUE);
+        return layout;
+    }
+
+    // points the instance attributes of a VAO at instances stored in buffer from byte offset on
+    // (an InstanceBuffer, or a FrameRingBuffer allocation)
+    void attach(unsigned int vao, unsigned int buffer, size_t offset) const
+    {
+        glState().bindVertexArray(vao);
+        glState().bindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (unsigned int i = 0; i <= INSTANCE_ATTRIBUTE_LAST - INSTANCE_ATTRIBUTE_FIRST; i++)
+        {
+            unsigned int location = INSTANCE_ATTRIBUTE_FIRST + i;
+            if (i >= attributes.size())
+            {
+                // a different layout may have been attached before
+                glDisableVertexAttribArray(location);
+                continue;
+            }
+            const InstanceAttribute& attribute = attributes[i];
+            void* pointer = (void*)(offset + attribute.offset);
+            glEnableVertexAttribArray(location);
+            if (attribute.integer)
+                glVertexAttribIPointer(location, attribute.size, attribute.type, stride, pointer);
+            else
+                glVertexAttribPointer(location, attribute.size, attribute.type, attribute.normalized, stride, pointer);
+            glVertexAttribDivisor(location, 1);
+        }
+    }
+};
+
+enum InstanceBufferUsage {
+    INSTANCES_STATIC,    // written once (or rarely)
+    INSTANCES_STREAM,    // rewritten every frame, the buffer is orphaned so the driver never stalls on it
+    INSTANCES_PERSISTENT // rewritten every frame through a persistent mapping, triple buffered with fences (GL 4.4)
+};
+
+// A buffer of per-instance data plus the layout to read it with. attach() points a VAO's instance attributes
+// at the buffer; Mesh::DrawInstanced and Model::DrawInstanced do that on demand.
+class InstanceBuffer
+{
+public:
+    static const unsigned int PERSISTENT_REGIONS = 3;
+
+    unsigned int ID;
+    InstanceLayout layout;
+    InstanceBufferUsage usage;
+    unsigned int capacity; // instances per region
+    unsigned int count;    // instances written by the last update
+
+    InstanceBuffer(const InstanceLayout& instanceLayout, unsigned int maxInstances, InstanceBufferUsage bufferUsage)
+        : ID(0), layout(instanceLayout), usage(bufferUsage), capacity(maxInstances), count(0), region(0), mapped(0)
+    {
+        for (unsigned int i = 0; i < PERSISTENT_REGIONS; i++)
+            fences[i] = 0;
+        // persistent mapping needs glBufferStorage, streaming is the closest thing before 4.4
+        if (usage == INSTANCES_PERSISTENT && !GLAD_GL_VERSION_4_4)
+            usage = INSTANCES_STREAM;
+        glGenBuffers(1, &ID);
+        glState().bindBuffer(GL_ARRAY_BUFFER, ID);
+        if (usage == INSTANCES_PERSISTENT)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, regionSize() * PERSISTENT_REGIONS, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize() * PERSISTENT_REGIONS, flags);
+        }
+        else
+            glBufferData(GL_ARRAY_BUFFER, regionSize(), NULL, usage == INSTANCES_STATIC ? GL_STATIC_DRAW : GL_STREAM_DRAW);
+    }
+
+    // copies instanceCount instances (laid out as described by the layout) into the buffer
+    void update(const void* data, unsigned int instanceCount)
+    {
+        if (usage == INSTANCES_PERSISTENT)
+        {
+            void* destination = beginUpdate(instanceCount);
+            if (count > 0)
+                memcpy(destination, data, (size_t)count * layout.stride);
+            return;
+        }
+        count = instanceCount < capacity ? instanceCount : capacity;
+        size_t bytes = (size_t)count * layout.stride;
+        glState().bindBuffer(GL_ARRAY_BUFFER, ID);
+        if (usage == INSTANCES_STREAM)
+            glBufferData(GL_ARRAY_BUFFER, regionSize(), NULL, GL_STREAM_DRAW); // orphan last frame's storage
+        if (bytes > 0)
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+    }
+    // returns where to write this frame's instanceCount instances, so they can be produced in place:
+    // straight into the persistent mapping, or into a staging copy that endUpdate() uploads
+    void* beginUpdate(unsigned int instanceCount)
+    {
+        count = instanceCount < capacity ? instanceCount : capacity;
+        if (usage == INSTANCES_PERSISTENT)
+        {
+            // everything drawn so far read the current region, fence it and move on to the oldest one
+            if (fences[region])
+                glDeleteSync(fences[region]);
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            region = (region + 1) % PERSISTENT_REGIONS;
+            waitForRegion(region);
+            return mapped + regionOffset();
+        }
+        staging.resize((size_t)count * layout.stride);
+        return staging.empty() ? 0 : &staging[0];
+    }
+    void endUpdate()
+    {
+        // the persistent mapping is coherent, nothing to flush
+        if (usage != INSTANCES_PERSISTENT)
+            update(staging.empty() ? 0 : &staging[0], count);
+    }
+
+    template <typename T>
+    void update(const vector<T>& instances)
+    {
+        update(instances.empty() ? 0 : &instances[0], (unsigned int)instances.size());
+    }
+
+    // byte offset of the instances written by the last update
+    size_t regionOffset() const
+    {
+        return (size_t)region * regionSize();
+    }
+
+    // points the instance attributes of a VAO at the current instances
+    void attach(unsigned int vao) const
+    {
+        layout.attach(vao, ID, regionOffset());
+    }
+
+private:
+    unsigned int region;
+    unsigned char* mapped;
+    GLsync fences[PERSISTENT_REGIONS];
+    vector<unsigned char> staging; // beginUpdate target when the buffer isn't persistently mapped
+
+    size_t regionSize() const
+    {
+        return (size_t)capacity * layout.stride;
+    }
+
+    void waitForRegion(unsigned int r)
+    {
+        if (!fences[r])
+            return;
+        // normally long signaled, three frames have passed since the GPU last read this region
+        while (glClientWaitSync(fences[r], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+        {
+        }
+        glDeleteSync(fences[r]);
+        fences[r] = 0;
+    }
+};
+#endif
@@ -10,14 +10,17 @@ in VS_OUT {
     vec2 TexCoords;
 } fs_in;
 
-struct Light {
-    vec3 Position;
-    vec3 Color;
-};
-
-uniform Light lights[4];
 uniform sampler2D diffuseTexture;
 uniform vec3 viewPos;
+uniform mat4 view;
+
+// clustered point lights (ClusteredLights in clusters.h)
+uniform samplerBuffer clusterLights;   // 3 texels per light: position + radius, color + linear, quadratic
+uniform usamplerBuffer clusterCells;   // per cluster: first index, light count
+uniform usamplerBuffer clusterIndices; // light indices of all clusters
+uniform vec2 clusterTileScale;         // tiles per pixel
+uniform vec2 clusterSliceParams;       // slice = log(view depth) * x + y
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24); // LightClusterGrid::TILES_X, TILES_Y, SLICES
 
 void main()
 {           
@@ -28,17 +31,25 @@ void main()
     // lighting
     vec3 lighting = vec3(0.0);
     vec3 viewDir = normalize(viewPos - fs_in.FragPos);
-    for(int i = 0; i < 4; i++)
+    // only the lights listed for this fragment's cluster can reach it
+    float viewDepth = -(view * vec4(fs_in.FragPos, 1.0)).z;
+    ivec3 clusterCoord = ivec3(ivec2(gl_FragCoord.xy * clusterTileScale), int(log(viewDepth) * clusterSliceParams.x + clusterSliceParams.y));
+    clusterCoord = clamp(clusterCoord, ivec3(0), CLUSTER_GRID - 1);
+    uvec2 cell = texelFetch(clusterCells, (clusterCoord.z * CLUSTER_GRID.y + clusterCoord.y) * CLUSTER_GRID.x + clusterCoord.x).xy;
+    for(uint i = 0u; i < cell.y; ++i)
     {
+        int light = int(texelFetch(clusterIndices, int(cell.x + i)).r);
+        vec4 positionRadius = texelFetch(clusterLights, 3 * light);
+        vec3 lightColor = texelFetch(clusterLights, 3 * light + 1).rgb;
         // diffuse
-        vec3 lightDir = normalize(lights[i].Position - fs_in.FragPos);
+        vec3 lightDir = normalize(positionRadius.xyz - fs_in.FragPos);
         float diff = max(dot(lightDir, normal), 0.0);
-        vec3 result = lights[i].Color * diff * color;      
-        // attenuation (use quadratic as we have gamma correction)
-        float distance = length(fs_in.FragPos - lights[i].Position);
-        result *= 1.0 / (distance * distance);
+        vec3 result = lightColor * diff * color;
+        // attenuation (use quadratic as we have gamma correction), windowed to reach 0 at the light's radius
+        float distance = length(fs_in.FragPos - positionRadius.xyz);
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        result *= window * window / (distance * distance);
         lighting += result;
-                
     }
     vec3 result = ambient + lighting;
     // check whether result is higher than some threshold, if so, output as bloom threshold color
@@ -0,0 +1,20 @@
+#version 330 core
+out vec4 FragColor;
+
+// adapts the luminance of the last frame towards the average of this one (the 1x1 level of the log
+// luminance chain), drawn into a 1x1 target: r = adapted luminance, g = exposure
+uniform sampler2D logLuminance; // r = log2 luminance * weight, g = weight
+uniform float minLogLuminance;
+uniform sampler2D lastExposure;
+uniform float averageLevel;
+uniform float adaptation; // 1 - exp(-deltaTime * speed)
+uniform float keyValue;
+
+void main()
+{
+    vec2 average = textureLod(logLuminance, vec2(0.5), averageLevel).rg;
+    float target = exp2(average.g > 0.0 ? average.r / average.g : minLogLuminance);
+    float last = texelFetch(lastExposure, ivec2(0), 0).r;
+    float adapted = last > 0.0 ? last + (target - last) * adaptation : target;
+    FragColor = vec4(adapted, keyValue / adapted, 0.0, 1.0);
+}
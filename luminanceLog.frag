@@ -0,0 +1,18 @@
+#version 330 core
+out vec2 FragColor;
+
+in vec2 TexCoords;
+
+// log2 luminance of the HDR image for the mip chain average of AutoExposure (autoexposure.h) on contexts
+// without compute shaders: r = log2 luminance * weight, g = weight, 0 for black pixels so they are left out of
+// the average like the histogram's black bin
+uniform sampler2D hdrImage;
+uniform float minLogLuminance;
+uniform float maxLogLuminance;
+
+void main()
+{
+    float luminance = dot(texture(hdrImage, TexCoords).rgb, vec3(0.2126, 0.7152, 0.0722));
+    float weight = luminance < 0.0001 ? 0.0 : 1.0;
+    FragColor = vec2(clamp(log2(max(luminance, 0.0001)), minLogLuminance, maxLogLuminance) * weight, weight);
+}
@@ -0,0 +1,154 @@
+
+
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "shader.h"
+#include "glstate.h"
+
+#include <string>
+#include <vector>
+using namespace std;
+
+struct Texture {
+    unsigned int id;
+    string type;
+    string path;
+};
+
+// one resolved sampler: which texture unit a texture lives on for a given shader
+struct MaterialBinding {
+    unsigned int unit;
+    GLenum target;
+    unsigned int textureID;
+};
+
+// a sampler given by name, for materials that don't come from a model (environment maps, lookup textures, ...)
+struct MaterialSampler {
+    string name;
+    GLenum target;
+    unsigned int textureID;
+};
+
+// A material is the set of textures of a mesh resolved against one shader program.
+// The sampler names ("texture_diffuse1", "texture_specular1", ...) are built and looked up
+// exactly once when the material is created, and the sampler uniforms are set right there
+// (they are program state, so they stick). Drawing with a material afterwards only binds the
+// texture handles, and not even that when the same material is still bound from the last draw.
+class Material
+{
+public:
+    unsigned int ID;      // unique, non-zero; used for the cheap "is this already bound" check
+    unsigned int program; // shader program the sampler units were resolved against
+    vector<unsigned int> textureIDs; // the source texture set, used to share materials between meshes
+    vector<MaterialBinding> bindings;
+
+    // returns the material for this texture set on this shader, creating it on first use.
+    // meshes that share the same textures (e.g. every mesh of the rock model) get the same material,
+    // so drawing them back to back never rebinds anything.
+    static Material& Get(Shader& shader, const vector<Texture>& textures)
+    {
+        vector<Material*>& table = materials();
+        for (unsigned int i = 0; i < table.size(); i++)
+        {
+            if (table[i]->program == shader.ID && table[i]->sameTextures(textures))
+                return *table[i];
+        }
+        // retrieve texture number (the N in diffuse_textureN)
+        unsigned int diffuseNr = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr = 1;
+        unsigned int heightNr = 1;
+        vector<MaterialSampler> samplers;
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            string number;
+            string name = textures[i].type;
+            if (name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if (name == "texture_specular")
+                number = std::to_string(specularNr++); // transfer unsigned int to string
+            else if (name == "texture_normal")
+                number = std::to_string(normalNr++); // transfer unsigned int to string
+            else if (name == "texture_height")
+                number = std::to_string(heightNr++); // transfer unsigned int to string
+            MaterialSampler sampler;
+            sampler.name = name + number;
+            sampler.target = GL_TEXTURE_2D;
+            sampler.textureID = textures[i].id;
+            samplers.push_back(sampler);
+        }
+        table.push_back(new Material(shader, samplers, static_cast<unsigned int>(table.size()) + 1));
+        return *table.back();
+    }
+
+    // creates a material from explicitly named samplers, texture units are assigned in order
+    static Material& Create(Shader& shader, const vector<MaterialSampler>& samplers)
+    {
+        vector<Material*>& table = materials();
+        table.push_back(new Material(shader, samplers, static_cast<unsigned int>(table.size()) + 1));
+        return *table.back();
+    }
+
+    // binds the material's textures to their units, skipped entirely if this material is already bound. Code that
+    // binds textures with raw glBindTexture calls has to call glState().invalidate() after them, or the next bind()
+    // of the last material is skipped with other textures on its units.
+    void bind() const
+    {
+        GLStateCache& state = glState();
+        if (state.boundMaterial == ID)
+        {
+            state.elided++;
+            return;
+        }
+        for (unsigned int i = 0; i < bindings.size(); i++)
+            state.bindTexture(GL_TEXTURE0 + bindings[i].unit, bindings[i].target, bindings[i].textureID);
+        // always good practice to set everything back to defaults once configured.
+        state.activeTexture(GL_TEXTURE0);
+        // any texture bind through the state cache resets this, so it's only trusted while nothing else touched the units
+        state.boundMaterial = ID;
+    }
+
+private:
+    Material(Shader& shader, const vector<MaterialSampler>& samplers, unsigned int id) : ID(id), program(shader.ID)
+    {
+        // sampler uniforms are program state, so the shader has to be in use to set them
+        shader.use();
+        for (unsigned int i = 0; i < samplers.size(); i++)
+        {
+            textureIDs.push_back(samplers[i].textureID);
+            // samplers the shader doesn't use are dropped, so we don't bind textures nobody reads
+            int location = glGetUniformLocation(shader.ID, samplers[i].name.c_str());
+            if (location == -1)
+                continue;
+            MaterialBinding binding;
+            binding.unit = i;
+            binding.target = samplers[i].target;
+            binding.textureID = samplers[i].textureID;
+            glUniform1i(location, binding.unit);
+            bindings.push_back(binding);
+        }
+    }
+
+    bool sameTextures(const vector<Texture>& textures) const
+    {
+        if (textures.size() != textureIDs.size())
+            return false;
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            if (textures[i].id != textureIDs[i])
+                return false;
+        }
+        return true;
+    }
+
+    // materials live for the whole program, so a plain table of pointers keeps their addresses stable
+    static vector<Material*>& materials()
+    {
+        static vector<Material*> table;
+        return table;
+    }
+};
+#endif
@@ -9,6 +9,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "material.h"
+#include "culling.h"
+#include "instancing.h"
 
 #include <string>
 #include <vector>
@@ -33,12 +36,6 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
-};
-
 class Mesh {
 public:
     // mesh Data
@@ -46,6 +43,9 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
     unsigned int VAO;
+    // bounds in model space, for culling
+    AABB bounds;
+    BoundingSphere boundingSphere;
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -53,6 +53,9 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        computeBounds(this->vertices, [](const Vertex& v) { return v.Position; }, bounds, boundingSphere);
+        attachedInstances = 0;
+        attachedOffset = 0;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
@@ -61,44 +64,52 @@ public:
     // render the mesh
     void Draw(Shader& shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int heightNr = 1;
-        for (unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if (name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-            else if (name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
+        // bind appropriate textures, resolved once per shader
+        getMaterial(shader).bind();
 
         // draw mesh
-        glBindVertexArray(VAO);
+        glState().bindVertexArray(VAO);
+        glState().primitiveRestart(GL_UNSIGNED_INT);
         glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    }
+
+    // render count instances of the mesh, reading per-instance attributes from the instance buffer
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, unsigned int count)
+    {
+        getMaterial(shader).bind();
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        glState().bindVertexArray(VAO);
+        // re-point the instance attributes only when the buffer (or its persistent region) changed
+        if (attachedInstances != instances.ID || attachedOffset != instances.regionOffset())
+        {
+            instances.attach(VAO);
+            attachedInstances = instances.ID;
+            attachedOffset = instances.regionOffset();
+        }
+        glState().primitiveRestart(GL_UNSIGNED_INT);
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0, count);
+    }
+
+    // the material this mesh's textures resolve to on the given shader
+    Material& getMaterial(Shader& shader)
+    {
+        for (unsigned int i = 0; i < materials.size(); i++)
+        {
+            if (materials[i]->program == shader.ID)
+                return *materials[i];
+        }
+        materials.push_back(&Material::Get(shader, textures));
+        return *materials.back();
     }
 
 private:
     // render data 
     unsigned int VBO, EBO;
+    // materials resolved so far, one per shader program this mesh was drawn with
+    vector<Material*> materials;
+    // instance buffer (and persistent region) the VAO's instance attributes currently point at
+    unsigned int attachedInstances;
+    size_t attachedOffset;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -108,15 +119,15 @@ private:
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        glState().bindVertexArray(VAO);
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
@@ -142,7 +153,7 @@ private:
         // weights
         glEnableVertexAttribArray(6);
         glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        glState().bindVertexArray(0);
     }
 };
 #endif
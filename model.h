@@ -33,11 +33,19 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // bounds of all meshes in model space
+    AABB bounds;
+    BoundingSphere boundingSphere;
+    // meshes drawn by the last culled Draw
+    unsigned int lastVisibleMeshes;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const& path, bool gamma = false) : gammaCorrection(gamma), lastVisibleMeshes(0)
     {
         loadModel(path);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            bounds.add(meshes[i].bounds);
+        boundingSphere = bounds.sphere();
     }
 
     // draws the model, and thus all its meshes
@@ -47,6 +55,32 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // draws count instances of the model, per-instance data comes from the instance buffer (locations 8 and up)
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, unsigned int count)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instances, count);
+    }
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances)
+    {
+        DrawInstanced(shader, instances, instances.count);
+    }
+
+    // draws only the meshes touching the frustum, model is the transform the shader will use
+    void Draw(Shader& shader, const Frustum& frustum, const glm::mat4& model)
+    {
+        lastVisibleMeshes = 0;
+        if (!frustum.intersects(boundingSphere.transformed(model)))
+            return;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (meshes.size() > 1 && !frustum.intersects(meshes[i].boundingSphere.transformed(model)))
+                continue;
+            meshes[i].Draw(shader);
+            lastVisibleMeshes++;
+        }
+    }
+
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path)
@@ -225,7 +259,7 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        glState().bindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
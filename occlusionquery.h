@@ -0,0 +1,230 @@
+
+
+#ifndef OCCLUSIONQUERY_H
+#define OCCLUSIONQUERY_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+#include "model.h"
+#include "glstate.h"
+#include "culling.h"
+#include "primitives.h"
+
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Occlusion culling of heavy individual models (the backpack, multi-mesh models) with hardware queries.
+//
+// An object that was hidden gets a GL_ANY_SAMPLES_PASSED query on its bounding box, and its real geometry is
+// drawn inside glBeginConditionalRender on that query: the GPU skips the draw when no sample of the box passed,
+// and the CPU never waits for a result (GL_QUERY_NO_WAIT draws anyway when the result isn't in yet).
+// Results are collected in the next frames, whenever they are available, and decide how the object is
+// drawn from then on (temporal coherence): visible objects are drawn normally and only re-queried every
+// revisitInterval frames (spread over frames by object), hidden ones keep being drawn conditionally.
+// Multi-mesh models are queried hierarchically: while the whole model is hidden one box query covers all
+// its meshes; once it is visible each mesh has its own, and when all of them are hidden again the model
+// falls back to the single query. At most maxQueriesPerFrame queries are issued per frame.
+//
+// Draw the big occluders first, a query only sees the depth drawn before it.
+class OcclusionQueries
+{
+public:
+    unsigned int maxQueriesPerFrame;
+    unsigned int revisitInterval;
+    // last frame's statistics; skipped objects and saved triangles are counted when the results come in
+    unsigned int queriesIssued;
+    unsigned int objectsSkipped;
+    unsigned long long trianglesSaved;
+
+    OcclusionQueries(unsigned int maxQueries = 64, unsigned int interval = 8)
+        : maxQueriesPerFrame(maxQueries), revisitInterval(interval), queriesIssued(0), objectsSkipped(0), trianglesSaved(0),
+          boxShader("boundingBox.vs", "boundingBox.frag"), frame(0), issued(0), skipped(0), saved(0)
+    {
+    }
+
+    // collects the query results that are in and rolls the statistics over, call once at the start of every frame
+    void beginFrame(const glm::mat4& projection, const glm::mat4& view)
+    {
+        viewProjection = projection * view;
+        glm::mat4 inverseView = glm::inverse(view);
+        cameraPosition = glm::vec3(inverseView[3]);
+        for (map<NodeKey, Node>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+        {
+            Node& node = it->second;
+            if (!node.pending)
+                continue;
+            GLuint available = 0;
+            glGetQueryObjectuiv(node.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint samples = 0;
+            glGetQueryObjectuiv(node.query, GL_QUERY_RESULT, &samples);
+            node.pending = false;
+            node.visible = samples != 0;
+            if (!node.visible && node.drawnConditionally)
+            {
+                skipped++;
+                saved += node.triangles;
+            }
+        }
+        queriesIssued = issued;
+        objectsSkipped = skipped;
+        trianglesSaved = saved;
+        issued = skipped = 0;
+        saved = 0;
+        frame++;
+    }
+
+    // draws the model's meshes in the frustum, skipping the occluded ones; shader and model matrix as for Model::Draw
+    void draw(Model& object, Shader& shader, const Frustum& frustum, const glm::mat4& model)
+    {
+        if (object.meshes.empty() || !frustum.intersects(object.boundingSphere.transformed(model)))
+            return;
+        Node& root = node(&object, -1, object);
+        if (object.meshes.size() == 1 || !root.visible)
+        {
+            // one query for the whole model
+            bool conditional = query(root, object.bounds, model);
+            shader.use();
+            beginDraw(root, conditional);
+            for (unsigned int i = 0; i < object.meshes.size(); i++)
+            {
+                if (object.meshes.size() == 1 || frustum.intersects(object.meshes[i].boundingSphere.transformed(model)))
+                    object.meshes[i].Draw(shader);
+            }
+            endDraw(conditional);
+            root.refined = false;
+            return;
+        }
+
+        // the model turned out visible: its meshes start out visible and get queries of their own
+        if (!root.refined)
+        {
+            for (unsigned int i = 0; i < object.meshes.size(); i++)
+                node(&object, (int)i, object).visible = true;
+            root.refined = true;
+        }
+        bool anyVisible = false;
+        for (unsigned int i = 0; i < object.meshes.size(); i++)
+        {
+            Mesh& mesh = object.meshes[i];
+            if (!frustum.intersects(mesh.boundingSphere.transformed(model)))
+                continue;
+            Node& child = node(&object, (int)i, object);
+            bool conditional = query(child, mesh.bounds, model);
+            shader.use();
+            beginDraw(child, conditional);
+            mesh.Draw(shader);
+            endDraw(conditional);
+            anyVisible = anyVisible || child.visible;
+        }
+        // everything hidden: back to one query for the whole model
+        if (!anyVisible)
+            root.visible = false;
+    }
+
+    void printStats() const
+    {
+        std::cout << "occlusion queries: " << queriesIssued << " issued, " << objectsSkipped << " objects skipped, "
+                  << trianglesSaved << " triangles saved" << std::endl;
+    }
+
+private:
+    typedef pair<const Model*, int> NodeKey; // mesh index, -1 for the whole model
+
+    struct Node {
+        GLuint query;
+        bool visible;            // last known result
+        bool pending;            // a query is in flight
+        bool drawnConditionally; // the in-flight query decided whether the geometry was drawn
+        bool refined;            // whole model: its meshes are queried one by one
+        unsigned int lastQueried;
+        unsigned long long triangles;
+    };
+
+    Shader boxShader;
+    map<NodeKey, Node> nodes;
+    glm::mat4 viewProjection;
+    glm::vec3 cameraPosition;
+    unsigned int frame;
+    unsigned int issued, skipped;
+    unsigned long long saved;
+
+    Node& node(const Model* object, int mesh, const Model& source)
+    {
+        map<NodeKey, Node>::iterator it = nodes.find(NodeKey(object, mesh));
+        if (it != nodes.end())
+            return it->second;
+        Node created;
+        glGenQueries(1, &created.query);
+        created.visible = true; // new objects are drawn and queried right away
+        created.pending = false;
+        created.drawnConditionally = false;
+        created.refined = false;
+        // spread the revisits of different objects over the frames
+        created.lastQueried = frame - (unsigned int)(nodes.size() % revisitInterval) - revisitInterval;
+        created.triangles = 0;
+        for (unsigned int i = 0; i < source.meshes.size(); i++)
+            if (mesh < 0 || (int)i == mesh)
+                created.triangles += source.meshes[i].indices.size() / 3;
+        return nodes.insert(make_pair(NodeKey(object, mesh), created)).first->second;
+    }
+
+    // issues a bounding box query for the node if it is due, returns whether its draw should depend on it
+    bool query(Node& n, const AABB& localBounds, const glm::mat4& model)
+    {
+        if (n.pending)
+            return !n.visible; // the query from an earlier frame still stands in for it
+        bool due = !n.visible || frame - n.lastQueried >= revisitInterval;
+        if (!due || issued >= maxQueriesPerFrame)
+            return false;
+        // with the camera inside the box its faces would be clipped away, so it counts as visible
+        AABB world;
+        for (unsigned int c = 0; c < 8; c++)
+            world.add(glm::vec3(model * glm::vec4(c & 1 ? localBounds.max.x : localBounds.min.x,
+                                                  c & 2 ? localBounds.max.y : localBounds.min.y,
+                                                  c & 4 ? localBounds.max.z : localBounds.min.z, 1.0f)));
+        glm::vec3 margin(0.2f); // near plane distance and then some
+        if (glm::all(glm::greaterThanEqual(cameraPosition, world.min - margin)) && glm::all(glm::lessThanEqual(cameraPosition, world.max + margin)))
+        {
+            n.visible = true;
+            n.lastQueried = frame;
+            return false;
+        }
+
+        boxShader.use();
+        glm::mat4 box = glm::scale(glm::translate(glm::mat4(1.0f), world.center()), world.extents());
+        boxShader.setMat4("mvp", viewProjection * box);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glState().depthMask(GL_FALSE);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, n.query);
+        Primitives::Cube().draw();
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        glState().depthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        issued++;
+        n.pending = true;
+        n.lastQueried = frame;
+        n.drawnConditionally = !n.visible;
+        return n.drawnConditionally;
+    }
+
+    void beginDraw(const Node& n, bool conditional)
+    {
+        if (conditional)
+            glBeginConditionalRender(n.query, GL_QUERY_NO_WAIT);
+    }
+    void endDraw(bool conditional)
+    {
+        if (conditional)
+            glEndConditionalRender();
+    }
+};
+#endif
@@ -5,23 +5,33 @@ out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 WorldPos;
 in vec3 Normal;
+flat in float Metallic;
+flat in float Roughness;
 
-// material parameters
+// material parameters (metallic and roughness come per vertex/instance)
 uniform vec3 albedo;
-uniform float metallic;
-uniform float roughness;
 uniform float ao;
 
 // IBL
 uniform samplerCube irradianceMap;
 
-// lights
-uniform vec3 lightPositions[4];
-uniform vec3 lightColors[4];
-
-uniform vec3 camPos;
+// per-frame constants, written to the frame ring buffer once a frame (FrameConstants in glLearn.cpp)
+layout (std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec4 camPos; // xyz
+};
+
+// clustered point lights (ClusteredLights in clusters.h)
+uniform samplerBuffer clusterLights;   // 3 texels per light: position + radius, color + linear, quadratic
+uniform usamplerBuffer clusterCells;   // per cluster: first index, light count
+uniform usamplerBuffer clusterIndices; // light indices of all clusters
+uniform vec2 clusterTileScale;         // tiles per pixel
+uniform vec2 clusterSliceParams;       // slice = log(view depth) * x + y
 
 const float PI = 3.14159265359;
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24); // LightClusterGrid::TILES_X, TILES_Y, SLICES
 // ----------------------------------------------------------------------------
 float DistributionGGX(vec3 N, vec3 H, float roughness)
 {
@@ -65,8 +75,10 @@ vec3 fresnelSchlick(float cosTheta, vec3 F0)
 // ----------------------------------------------------------------------------
 void main()
 {		
-    vec3 N = Normal;
-    vec3 V = normalize(camPos - WorldPos);
+    float metallic = Metallic;
+    float roughness = Roughness;
+    vec3 N = normalize(Normal);
+    vec3 V = normalize(camPos.xyz - WorldPos);
     vec3 R = reflect(-V, N); 
 
     // calculate reflectance at normal incidence; if dia-electric (like plastic) use F0 
@@ -74,16 +86,26 @@ void main()
     vec3 F0 = vec3(0.04); 
     F0 = mix(F0, albedo, metallic);
 
-    // reflectance equation
+    // reflectance equation, over the lights of this fragment's cluster only
+    float viewDepth = -(view * vec4(WorldPos, 1.0)).z;
+    ivec3 clusterCoord = ivec3(ivec2(gl_FragCoord.xy * clusterTileScale), int(log(viewDepth) * clusterSliceParams.x + clusterSliceParams.y));
+    clusterCoord = clamp(clusterCoord, ivec3(0), CLUSTER_GRID - 1);
+    uvec2 cell = texelFetch(clusterCells, (clusterCoord.z * CLUSTER_GRID.y + clusterCoord.y) * CLUSTER_GRID.x + clusterCoord.x).xy;
     vec3 Lo = vec3(0.0);
-    for(int i = 0; i < 4; ++i) 
+    for(uint i = 0u; i < cell.y; ++i) 
     {
+        int light = int(texelFetch(clusterIndices, int(cell.x + i)).r);
+        vec4 positionRadius = texelFetch(clusterLights, 3 * light);
+        vec3 lightColor = texelFetch(clusterLights, 3 * light + 1).rgb;
+
         // calculate per-light radiance
-        vec3 L = normalize(lightPositions[i] - WorldPos);
+        vec3 L = normalize(positionRadius.xyz - WorldPos);
         vec3 H = normalize(V + L);
-        float distance = length(lightPositions[i] - WorldPos);
-        float attenuation = 1.0 / (distance * distance);
-        vec3 radiance = lightColors[i] * attenuation;
+        float distance = length(positionRadius.xyz - WorldPos);
+        // inverse square falloff, windowed to reach 0 at the light's radius
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance);
+        vec3 radiance = lightColor * attenuation;
 
         // Cook-Torrance BRDF
         float NDF = DistributionGGX(N, H, roughness);   
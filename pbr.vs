@@ -8,17 +8,29 @@ layout (location = 2) in vec2 aTexCoords;
 out vec2 TexCoords;
 out vec3 WorldPos;
 out vec3 Normal;
+flat out float Metallic;
+flat out float Roughness;
+
+// per-frame constants, written to the frame ring buffer once a frame (FrameConstants in glLearn.cpp)
+layout (std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec4 camPos; // xyz
+};
 
-uniform mat4 projection;
-uniform mat4 view;
 uniform mat4 model;
 uniform mat3 normalMatrix;
+uniform float metallic;
+uniform float roughness;
 
 void main()
 {
     TexCoords = aTexCoords;
     WorldPos = vec3(model * vec4(aPos, 1.0));
     Normal = normalMatrix * aNormal;   
+    Metallic = metallic;
+    Roughness = roughness;
 
     gl_Position =  projection * view * vec4(WorldPos, 1.0);
 }
@@ -0,0 +1,36 @@
+
+
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per instance: world position + uniform scale, and the material parameters
+layout (location = 8) in vec4 aPositionScale;
+layout (location = 9) in vec4 aMaterial; // x = metallic, y = roughness
+
+out vec2 TexCoords;
+out vec3 WorldPos;
+out vec3 Normal;
+flat out float Metallic;
+flat out float Roughness;
+
+// per-frame constants, written to the frame ring buffer once a frame (FrameConstants in glLearn.cpp)
+layout (std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec4 camPos; // xyz
+};
+
+void main()
+{
+    TexCoords = aTexCoords;
+    WorldPos = aPos * aPositionScale.w + aPositionScale.xyz;
+    // with only a translation and a uniform scale the normal matrix is the identity (up to a scale
+    // that the fragment shader normalizes away), so no per-instance inverse is needed at all
+    Normal = aNormal;
+    Metallic = aMaterial.x;
+    Roughness = aMaterial.y;
+
+    gl_Position =  projection * view * vec4(WorldPos, 1.0);
+}
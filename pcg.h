@@ -0,0 +1,46 @@
+
+
+#ifndef PCG_H
+#define PCG_H
+
+#include <cstdint>
+
+// PCG32 (pcg-random.org, XSH RR variant): 8 bytes of state, fast, and the same sequence for the same seed
+// on every platform and standard library, unlike rand() or the <random> distributions.
+class PCG32
+{
+public:
+    explicit PCG32(uint64_t seed = 0x853c49e6748fea9bull, uint64_t stream = 0xda3e39cb94b95bdbull)
+    {
+        state = 0;
+        increment = (stream << 1) | 1;
+        next();
+        state += seed;
+        next();
+    }
+
+    uint32_t next()
+    {
+        uint64_t old = state;
+        state = old * 6364136223846793005ull + increment;
+        uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        uint32_t rot = (uint32_t)(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // uniform in [0, 1), 24 random bits
+    float nextFloat()
+    {
+        return (float)(next() >> 8) * (1.0f / 16777216.0f);
+    }
+    // uniform in [low, high)
+    float range(float low, float high)
+    {
+        return low + (high - low) * nextFloat();
+    }
+
+private:
+    uint64_t state;
+    uint64_t increment;
+};
+#endif
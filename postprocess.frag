@@ -0,0 +1,198 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// the whole post-processing chain in one pass: MSAA resolve, bloom composite, exposure, tone mapping and gamma.
+// The HDR scene and the bloom are read once per pixel, the LDR result written once.
+uniform sampler2D scene;              // the HDR scene when sceneSamples is 1, may be smaller than the target
+uniform sampler2DMS sceneMultisample; // or the multisampled one, resolved here after tone mapping
+uniform int sceneSamples;
+uniform bool toneMapSamples;          // tone map every sample before averaging instead of the average
+uniform sampler2D bloomBlur;
+uniform bool bloom;
+uniform float bloomStrength;
+uniform float exposure;          // or the compensation multiplied in with autoExposure
+uniform bool autoExposure;
+uniform sampler2D exposureTexture; // 1x1, g = exposure, see AutoExposure in autoexposure.h
+uniform int toneMapOperator; // ToneMapOperator of postprocess.h
+uniform bool encodeGamma;    // false when writing to an sRGB framebuffer, which encodes by itself
+uniform float gamma;
+uniform int upscaleFilter;   // UpscaleFilter of postprocess.h, for a scene smaller than the target
+uniform vec2 targetSize;
+
+const int TONEMAP_NONE = 0;
+const int TONEMAP_EXPOSURE = 1;
+const int TONEMAP_REINHARD = 2;
+const int TONEMAP_ACES = 3;
+const int TONEMAP_UNCHARTED2 = 4;
+
+const int UPSCALE_BILINEAR = 0;
+const int UPSCALE_EDGE = 1;
+
+vec3 toneMapExposure(vec3 color)
+{
+    return vec3(1.0) - exp(-color);
+}
+
+vec3 toneMapReinhard(vec3 color)
+{
+    return color / (color + vec3(1.0));
+}
+
+// Narkowicz's fit of the ACES filmic curve
+vec3 toneMapACES(vec3 color)
+{
+    const float a = 2.51;
+    const float b = 0.03;
+    const float c = 2.43;
+    const float d = 0.59;
+    const float e = 0.14;
+    return clamp((color * (a * color + b)) / (color * (c * color + d) + e), 0.0, 1.0);
+}
+
+// Hable's filmic curve from Uncharted 2, white point at 11.2
+vec3 uncharted2Curve(vec3 x)
+{
+    const float A = 0.15;
+    const float B = 0.50;
+    const float C = 0.10;
+    const float D = 0.20;
+    const float E = 0.02;
+    const float F = 0.30;
+    return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+}
+vec3 toneMapUncharted2(vec3 color)
+{
+    const float exposureBias = 2.0;
+    const vec3 white = vec3(11.2);
+    return uncharted2Curve(color * exposureBias) / uncharted2Curve(white);
+}
+
+vec3 toneMap(vec3 hdrColor, float exposureScale)
+{
+    vec3 color = hdrColor * exposureScale;
+    if (toneMapOperator == TONEMAP_EXPOSURE)
+        return toneMapExposure(color);
+    if (toneMapOperator == TONEMAP_REINHARD)
+        return toneMapReinhard(color);
+    if (toneMapOperator == TONEMAP_ACES)
+        return toneMapACES(color);
+    if (toneMapOperator == TONEMAP_UNCHARTED2)
+        return toneMapUncharted2(color);
+    return clamp(color, 0.0, 1.0);
+}
+
+// Edge adaptive upscaling, a simplified take on FSR 1's EASU: the 4x4 texels around the pixel are weighted by
+// a Lanczos 2 like kernel that is stretched along the local edge and squeezed across it, so edges come out
+// sharp and without stairs where bilinear blurs them. Ringing is clamped to the nearest 2x2 texels.
+float edgeLuma(vec3 color)
+{
+    float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    return luma / (1.0 + luma); // bounded, so HDR highlights don't make every edge look strong
+}
+
+// polynomial fit of Lanczos 2 over a squared distance in [0, 4]
+float lanczos2(float distance2)
+{
+    float x = min(distance2, 4.0);
+    float window = 0.25 * x - 1.0;
+    float base = 0.4 * x - 1.0;
+    return (1.5625 * base * base - 0.5625) * window * window;
+}
+
+vec3 upscaleEdge(vec2 uv)
+{
+    ivec2 size = textureSize(scene, 0);
+    vec2 position = uv * vec2(size) - 0.5;
+    ivec2 origin = ivec2(floor(position)) - 1;
+    vec2 f = fract(position);
+
+    vec3 colors[16];
+    float lumas[16];
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            colors[y * 4 + x] = texelFetch(scene, clamp(origin + ivec2(x, y), ivec2(0), size - 1), 0).rgb;
+            lumas[y * 4 + x] = edgeLuma(colors[y * 4 + x]);
+        }
+    }
+
+    // the luma gradient of the inner 2x2, bilinearly weighted to this pixel, and how strong an edge it is
+    // against the range of the 4x4
+    vec2 gradient = vec2(0.0);
+    float lumaMin = lumas[0], lumaMax = lumas[0];
+    for (int i = 1; i < 16; i++)
+    {
+        lumaMin = min(lumaMin, lumas[i]);
+        lumaMax = max(lumaMax, lumas[i]);
+    }
+    for (int y = 1; y <= 2; y++)
+    {
+        for (int x = 1; x <= 2; x++)
+        {
+            int i = y * 4 + x;
+            vec2 g = vec2(lumas[i + 1] - lumas[i - 1], lumas[i + 4] - lumas[i - 4]) * 0.5;
+            gradient += g * (x == 1 ? 1.0 - f.x : f.x) * (y == 1 ? 1.0 - f.y : f.y);
+        }
+    }
+    float gradientLength = length(gradient);
+    float edge = clamp(2.0 * gradientLength / max(lumaMax - lumaMin, 1e-4), 0.0, 1.0);
+    vec2 across = gradientLength > 1e-6 ? gradient / gradientLength : vec2(1.0, 0.0);
+    vec2 along = vec2(-across.y, across.x);
+    float alongScale = 1.0 / (1.0 + 2.0 * edge); // up to three times as wide along the edge (as far as the 4x4 reaches)
+    float acrossScale = 1.0 + 0.25 * edge;       // and a little narrower across it
+
+    vec3 sum = vec3(0.0);
+    float weightSum = 0.0;
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            vec2 offset = vec2(x - 1, y - 1) - f;
+            vec2 rotated = vec2(dot(offset, along) * alongScale, dot(offset, across) * acrossScale);
+            float weight = lanczos2(dot(rotated, rotated));
+            sum += colors[y * 4 + x] * weight;
+            weightSum += weight;
+        }
+    }
+    vec3 nearestMin = min(min(colors[5], colors[6]), min(colors[9], colors[10]));
+    vec3 nearestMax = max(max(colors[5], colors[6]), max(colors[9], colors[10]));
+    return clamp(sum / weightSum, nearestMin, nearestMax);
+}
+
+void main()
+{
+    float exposureScale = autoExposure ? texelFetch(exposureTexture, ivec2(0), 0).g * exposure : exposure;
+    vec3 bloomColor = bloom ? texture(bloomBlur, TexCoords).rgb * bloomStrength : vec3(0.0);
+    vec3 result;
+    if (sceneSamples > 1 && toneMapSamples)
+    {
+        // edges against bright areas stay antialiased, for sceneSamples tone mapping curves per pixel
+        ivec2 pixel = ivec2(TexCoords * vec2(textureSize(sceneMultisample)));
+        result = vec3(0.0);
+        for (int i = 0; i < sceneSamples; i++)
+            result += toneMap(texelFetch(sceneMultisample, pixel, i).rgb + bloomColor, exposureScale);
+        result /= float(sceneSamples);
+    }
+    else if (sceneSamples > 1)
+    {
+        // the same box resolve as blitting the multisampled framebuffer
+        ivec2 pixel = ivec2(TexCoords * vec2(textureSize(sceneMultisample)));
+        vec3 hdrColor = vec3(0.0);
+        for (int i = 0; i < sceneSamples; i++)
+            hdrColor += texelFetch(sceneMultisample, pixel, i).rgb;
+        result = toneMap(hdrColor / float(sceneSamples) + bloomColor, exposureScale);
+    }
+    else
+    {
+        // the edge filter only runs where there is something to scale up
+        bool upscaling = upscaleFilter == UPSCALE_EDGE && any(lessThan(vec2(textureSize(scene, 0)), targetSize));
+        vec3 hdrColor = upscaling ? upscaleEdge(TexCoords) : texture(scene, TexCoords).rgb;
+        result = toneMap(hdrColor + bloomColor, exposureScale);
+    }
+    if (encodeGamma)
+        result = pow(result, vec3(1.0 / gamma));
+    FragColor = vec4(result, 1.0);
+}
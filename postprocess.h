@@ -0,0 +1,112 @@
+
+
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "shader.h"
+#include "glstate.h"
+#include "primitives.h"
+
+using namespace std;
+
+// tone mapping curves of postprocess.frag (same values as its TONEMAP_ constants)
+enum ToneMapOperator {
+    TONEMAP_NONE,       // clamp
+    TONEMAP_EXPOSURE,   // 1 - exp(-color * exposure), as in hdr.frag and bloomFinal.frag
+    TONEMAP_REINHARD,
+    TONEMAP_ACES,       // Narkowicz's fit
+    TONEMAP_UNCHARTED2  // Hable's filmic curve
+};
+
+// how postprocess.frag scales a scene smaller than its target up (same values as its UPSCALE_ constants)
+enum UpscaleFilter {
+    UPSCALE_BILINEAR, // the scene texture's own filtering, so it should be GL_LINEAR
+    UPSCALE_EDGE      // edge adaptive, 16 texel fetches a pixel (upscaleEdge() in postprocess.frag)
+};
+
+// The post-processing chain as a single full screen pass.
+//
+// The lessons run it as separate passes that each read and write the whole framebuffer: blitting the MSAA
+// target into an intermediate one, then bloomFinal.frag (or hdr.frag) for the bloom composite, exposure, tone
+// mapping and gamma. postprocess.frag does all of it per pixel: it reads the HDR scene (a plain or a
+// multisampled texture, resolved in the shader) and the bloom once and writes the final LDR color once.
+// Drawing into an sRGB framebuffer (an SRGB8_ALPHA8 target, or a window made with GLFW_SRGB_CAPABLE) leaves
+// the gamma curve to the hardware: set srgbOutput and GL_FRAMEBUFFER_SRGB is switched on for the pass and the
+// pow() skipped.
+// The scene may be smaller than the target, as with DynamicResolution (dynamicresolution.h): the pass then scales
+// it up on the way, by upscale, at no extra pass.
+class PostProcess
+{
+public:
+    static const unsigned int SCENE_UNIT = 0;
+    static const unsigned int BLOOM_UNIT = 1;
+    static const unsigned int SCENE_MULTISAMPLE_UNIT = 2;
+    static const unsigned int EXPOSURE_UNIT = 3;
+
+    ToneMapOperator toneMap;
+    float exposure;            // with autoExposure a compensation on top of the measured exposure
+    unsigned int autoExposure; // AutoExposure::exposureTexture() (autoexposure.h), 0 for the manual exposure
+    float gamma;
+    bool bloom;
+    float bloomStrength;       // 1 / levels for Bloom (bloom.h)
+    bool srgbOutput;
+    bool toneMapSamples;       // MSAA: tone map every sample and average those, smoother edges for more ALU work
+    UpscaleFilter upscale;     // for a scene smaller than the target; a multisampled one is read at the nearest pixel
+
+    PostProcess()
+        : toneMap(TONEMAP_EXPOSURE), exposure(1.0f), autoExposure(0), gamma(2.2f), bloom(true), bloomStrength(1.0f),
+          srgbOutput(false), toneMapSamples(false), upscale(UPSCALE_EDGE), shader("blur.vs", "postprocess.frag")
+    {
+        shader.use();
+        shader.setInt("scene", SCENE_UNIT);
+        shader.setInt("bloomBlur", BLOOM_UNIT);
+        shader.setInt("sceneMultisample", SCENE_MULTISAMPLE_UNIT);
+        shader.setInt("exposureTexture", EXPOSURE_UNIT);
+    }
+
+    // draws sceneTexture (HDR, at most targetWidth x targetHeight; a GL_TEXTURE_2D_MULTISAMPLE when
+    // sceneSamples > 1) plus bloomTexture (0 for none) to targetFBO (0 for the window)
+    void apply(unsigned int sceneTexture, unsigned int bloomTexture, unsigned int targetFBO, int targetWidth, int targetHeight,
+               int sceneSamples = 1)
+    {
+        glState().bindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+        glState().viewport(0, 0, targetWidth, targetHeight);
+        glState().disable(GL_DEPTH_TEST);
+        glState().disable(GL_BLEND);
+        if (srgbOutput)
+            glState().enable(GL_FRAMEBUFFER_SRGB);
+
+        shader.use();
+        if (sceneSamples > 1)
+            glState().bindTexture(GL_TEXTURE0 + SCENE_MULTISAMPLE_UNIT, GL_TEXTURE_2D_MULTISAMPLE, sceneTexture);
+        else
+            glState().bindTexture(GL_TEXTURE0 + SCENE_UNIT, GL_TEXTURE_2D, sceneTexture);
+        bool withBloom = bloom && bloomTexture != 0;
+        if (withBloom)
+            glState().bindTexture(GL_TEXTURE0 + BLOOM_UNIT, GL_TEXTURE_2D, bloomTexture);
+        shader.setInt("sceneSamples", sceneSamples);
+        shader.setBool("toneMapSamples", toneMapSamples);
+        shader.setBool("bloom", withBloom);
+        shader.setFloat("bloomStrength", bloomStrength);
+        shader.setFloat("exposure", exposure);
+        shader.setBool("autoExposure", autoExposure != 0);
+        if (autoExposure)
+            glState().bindTexture(GL_TEXTURE0 + EXPOSURE_UNIT, GL_TEXTURE_2D, autoExposure);
+        shader.setInt("toneMapOperator", toneMap);
+        shader.setBool("encodeGamma", !srgbOutput);
+        shader.setFloat("gamma", gamma);
+        shader.setInt("upscaleFilter", upscale);
+        shader.setVec2("targetSize", (float)targetWidth, (float)targetHeight);
+        Primitives::Quad().draw();
+
+        if (srgbOutput)
+            glState().disable(GL_FRAMEBUFFER_SRGB);
+        glState().enable(GL_DEPTH_TEST);
+    }
+
+private:
+    Shader shader;
+};
+#endif
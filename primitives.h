@@ -0,0 +1,459 @@
+
+
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "glstate.h"
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <vector>
+using namespace std;
+
+// 16 bit index that ends the current strip (GL_PRIMITIVE_RESTART)
+const uint16_t PRIMITIVE_RESTART_INDEX = 0xFFFF;
+
+enum PrimitiveType {
+    PRIMITIVE_SPHERE,
+    PRIMITIVE_ICOSPHERE,
+    PRIMITIVE_CUBE,
+    PRIMITIVE_PLANE,
+    PRIMITIVE_QUAD,
+    PRIMITIVE_CYLINDER
+};
+
+// a generated mesh living on the GPU. Vertices are interleaved position/normal/texcoord at locations 0/1/2,
+// except for the quad which is position/texcoord at locations 0/1 like the post-processing shaders expect.
+struct Primitive {
+    unsigned int VAO, VBO, EBO;
+    GLenum mode;
+    unsigned int indexCount;  // or vertex count when EBO is 0
+    unsigned int vertexCount;
+
+    Primitive() : VAO(0), VBO(0), EBO(0), mode(GL_TRIANGLES), indexCount(0), vertexCount(0)
+    {
+    }
+
+    DrawItem drawItem() const
+    {
+        DrawItem item;
+        item.VAO = VAO;
+        item.mode = mode;
+        item.count = indexCount;
+        item.indexType = EBO ? GL_UNSIGNED_SHORT : 0;
+        return item;
+    }
+
+    void draw() const
+    {
+        RenderQueue::draw(drawItem());
+    }
+};
+
+// Procedural meshes built on first request and cached by their tessellation parameters, so asking for the
+// same sphere twice returns the same VAO. All indexed primitives use 16 bit indices and strips are split
+// with primitive restart instead of degenerate triangles.
+class Primitives
+{
+public:
+    // UV sphere of radius 1, xSegments around and ySegments from pole to pole
+    static const Primitive& Sphere(unsigned int xSegments = 64, unsigned int ySegments = 64)
+    {
+        // at least a closed surface, and every vertex index below the restart index
+        xSegments = std::max(xSegments, 3u);
+        ySegments = std::max(ySegments, 2u);
+        while ((xSegments + 1) * (ySegments + 1) >= PRIMITIVE_RESTART_INDEX)
+        {
+            xSegments = std::max(xSegments / 2, 3u);
+            ySegments = std::max(ySegments / 2, 2u);
+        }
+        Primitive& primitive = cached(PRIMITIVE_SPHERE, xSegments, ySegments);
+        if (primitive.VAO == 0)
+            buildSphere(primitive, xSegments, ySegments);
+        return primitive;
+    }
+
+    // subdivided icosahedron of radius 1, evenly spread triangles (no pinching at the poles)
+    static const Primitive& Icosphere(unsigned int subdivisions = 3)
+    {
+        if (subdivisions > 6)
+            subdivisions = 6; // 40962 vertices, the most that fits 16 bit indices
+        Primitive& primitive = cached(PRIMITIVE_ICOSPHERE, subdivisions, 0);
+        if (primitive.VAO == 0)
+            buildIcosphere(primitive, subdivisions);
+        return primitive;
+    }
+
+    // 2x2x2 cube centered on the origin, 24 vertices so every face has its own normals and texcoords
+    static const Primitive& Cube()
+    {
+        Primitive& primitive = cached(PRIMITIVE_CUBE, 0, 0);
+        if (primitive.VAO == 0)
+            buildCube(primitive);
+        return primitive;
+    }
+
+    // 2x2 plane on XZ facing +Y, split in xSegments*zSegments cells
+    static const Primitive& Plane(unsigned int xSegments = 1, unsigned int zSegments = 1)
+    {
+        xSegments = std::max(xSegments, 1u);
+        zSegments = std::max(zSegments, 1u);
+        while ((xSegments + 1) * (zSegments + 1) >= PRIMITIVE_RESTART_INDEX)
+        {
+            xSegments = std::max(xSegments / 2, 1u);
+            zSegments = std::max(zSegments / 2, 1u);
+        }
+        Primitive& primitive = cached(PRIMITIVE_PLANE, xSegments, zSegments);
+        if (primitive.VAO == 0)
+            buildPlane(primitive, xSegments, zSegments);
+        return primitive;
+    }
+
+    // screen filling quad in normalized device coordinates, for post-processing passes
+    static const Primitive& Quad()
+    {
+        Primitive& primitive = cached(PRIMITIVE_QUAD, 0, 0);
+        if (primitive.VAO == 0)
+            buildQuad(primitive);
+        return primitive;
+    }
+
+    // capped cylinder of radius 1 from y = -1 to y = 1
+    static const Primitive& Cylinder(unsigned int segments = 32)
+    {
+        if (segments < 3)
+            segments = 3;
+        Primitive& primitive = cached(PRIMITIVE_CYLINDER, segments, 0);
+        if (primitive.VAO == 0)
+            buildCylinder(primitive, segments);
+        return primitive;
+    }
+
+    // tessellation levels handed out by SphereForScreenSize, from far away to close up
+    static const unsigned int SPHERE_LOD_COUNT = 4;
+    static unsigned int SphereLODSegments(unsigned int level)
+    {
+        static const unsigned int segments[SPHERE_LOD_COUNT] = { 8, 16, 32, 64 };
+        return segments[level < SPHERE_LOD_COUNT ? level : SPHERE_LOD_COUNT - 1];
+    }
+    static const Primitive& SphereLOD(unsigned int level)
+    {
+        unsigned int segments = SphereLODSegments(level);
+        return Sphere(segments, segments / 2);
+    }
+
+    // radius in pixels of a sphere on screen
+    static float ProjectedRadius(float worldRadius, float distance, float fovY, float viewportHeight)
+    {
+        if (distance <= worldRadius)
+            return viewportHeight; // camera inside or touching the sphere
+        return worldRadius / (distance * std::tan(fovY * 0.5f)) * viewportHeight * 0.5f;
+    }
+
+    // picks the LOD level whose segments span roughly pixelsPerSegment pixels of the sphere's silhouette,
+    // so a sphere a few pixels wide isn't drawn with thousands of triangles
+    static unsigned int SphereLODForScreenSize(float radiusPixels, float pixelsPerSegment = 8.0f)
+    {
+        float wanted = 2.0f * 3.14159265359f * radiusPixels / pixelsPerSegment;
+        unsigned int level = 0;
+        while (level + 1 < SPHERE_LOD_COUNT && (float)SphereLODSegments(level) < wanted)
+            level++;
+        return level;
+    }
+
+    static const Primitive& SphereForScreenSize(float worldRadius, float distance, float fovY, float viewportHeight)
+    {
+        return SphereLOD(SphereLODForScreenSize(ProjectedRadius(worldRadius, distance, fovY, viewportHeight)));
+    }
+
+private:
+    // primitives live in a map so the references handed out stay valid
+    static Primitive& cached(PrimitiveType type, unsigned int a, unsigned int b)
+    {
+        static map<uint64_t, Primitive> cache;
+        uint64_t key = ((uint64_t)type << 48) | ((uint64_t)a << 24) | (uint64_t)b;
+        return cache[key];
+    }
+
+    // uploads interleaved position(3)/normal(3)/texcoord(2) vertices and 16 bit indices
+    static void upload(Primitive& primitive, const vector<float>& vertices, const vector<uint16_t>& indices, GLenum mode)
+    {
+        primitive.mode = mode;
+        primitive.vertexCount = static_cast<unsigned int>(vertices.size() / 8);
+        primitive.indexCount = static_cast<unsigned int>(indices.size());
+        glGenVertexArrays(1, &primitive.VAO);
+        glGenBuffers(1, &primitive.VBO);
+        glGenBuffers(1, &primitive.EBO);
+        glState().bindVertexArray(primitive.VAO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, primitive.VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+        glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitive.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), &indices[0], GL_STATIC_DRAW);
+        unsigned int stride = (3 + 3 + 2) * sizeof(float);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+        glState().bindVertexArray(0);
+    }
+
+    static void buildSphere(Primitive& primitive, unsigned int X_SEGMENTS, unsigned int Y_SEGMENTS)
+    {
+        const float PI = 3.14159265359f;
+        // the sin/cos of every ring and every meridian are computed once, so filling the grid is only multiplies
+        vector<float> cosTheta(X_SEGMENTS + 1), sinTheta(X_SEGMENTS + 1), cosPhi(Y_SEGMENTS + 1), sinPhi(Y_SEGMENTS + 1);
+        for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+        {
+            float theta = (float)x / (float)X_SEGMENTS * 2.0f * PI;
+            cosTheta[x] = std::cos(theta);
+            sinTheta[x] = std::sin(theta);
+        }
+        for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
+        {
+            float phi = (float)y / (float)Y_SEGMENTS * PI;
+            cosPhi[y] = std::cos(phi);
+            sinPhi[y] = std::sin(phi);
+        }
+
+        vector<float> vertices((X_SEGMENTS + 1) * (Y_SEGMENTS + 1) * 8);
+        float* v = &vertices[0];
+        for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
+        {
+            for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+            {
+                float xPos = cosTheta[x] * sinPhi[y];
+                float yPos = cosPhi[y];
+                float zPos = sinTheta[x] * sinPhi[y];
+                v[0] = xPos; v[1] = yPos; v[2] = zPos;          // position
+                v[3] = xPos; v[4] = yPos; v[5] = zPos;          // normal
+                v[6] = (float)x / (float)X_SEGMENTS;            // texcoords
+                v[7] = (float)y / (float)Y_SEGMENTS;
+                v += 8;
+            }
+        }
+
+        // one strip per ring, separated by the restart index. Like the plane each pair starts on the lower
+        // row, and the ring is walked against theta so the triangles wind counter-clockwise seen from outside
+        vector<uint16_t> indices(Y_SEGMENTS * (2 * (X_SEGMENTS + 1) + 1) - 1);
+        uint16_t* i = &indices[0];
+        for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
+        {
+            if (y > 0)
+                *i++ = PRIMITIVE_RESTART_INDEX;
+            for (unsigned int x = X_SEGMENTS + 1; x-- > 0;)
+            {
+                *i++ = (uint16_t)(y * (X_SEGMENTS + 1) + x);
+                *i++ = (uint16_t)((y + 1) * (X_SEGMENTS + 1) + x);
+            }
+        }
+        upload(primitive, vertices, indices, GL_TRIANGLE_STRIP);
+    }
+
+    static void buildIcosphere(Primitive& primitive, unsigned int subdivisions)
+    {
+        const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+        vector<glm::vec3> positions;
+        positions.reserve(10 * (1u << (2 * subdivisions)) + 2);
+        const float base[12][3] = {
+            { -1,  t,  0 }, {  1,  t,  0 }, { -1, -t,  0 }, {  1, -t,  0 },
+            {  0, -1,  t }, {  0,  1,  t }, {  0, -1, -t }, {  0,  1, -t },
+            {  t,  0, -1 }, {  t,  0,  1 }, { -t,  0, -1 }, { -t,  0,  1 }
+        };
+        for (unsigned int i = 0; i < 12; i++)
+            positions.push_back(glm::normalize(glm::vec3(base[i][0], base[i][1], base[i][2])));
+        vector<uint16_t> indices = {
+            0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+            1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+            3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+            4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1
+        };
+        for (unsigned int level = 0; level < subdivisions; level++)
+        {
+            // every edge is shared by two triangles, remember its midpoint so it's only created once
+            map<uint32_t, uint16_t> midpoints;
+            vector<uint16_t> next;
+            next.reserve(indices.size() * 4);
+            for (size_t f = 0; f < indices.size(); f += 3)
+            {
+                uint16_t a = indices[f], b = indices[f + 1], c = indices[f + 2];
+                uint16_t ab = midpoint(positions, midpoints, a, b);
+                uint16_t bc = midpoint(positions, midpoints, b, c);
+                uint16_t ca = midpoint(positions, midpoints, c, a);
+                uint16_t triangles[12] = { a, ab, ca,  b, bc, ab,  c, ca, bc,  ab, bc, ca };
+                next.insert(next.end(), triangles, triangles + 12);
+            }
+            indices.swap(next);
+        }
+
+        const float PI = 3.14159265359f;
+        vector<float> vertices(positions.size() * 8);
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            const glm::vec3& p = positions[i];
+            float* v = &vertices[i * 8];
+            v[0] = p.x; v[1] = p.y; v[2] = p.z;
+            v[3] = p.x; v[4] = p.y; v[5] = p.z;
+            v[6] = 0.5f + std::atan2(p.z, p.x) / (2.0f * PI);
+            v[7] = std::acos(p.y) / PI;
+        }
+        upload(primitive, vertices, indices, GL_TRIANGLES);
+    }
+
+    static uint16_t midpoint(vector<glm::vec3>& positions, map<uint32_t, uint16_t>& midpoints, uint16_t a, uint16_t b)
+    {
+        uint32_t key = a < b ? ((uint32_t)a << 16) | b : ((uint32_t)b << 16) | a;
+        map<uint32_t, uint16_t>::iterator it = midpoints.find(key);
+        if (it != midpoints.end())
+            return it->second;
+        uint16_t index = (uint16_t)positions.size();
+        positions.push_back(glm::normalize(positions[a] + positions[b]));
+        midpoints[key] = index;
+        return index;
+    }
+
+    static void buildCube(Primitive& primitive)
+    {
+        // per face: normal, and the two axes spanning it (u x v = normal so the faces wind counter-clockwise)
+        const float faces[6][9] = {
+            {  0,  0, -1,  -1,  0,  0,   0,  1,  0 }, // back
+            {  0,  0,  1,   1,  0,  0,   0,  1,  0 }, // front
+            { -1,  0,  0,   0,  0,  1,   0,  1,  0 }, // left
+            {  1,  0,  0,   0,  0, -1,   0,  1,  0 }, // right
+            {  0, -1,  0,   1,  0,  0,   0,  0,  1 }, // bottom
+            {  0,  1,  0,   1,  0,  0,   0,  0, -1 }  // top
+        };
+        const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+        vector<float> vertices(24 * 8);
+        vector<uint16_t> indices(36);
+        for (unsigned int f = 0; f < 6; f++)
+        {
+            glm::vec3 n(faces[f][0], faces[f][1], faces[f][2]);
+            glm::vec3 u(faces[f][3], faces[f][4], faces[f][5]);
+            glm::vec3 w(faces[f][6], faces[f][7], faces[f][8]);
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                glm::vec3 p = n + u * corners[c][0] + w * corners[c][1];
+                float* v = &vertices[(f * 4 + c) * 8];
+                v[0] = p.x; v[1] = p.y; v[2] = p.z;
+                v[3] = n.x; v[4] = n.y; v[5] = n.z;
+                v[6] = corners[c][0] * 0.5f + 0.5f;
+                v[7] = corners[c][1] * 0.5f + 0.5f;
+            }
+            uint16_t base = (uint16_t)(f * 4);
+            uint16_t quad[6] = { base, (uint16_t)(base + 1), (uint16_t)(base + 2), (uint16_t)(base + 2), (uint16_t)(base + 3), base };
+            std::copy(quad, quad + 6, &indices[f * 6]);
+        }
+        upload(primitive, vertices, indices, GL_TRIANGLES);
+    }
+
+    static void buildPlane(Primitive& primitive, unsigned int X_SEGMENTS, unsigned int Z_SEGMENTS)
+    {
+        vector<float> vertices((X_SEGMENTS + 1) * (Z_SEGMENTS + 1) * 8);
+        float* v = &vertices[0];
+        for (unsigned int z = 0; z <= Z_SEGMENTS; ++z)
+        {
+            for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+            {
+                float u = (float)x / (float)X_SEGMENTS;
+                float w = (float)z / (float)Z_SEGMENTS;
+                v[0] = u * 2.0f - 1.0f; v[1] = 0.0f; v[2] = w * 2.0f - 1.0f;
+                v[3] = 0.0f; v[4] = 1.0f; v[5] = 0.0f;
+                v[6] = u; v[7] = w;
+                v += 8;
+            }
+        }
+        vector<uint16_t> indices(Z_SEGMENTS * (2 * (X_SEGMENTS + 1) + 1) - 1);
+        uint16_t* i = &indices[0];
+        for (unsigned int z = 0; z < Z_SEGMENTS; ++z)
+        {
+            if (z > 0)
+                *i++ = PRIMITIVE_RESTART_INDEX;
+            for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+            {
+                *i++ = (uint16_t)(z * (X_SEGMENTS + 1) + x);
+                *i++ = (uint16_t)((z + 1) * (X_SEGMENTS + 1) + x);
+            }
+        }
+        upload(primitive, vertices, indices, GL_TRIANGLE_STRIP);
+    }
+
+    static void buildQuad(Primitive& primitive)
+    {
+        float quadVertices[] = {
+            // positions        // texture Coords
+            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+        };
+        primitive.mode = GL_TRIANGLE_STRIP;
+        primitive.vertexCount = primitive.indexCount = 4;
+        glGenVertexArrays(1, &primitive.VAO);
+        glGenBuffers(1, &primitive.VBO);
+        glState().bindVertexArray(primitive.VAO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, primitive.VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+        glState().bindVertexArray(0);
+    }
+
+    static void buildCylinder(Primitive& primitive, unsigned int segments)
+    {
+        const float PI = 3.14159265359f;
+        // side: two rings with outward normals, caps: two more rings with up/down normals
+        unsigned int ring = segments + 1;
+        vector<float> vertices(ring * 4 * 8);
+        for (unsigned int s = 0; s <= segments; ++s)
+        {
+            float u = (float)s / (float)segments;
+            float c = std::cos(u * 2.0f * PI), sn = std::sin(u * 2.0f * PI);
+            float side[2][8] = {
+                { c, -1.0f, sn,  c, 0.0f, sn,  u, 0.0f },
+                { c,  1.0f, sn,  c, 0.0f, sn,  u, 1.0f }
+            };
+            float cap[2][8] = {
+                { c, -1.0f, sn,  0.0f, -1.0f, 0.0f,  c * 0.5f + 0.5f, sn * 0.5f + 0.5f },
+                { c,  1.0f, sn,  0.0f,  1.0f, 0.0f,  c * 0.5f + 0.5f, sn * 0.5f + 0.5f }
+            };
+            std::copy(side[0], side[0] + 8, &vertices[(0 * ring + s) * 8]);
+            std::copy(side[1], side[1] + 8, &vertices[(1 * ring + s) * 8]);
+            std::copy(cap[0], cap[0] + 8, &vertices[(2 * ring + s) * 8]);
+            std::copy(cap[1], cap[1] + 8, &vertices[(3 * ring + s) * 8]);
+        }
+        vector<uint16_t> indices;
+        indices.reserve(2 * ring + 2 * segments + 2);
+        for (unsigned int s = 0; s <= segments; ++s)
+        {
+            indices.push_back((uint16_t)s);
+            indices.push_back((uint16_t)(ring + s));
+        }
+        // caps are convex polygons, zig-zagging over the ring (0, 1, n-1, 2, n-2, ...) triangulates them as a strip;
+        // the top cap zig-zags the other way round (0, n-1, 1, ...) so it faces up
+        for (unsigned int capRing = 2; capRing < 4; ++capRing)
+        {
+            indices.push_back(PRIMITIVE_RESTART_INDEX);
+            indices.push_back((uint16_t)(capRing * ring));
+            unsigned int lo = 1, hi = segments - 1;
+            bool fromLow = capRing == 2;
+            while (lo <= hi)
+            {
+                indices.push_back((uint16_t)(capRing * ring + (fromLow ? lo++ : hi--)));
+                fromLow = !fromLow;
+            }
+        }
+        upload(primitive, vertices, indices, GL_TRIANGLE_STRIP);
+    }
+};
+#endif
@@ -0,0 +1,249 @@
+
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "material.h"
+#include "glstate.h"
+
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// passes are the top bits of the sort key, so the queue draws them in this order
+enum RenderPass {
+    PASS_SHADOW = 0,
+    PASS_OPAQUE = 1,
+    PASS_BACKGROUND = 2, // skybox, drawn after the opaque geometry so depth testing rejects most of it
+    PASS_TRANSPARENT = 3
+};
+
+// everything needed to issue one draw call
+struct DrawItem {
+    Shader* shader;
+    const Material* material; // may be null when the shader reads no textures
+    unsigned int VAO;
+    GLenum mode;
+    unsigned int count;         // index count, or vertex count for non-indexed draws
+    GLenum indexType;           // GL_UNSIGNED_INT/GL_UNSIGNED_SHORT, or 0 to draw with glDrawArrays
+    unsigned int instanceCount; // 1 for a plain draw
+    glm::mat4 model;
+    glm::vec4 params;           // free per-draw values (e.g. metallic/roughness) for the setup function
+    // sets the per-draw uniforms, may be null
+    void (*setup)(Shader& shader, const DrawItem& item);
+
+    DrawItem() : shader(0), material(0), VAO(0), mode(GL_TRIANGLES), count(0), indexType(0), instanceCount(1),
+        model(1.0f), params(0.0f), setup(0)
+    {
+    }
+};
+
+// Collects the draws of a frame, each tagged with a 64 bit sort key, radix sorts the keys and then
+// submits the draws through the state cache in that order.
+//
+// key layout, most significant bits first:
+//   opaque/shadow/background: pass(2) | shader(10) | material(12) | mesh(16) | depth(24)
+//   transparent:              pass(2) | inverted depth(24) | shader(10) | material(12) | mesh(16)
+// so opaque draws are grouped by state (fewest program/texture/VAO switches) and front-to-back within
+// the same state (early-z rejects the rest), while transparent draws go back-to-front as blending needs.
+class RenderQueue
+{
+public:
+    // number of draws submitted by the last flush (the state changes sorting saved show up in glState())
+    unsigned int lastItemCount;
+
+    RenderQueue() : lastItemCount(0), view(1.0f), nearPlane(0.1f), farPlane(100.0f)
+    {
+    }
+
+    // starts a new frame: drops last frame's items and sets the camera used for depth sorting
+    void begin(const glm::mat4& viewMatrix, float zNear, float zFar)
+    {
+        items.clear();
+        keys.clear();
+        view = viewMatrix;
+        nearPlane = zNear;
+        farPlane = zFar;
+    }
+
+    // queues a draw, its depth is taken from the translation of its model matrix
+    void submit(RenderPass pass, const DrawItem& item)
+    {
+        submit(pass, item, glm::vec3(item.model[3]));
+    }
+    // queues a draw sorted by the given world space position (e.g. the center of an instanced batch)
+    void submit(RenderPass pass, const DrawItem& item, const glm::vec3& center)
+    {
+        float depth = -(view * glm::vec4(center, 1.0f)).z;
+        SortEntry entry;
+        entry.key = makeKey(pass, item, depth);
+        entry.index = static_cast<uint32_t>(items.size());
+        keys.push_back(entry);
+        items.push_back(item);
+    }
+
+    // sorts the queued draws by key
+    void sort()
+    {
+        radixSort(keys, scratch);
+    }
+
+    // submits every queued draw in sorted order
+    void flush()
+    {
+        lastItemCount = static_cast<unsigned int>(keys.size());
+        flushRange(0, keys.size());
+    }
+    // submits only the draws of one pass, e.g. the shadow pass while the shadow map framebuffer is bound
+    void flush(RenderPass pass)
+    {
+        size_t first = 0;
+        while (first < keys.size() && (keys[first].key >> 62) < (uint64_t)pass)
+            first++;
+        size_t last = first;
+        while (last < keys.size() && (keys[last].key >> 62) == (uint64_t)pass)
+            last++;
+        lastItemCount = static_cast<unsigned int>(last - first);
+        flushRange(first, last);
+    }
+
+    // issues a single draw item, usable outside of the queue as well
+    static void draw(const DrawItem& item)
+    {
+        glState().bindVertexArray(item.VAO);
+        if (item.indexType != 0)
+        {
+            glState().primitiveRestart(item.indexType);
+            if (item.instanceCount > 1)
+                glDrawElementsInstanced(item.mode, item.count, item.indexType, 0, item.instanceCount);
+            else
+                glDrawElements(item.mode, item.count, item.indexType, 0);
+        }
+        else
+        {
+            if (item.instanceCount > 1)
+                glDrawArraysInstanced(item.mode, 0, item.count, item.instanceCount);
+            else
+                glDrawArrays(item.mode, 0, item.count);
+        }
+    }
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    vector<DrawItem> items;
+    vector<SortEntry> keys;
+    vector<SortEntry> scratch;
+    glm::mat4 view;
+    float nearPlane, farPlane;
+
+    uint64_t makeKey(RenderPass pass, const DrawItem& item, float depth) const
+    {
+        // quantize view depth to 24 bits over the camera's depth range
+        float t = (depth - nearPlane) / (farPlane - nearPlane);
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+        uint64_t z = static_cast<uint64_t>(t * 16777215.0f);
+        uint64_t shaderBits = item.shader ? (item.shader->ID & 0x3FF) : 0;
+        uint64_t materialBits = item.material ? (item.material->ID & 0xFFF) : 0;
+        uint64_t meshBits = item.VAO & 0xFFFF;
+        uint64_t key = (uint64_t)pass << 62;
+        if (pass == PASS_TRANSPARENT)
+            key |= ((0xFFFFFFull - z) << 38) | (shaderBits << 28) | (materialBits << 16) | meshBits;
+        else
+            key |= (shaderBits << 52) | (materialBits << 40) | (meshBits << 24) | z;
+        return key;
+    }
+
+    // LSD radix sort on the 64 bit keys, 8 bits per pass. All 8 histograms are built in one sweep,
+    // and passes where every key has the same digit (common for the high bits) are skipped.
+    static void radixSort(vector<SortEntry>& entries, vector<SortEntry>& temp)
+    {
+        size_t n = entries.size();
+        if (n < 2)
+            return;
+        temp.resize(n);
+        uint32_t histograms[8][256] = {};
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t key = entries[i].key;
+            for (unsigned int d = 0; d < 8; d++)
+                histograms[d][(key >> (d * 8)) & 0xFF]++;
+        }
+        SortEntry* src = &entries[0];
+        SortEntry* dst = &temp[0];
+        for (unsigned int d = 0; d < 8; d++)
+        {
+            uint32_t* histogram = histograms[d];
+            if (histogram[(src[0].key >> (d * 8)) & 0xFF] == n)
+                continue;
+            uint32_t offset = 0;
+            for (unsigned int b = 0; b < 256; b++)
+            {
+                uint32_t count = histogram[b];
+                histogram[b] = offset;
+                offset += count;
+            }
+            for (size_t i = 0; i < n; i++)
+                dst[histogram[(src[i].key >> (d * 8)) & 0xFF]++] = src[i];
+            SortEntry* t = src;
+            src = dst;
+            dst = t;
+        }
+        if (src != &entries[0])
+            entries.swap(temp);
+    }
+
+    void flushRange(size_t first, size_t last)
+    {
+        RenderPass currentPass = PASS_SHADOW;
+        for (size_t i = first; i < last; i++)
+        {
+            RenderPass pass = (RenderPass)(keys[i].key >> 62);
+            if (i == first || pass != currentPass)
+            {
+                if (i != first)
+                    endPass(currentPass);
+                beginPass(pass);
+                currentPass = pass;
+            }
+            const DrawItem& item = items[keys[i].index];
+            item.shader->use();
+            // bind() skips itself while the material is still bound, a setup() that rebound units resets that
+            if (item.material)
+                item.material->bind();
+            if (item.setup)
+                item.setup(*item.shader, item);
+            draw(item);
+        }
+        if (last > first)
+            endPass(currentPass);
+    }
+
+    static void beginPass(RenderPass pass)
+    {
+        if (pass == PASS_TRANSPARENT)
+        {
+            glState().enable(GL_BLEND);
+            glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glState().depthMask(GL_FALSE);
+        }
+    }
+
+    static void endPass(RenderPass pass)
+    {
+        if (pass == PASS_TRANSPARENT)
+        {
+            glState().disable(GL_BLEND);
+            glState().depthMask(GL_TRUE);
+        }
+    }
+};
+#endif
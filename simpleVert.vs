@@ -1,7 +1,7 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in mat4 instanceMatrix; // we store the instanced arrays of transformation matrices
+layout (location = 8) in mat4 instanceMatrix; // we store the instanced arrays of transformation matrices (locations 8-11, see instancing.h)
 
 out vec2 TexCoords;
 
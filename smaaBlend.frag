@@ -0,0 +1,36 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// SMAA pass 3: neighbourhood blending. Every pixel gathers its 4 weights (its own r and b, g of the pixel below
+// and a of the one to the right), takes the stronger direction and mixes itself with the neighbour on either side
+// through bilinear filtering, a single fetch per side.
+uniform sampler2D image;        // linear filtered
+uniform sampler2D blendTexture; // the weights of smaaWeights.frag
+uniform vec4 metrics;           // 1 / width, 1 / height, width, height
+
+void main()
+{
+    vec4 a;
+    a.x = textureLod(blendTexture, TexCoords + vec2(metrics.x, 0.0), 0.0).a; // right
+    a.y = textureLod(blendTexture, TexCoords + vec2(0.0, -metrics.y), 0.0).g; // below
+    a.wz = textureLod(blendTexture, TexCoords, 0.0).xz; // above and left
+
+    if (dot(a, vec4(1.0)) < 1e-5)
+    {
+        FragColor = vec4(textureLod(image, TexCoords, 0.0).rgb, 1.0);
+        return;
+    }
+
+    bool horizontal = max(a.x, a.z) > max(a.y, a.w);
+    vec4 blendingOffset = horizontal ? vec4(a.x, 0.0, a.z, 0.0) : vec4(0.0, a.y, 0.0, a.w);
+    vec2 blendingWeight = horizontal ? a.xz : a.yw;
+    blendingWeight /= dot(blendingWeight, vec2(1.0));
+    // right and left, or below and above
+    vec4 blendingCoord = TexCoords.xyxy + blendingOffset * vec4(metrics.x, -metrics.y, -metrics.x, metrics.y);
+
+    vec3 color = blendingWeight.x * textureLod(image, blendingCoord.xy, 0.0).rgb;
+    color += blendingWeight.y * textureLod(image, blendingCoord.zw, 0.0).rgb;
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,44 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// SMAA pass 1: luma edges. r is the edge on the left of the pixel, g the one above it (towards +y). A pixel
+// without edges is discarded, the edges target is cleared to 0 before. An edge only counts if it is not much
+// weaker than the strongest one around it (local contrast adaptation), so the blur follows the dominant edge.
+uniform sampler2D image;
+uniform vec4 metrics;  // 1 / width, 1 / height, width, height
+uniform float threshold;
+
+const float LOCAL_CONTRAST_ADAPTATION = 2.0;
+
+float luma(vec2 uv)
+{
+    return dot(textureLod(image, uv, 0.0).rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+    float L = luma(TexCoords);
+    float Lleft = luma(TexCoords + vec2(-metrics.x, 0.0));
+    float Ltop = luma(TexCoords + vec2(0.0, metrics.y));
+    vec4 delta;
+    delta.xy = abs(L - vec2(Lleft, Ltop));
+    vec2 edges = step(threshold, delta.xy);
+    if (dot(edges, vec2(1.0)) == 0.0)
+        discard;
+
+    float Lright = luma(TexCoords + vec2(metrics.x, 0.0));
+    float Lbottom = luma(TexCoords + vec2(0.0, -metrics.y));
+    delta.zw = abs(L - vec2(Lright, Lbottom));
+    vec2 maxDelta = max(delta.xy, delta.zw);
+
+    float Lleftleft = luma(TexCoords + vec2(-2.0 * metrics.x, 0.0));
+    float Ltoptop = luma(TexCoords + vec2(0.0, 2.0 * metrics.y));
+    delta.zw = abs(vec2(Lleft, Ltop) - vec2(Lleftleft, Ltoptop));
+    maxDelta = max(maxDelta.xy, delta.zw);
+    float finalDelta = max(maxDelta.x, maxDelta.y);
+
+    edges *= step(finalDelta, LOCAL_CONTRAST_ADAPTATION * delta.xy);
+    FragColor = vec4(edges, 0.0, 1.0);
+}
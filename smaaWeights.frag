@@ -0,0 +1,125 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// SMAA pass 2: blending weights. For the edge above the pixel (g) it searches the edge's ends to the left and
+// right, reads the crossing edges at both ends and looks the coverage of the revectorized line up in the area
+// texture: r is how much of the pixel above to blend in here, g how much of this pixel the one above takes. b and
+// a are the same for the edge on the left. Orthogonal patterns only (SMAA 1x without diagonal and corner
+// detection), and +y is up, the reference's offsets flipped vertically.
+//
+// The searches step 2 pixels at a time and let bilinear filtering read 4 edges in one fetch: sampled 0.25 pixels
+// back along the edge and 0.125 across it every combination of the 4 has its own value, which the search
+// texture turns back into how far the edge really went.
+uniform sampler2D edgesTexture;  // linear filtered
+uniform sampler2D areaTexture;   // linear filtered
+uniform sampler2D searchTexture; // read with texelFetch
+uniform vec4 metrics;            // 1 / width, 1 / height, width, height
+uniform int maxSearchSteps;
+
+const float AREA_MAX_DISTANCE = 16.0;
+const float AREA_SIZE = 80.0; // 5 x 5 crossing edge patterns of 16 x 16 distances
+
+float searchLength(vec2 e, float offset)
+{
+    ivec2 texel = ivec2(round(e * 32.0)) + ivec2(int(offset * 66.0), 0);
+    return texelFetch(searchTexture, texel, 0).r;
+}
+
+float searchXLeft(vec2 texcoord, float end)
+{
+    vec2 e = vec2(0.0, 1.0);
+    while (texcoord.x > end && e.g > 0.8281 && e.r == 0.0)
+    {
+        e = textureLod(edgesTexture, texcoord, 0.0).rg;
+        texcoord.x -= 2.0 * metrics.x;
+    }
+    float offset = -(255.0 / 127.0) * searchLength(e, 0.0) + 3.25;
+    return metrics.x * offset + texcoord.x;
+}
+
+float searchXRight(vec2 texcoord, float end)
+{
+    vec2 e = vec2(0.0, 1.0);
+    while (texcoord.x < end && e.g > 0.8281 && e.r == 0.0)
+    {
+        e = textureLod(edgesTexture, texcoord, 0.0).rg;
+        texcoord.x += 2.0 * metrics.x;
+    }
+    float offset = -(255.0 / 127.0) * searchLength(e, 0.5) + 3.25;
+    return -metrics.x * offset + texcoord.x;
+}
+
+float searchYUp(vec2 texcoord, float end)
+{
+    vec2 e = vec2(1.0, 0.0);
+    while (texcoord.y < end && e.r > 0.8281 && e.g == 0.0)
+    {
+        e = textureLod(edgesTexture, texcoord, 0.0).rg;
+        texcoord.y += 2.0 * metrics.y;
+    }
+    float offset = -(255.0 / 127.0) * searchLength(e.gr, 0.0) + 3.25;
+    return -metrics.y * offset + texcoord.y;
+}
+
+float searchYDown(vec2 texcoord, float end)
+{
+    vec2 e = vec2(1.0, 0.0);
+    while (texcoord.y > end && e.r > 0.8281 && e.g == 0.0)
+    {
+        e = textureLod(edgesTexture, texcoord, 0.0).rg;
+        texcoord.y -= 2.0 * metrics.y;
+    }
+    float offset = -(255.0 / 127.0) * searchLength(e.gr, 0.5) + 3.25;
+    return metrics.y * offset + texcoord.y;
+}
+
+// coverage of the pixel for distances (in pixels, square rooted) to the ends and crossing edges e1 and e2
+vec2 area(vec2 distance, float e1, float e2)
+{
+    vec2 texcoord = AREA_MAX_DISTANCE * round(4.0 * vec2(e1, e2)) + distance;
+    return textureLod(areaTexture, (texcoord + 0.5) / AREA_SIZE, 0.0).rg;
+}
+
+void main()
+{
+    vec4 weights = vec4(0.0);
+    vec2 e = textureLod(edgesTexture, TexCoords, 0.0).rg;
+    if (e == vec2(0.0))
+    {
+        FragColor = weights;
+        return;
+    }
+
+    vec2 pixcoord = TexCoords * metrics.zw;
+    vec4 offset0 = TexCoords.xyxy + metrics.xyxy * vec4(-0.25, 0.125, 1.25, 0.125);
+    vec4 offset1 = TexCoords.xyxy + metrics.xyxy * vec4(-0.125, 0.25, -0.125, -1.25);
+    vec4 ends = vec4(offset0.xz, offset1.yw) + vec4(-2.0, 2.0, 2.0, -2.0) * metrics.xxyy * float(maxSearchSteps);
+
+    if (e.g > 0.0) // edge above
+    {
+        vec3 coords;
+        coords.x = searchXLeft(offset0.xy, ends.x);
+        coords.y = offset1.y; // 0.25 pixels up, so the crossing edges above and below read differently
+        float e1 = textureLod(edgesTexture, coords.xy, 0.0).r;
+        coords.z = searchXRight(offset0.zw, ends.y);
+        vec2 d = abs(round(metrics.zz * vec2(coords.x, coords.z) - pixcoord.xx));
+        float e2 = textureLodOffset(edgesTexture, coords.zy, 0.0, ivec2(1, 0)).r;
+        weights.rg = area(sqrt(d), e1, e2);
+    }
+
+    if (e.r > 0.0) // edge on the left
+    {
+        vec3 coords;
+        coords.y = searchYUp(offset1.xy, ends.z);
+        coords.x = offset0.x;
+        float e1 = textureLod(edgesTexture, coords.xy, 0.0).g;
+        coords.z = searchYDown(offset1.zw, ends.w);
+        vec2 d = abs(round(metrics.ww * vec2(coords.y, coords.z) - pixcoord.yy));
+        float e2 = textureLodOffset(edgesTexture, coords.xz, 0.0, ivec2(0, -1)).g;
+        weights.ba = area(sqrt(d), e1, e2);
+    }
+
+    FragColor = weights;
+}
@@ -0,0 +1,365 @@
+#ifndef SOFTOCCLUSION_H
+#define SOFTOCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "workers.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// Low-poly stand-in geometry for occlusion: it has to lie inside what it stands in for, or things
+// that are visible around its edges would be culled.
+struct Occluder {
+    vector<glm::vec3> vertices;
+    vector<uint32_t> indices; // triangle list, counter-clockwise front faces
+
+    // a unit sphere; its flat faces lie inside the round surface
+    static Occluder Sphere(unsigned int segments = 16, unsigned int rings = 8)
+    {
+        const float PI = 3.14159265359f;
+        Occluder occluder;
+        for (unsigned int y = 0; y <= rings; ++y)
+        {
+            for (unsigned int x = 0; x <= segments; ++x)
+            {
+                float xSegment = (float)x / (float)segments;
+                float ySegment = (float)y / (float)rings;
+                occluder.vertices.push_back(glm::vec3(std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI),
+                                                      std::cos(ySegment * PI),
+                                                      std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI)));
+            }
+        }
+        for (unsigned int y = 0; y < rings; ++y)
+        {
+            for (unsigned int x = 0; x < segments; ++x)
+            {
+                uint32_t a = y * (segments + 1) + x;
+                uint32_t b = a + segments + 1;
+                uint32_t quad[6] = { a, a + 1, b, a + 1, b + 1, b };
+                occluder.indices.insert(occluder.indices.end(), quad, quad + 6);
+            }
+        }
+        return occluder;
+    }
+
+    // a box, with its faces pointing inward when it is seen from inside (a room)
+    static Occluder Box(const AABB& box, bool inward = false)
+    {
+        Occluder occluder;
+        for (unsigned int i = 0; i < 8; i++)
+            occluder.vertices.push_back(glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z));
+        static const uint32_t faces[36] = {
+            0, 2, 1, 1, 2, 3, // -z
+            4, 5, 6, 5, 7, 6, // +z
+            0, 4, 2, 2, 4, 6, // -x
+            1, 3, 5, 3, 7, 5, // +x
+            0, 1, 4, 1, 5, 4, // -y
+            2, 6, 3, 3, 6, 7  // +y
+        };
+        for (unsigned int i = 0; i < 36; i += 3)
+        {
+            occluder.indices.push_back(faces[i]);
+            occluder.indices.push_back(faces[i + (inward ? 2 : 1)]);
+            occluder.indices.push_back(faces[i + (inward ? 1 : 2)]);
+        }
+        return occluder;
+    }
+
+    // any vertex type with a Position, e.g. a Mesh's vertices and indices
+    template <typename V>
+    static Occluder FromMesh(const vector<V>& meshVertices, const vector<unsigned int>& meshIndices)
+    {
+        Occluder occluder;
+        for (size_t i = 0; i < meshVertices.size(); i++)
+            occluder.vertices.push_back(meshVertices[i].Position);
+        occluder.indices.assign(meshIndices.begin(), meshIndices.end());
+        return occluder;
+    }
+};
+
+// A small software depth buffer for culling without any GPU readback. Occluders are rasterized into it on
+// the CPU, then the bounds of everything else are tested against it before a single draw is submitted, so
+// it can run while the GPU is still busy with the previous frame, and the results are the same on every
+// machine (the headless --bench-occlusion checks them).
+//
+// The buffer is split in TILE_WIDTH x TILE_HEIGHT tiles. addOccluder() transforms and sets up triangles and
+// sorts them into the tiles they touch; rasterize() then fills the tiles in parallel (a tile belongs to one
+// thread, so there are no races), four pixels at a time with SSE2 edge functions, and keeps the farthest
+// depth of every tile for quick rejects. Depth is window space [0, 1], smaller is nearer.
+class OcclusionBuffer
+{
+public:
+    static const int TILE_WIDTH = 32;
+    static const int TILE_HEIGHT = 8;
+
+    int width, height; // multiples of the tile size
+    // this frame's statistics
+    unsigned int trianglesRasterized;
+    unsigned int trianglesCulled;   // back facing, off screen or crossing the near plane
+    unsigned int occludeesTested;
+    unsigned int occludeesCulled;
+
+    OcclusionBuffer(int bufferWidth = 320, int bufferHeight = 192)
+    {
+        width = (bufferWidth + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH;
+        height = (bufferHeight + TILE_HEIGHT - 1) / TILE_HEIGHT * TILE_HEIGHT;
+        tilesX = width / TILE_WIDTH;
+        tilesY = height / TILE_HEIGHT;
+        depth.resize((size_t)width * height);
+        tileMax.resize((size_t)tilesX * tilesY);
+        bins.resize((size_t)tilesX * tilesY);
+        begin(glm::mat4(1.0f));
+    }
+
+    // starts a frame seen through viewProjection, with nothing occluded
+    void begin(const glm::mat4& viewProjection)
+    {
+        camera = viewProjection;
+        triangles.clear();
+        for (size_t i = 0; i < bins.size(); i++)
+            bins[i].clear();
+        trianglesRasterized = trianglesCulled = occludeesTested = occludeesCulled = 0;
+    }
+
+    void addOccluder(const Occluder& occluder, const glm::mat4& model)
+    {
+        glm::mat4 transform = camera * model;
+        projected.resize(occluder.vertices.size());
+        for (size_t i = 0; i < occluder.vertices.size(); i++)
+            projected[i] = transform * glm::vec4(occluder.vertices[i], 1.0f);
+        for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+            setupTriangle(projected[occluder.indices[i]], projected[occluder.indices[i + 1]], projected[occluder.indices[i + 2]]);
+    }
+
+    // fills the depth buffer with every occluder added since begin()
+    void rasterize(WorkerPool& pool)
+    {
+        pool.parallelFor(bins.size(), [this](size_t first, size_t last) {
+            for (size_t tile = first; tile < last; tile++)
+                rasterizeTile((int)tile);
+        });
+    }
+
+    // false when the world space box is certainly hidden behind the occluders
+    bool visible(const AABB& box)
+    {
+        occludeesTested++;
+        float nearest = 1.0f;
+        glm::vec2 low(FLT_MAX), high(-FLT_MAX);
+        // the corners are the center plus or minus the extents, so one transform and the matrix's columns suffice
+        glm::vec4 center = camera * glm::vec4(box.center(), 1.0f);
+        glm::vec3 extents = box.extents();
+        glm::vec4 dx = camera[0] * extents.x, dy = camera[1] * extents.y, dz = camera[2] * extents.z;
+        for (unsigned int c = 0; c < 8; c++)
+        {
+            glm::vec4 clip = center + (c & 1 ? dx : -dx) + (c & 2 ? dy : -dy) + (c & 4 ? dz : -dz);
+            if (clip.w <= NEAR_W)
+                return true; // crosses the camera plane, can't be bounded on screen
+            glm::vec3 window = toWindow(clip);
+            low = glm::min(low, glm::vec2(window));
+            high = glm::max(high, glm::vec2(window));
+            nearest = std::min(nearest, window.z);
+        }
+        // the pixels whose centers the rectangle covers (clamped first, a corner close to the camera plane
+        // projects arbitrarily far)
+        glm::vec2 limit((float)width + 1.0f, (float)height + 1.0f);
+        low = glm::clamp(low, glm::vec2(-1.0f), limit);
+        high = glm::clamp(high, glm::vec2(-1.0f), limit);
+        int x0 = std::max(0, (int)std::ceil(low.x - 0.5f)), x1 = std::min(width - 1, (int)std::floor(high.x - 0.5f));
+        int y0 = std::max(0, (int)std::ceil(low.y - 0.5f)), y1 = std::min(height - 1, (int)std::floor(high.y - 0.5f));
+        if (x0 > x1 || y0 > y1)
+        {
+            // too small to cover a pixel center (or off screen): keep it unless its neighbourhood is hidden
+            x0 = std::max(0, std::min(width - 1, (int)low.x));
+            y0 = std::max(0, std::min(height - 1, (int)low.y));
+            x1 = std::max(x0, std::min(width - 1, (int)high.x));
+            y1 = std::max(y0, std::min(height - 1, (int)high.y));
+            if (high.x < 0.0f || high.y < 0.0f || low.x > width || low.y > height)
+                return true; // off screen is the frustum test's call
+        }
+        for (int ty = y0 / TILE_HEIGHT; ty <= y1 / TILE_HEIGHT; ty++)
+        {
+            for (int tx = x0 / TILE_WIDTH; tx <= x1 / TILE_WIDTH; tx++)
+            {
+                int tile = ty * tilesX + tx;
+                if (nearest > tileMax[tile])
+                    continue; // everything in this tile is in front of it
+                int px0 = std::max(x0, tx * TILE_WIDTH), px1 = std::min(x1, tx * TILE_WIDTH + TILE_WIDTH - 1);
+                int py0 = std::max(y0, ty * TILE_HEIGHT), py1 = std::min(y1, ty * TILE_HEIGHT + TILE_HEIGHT - 1);
+                for (int y = py0; y <= py1; y++)
+                    for (int x = px0; x <= px1; x++)
+                        if (depth[pixelIndex(x, y)] >= nearest)
+                            return true;
+            }
+        }
+        occludeesCulled++;
+        return false;
+    }
+    bool visible(const BoundingSphere& sphere)
+    {
+        AABB box;
+        box.add(sphere.center - glm::vec3(sphere.radius));
+        box.add(sphere.center + glm::vec3(sphere.radius));
+        return visible(box);
+    }
+
+    // drops the hidden spheres from a list of indices (e.g. what frustum culling kept), returns what's left
+    size_t cullSpheres(const SphereSet& spheres, vector<uint32_t>& indices)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            if (visible(spheres.get(indices[i])))
+                indices[kept++] = indices[i];
+        }
+        indices.resize(kept);
+        return kept;
+    }
+
+    // window space depth at a pixel, 1 where nothing was drawn
+    float depthAt(int x, int y) const
+    {
+        return depth[pixelIndex(x, y)];
+    }
+
+private:
+    static constexpr float NEAR_W = 1e-5f;
+
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3]; // edge i is inside where A * x + B * y + C >= 0
+        float depthA, depthB, depthC;       // depth = A * x + B * y + C
+        int minX, minY, maxX, maxY;         // pixel bounds, inclusive
+    };
+
+    glm::mat4 camera;
+    int tilesX, tilesY;
+    vector<float> depth;          // tile by tile, row by row inside a tile
+    vector<float> tileMax;        // farthest depth in each tile
+    vector<Triangle> triangles;
+    vector<vector<uint32_t>> bins; // triangles touching each tile
+    vector<glm::vec4> projected;
+
+    size_t pixelIndex(int x, int y) const
+    {
+        int tile = (y / TILE_HEIGHT) * tilesX + x / TILE_WIDTH;
+        return (size_t)tile * TILE_WIDTH * TILE_HEIGHT + (y % TILE_HEIGHT) * TILE_WIDTH + x % TILE_WIDTH;
+    }
+
+    static bool behindNear(const glm::vec4& clip)
+    {
+        return clip.w <= NEAR_W || clip.z < -clip.w;
+    }
+
+    glm::vec3 toWindow(const glm::vec4& clip) const
+    {
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+    }
+
+    void setupTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2)
+    {
+        // triangles crossing the near plane are dropped instead of clipped: an occluder that is missing
+        // only culls less, it never hides anything visible. A vertex between the camera and the near plane
+        // (z < -w) has to go too, its depth would come out below 0, nearer than anything the GPU draws.
+        if (behindNear(c0) || behindNear(c1) || behindNear(c2))
+        {
+            trianglesCulled++;
+            return;
+        }
+        glm::vec3 v[3] = { toWindow(c0), toWindow(c1), toWindow(c2) };
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        Triangle t;
+        t.minX = std::max(0, (int)std::floor(std::min(v[0].x, std::min(v[1].x, v[2].x))));
+        t.minY = std::max(0, (int)std::floor(std::min(v[0].y, std::min(v[1].y, v[2].y))));
+        t.maxX = std::min(width - 1, (int)std::ceil(std::max(v[0].x, std::max(v[1].x, v[2].x))));
+        t.maxY = std::min(height - 1, (int)std::ceil(std::max(v[0].y, std::max(v[1].y, v[2].y))));
+        if (area <= 0.0f || t.minX > t.maxX || t.minY > t.maxY)
+        {
+            trianglesCulled++;
+            return;
+        }
+        for (int e = 0; e < 3; e++)
+        {
+            const glm::vec3& a = v[e];
+            const glm::vec3& b = v[(e + 1) % 3];
+            t.edgeA[e] = a.y - b.y;
+            t.edgeB[e] = b.x - a.x;
+            t.edgeC[e] = -(t.edgeA[e] * a.x + t.edgeB[e] * a.y);
+        }
+        // window space depth is linear in x and y
+        t.depthA = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+        t.depthB = ((v[2].z - v[0].z) * (v[1].x - v[0].x) - (v[1].z - v[0].z) * (v[2].x - v[0].x)) / area;
+        t.depthC = v[0].z - t.depthA * v[0].x - t.depthB * v[0].y;
+
+        uint32_t index = (uint32_t)triangles.size();
+        triangles.push_back(t);
+        trianglesRasterized++;
+        for (int ty = t.minY / TILE_HEIGHT; ty <= t.maxY / TILE_HEIGHT; ty++)
+            for (int tx = t.minX / TILE_WIDTH; tx <= t.maxX / TILE_WIDTH; tx++)
+                bins[ty * tilesX + tx].push_back(index);
+    }
+
+    void rasterizeTile(int tile)
+    {
+        float* tileDepth = &depth[(size_t)tile * TILE_WIDTH * TILE_HEIGHT];
+        std::fill(tileDepth, tileDepth + TILE_WIDTH * TILE_HEIGHT, 1.0f);
+        int tileX = (tile % tilesX) * TILE_WIDTH;
+        int tileY = (tile / tilesX) * TILE_HEIGHT;
+        const vector<uint32_t>& bin = bins[tile];
+        for (size_t b = 0; b < bin.size(); b++)
+        {
+            const Triangle& t = triangles[bin[b]];
+            int x0 = std::max(t.minX, tileX) & ~3; // whole groups of four
+            int x1 = std::min(t.maxX, tileX + TILE_WIDTH - 1);
+            int y0 = std::max(t.minY, tileY);
+            int y1 = std::min(t.maxY, tileY + TILE_HEIGHT - 1);
+            for (int y = y0; y <= y1; y++)
+            {
+                float* row = tileDepth + (y - tileY) * TILE_WIDTH - tileX;
+                float py = (float)y + 0.5f;
+#ifdef CULLING_SSE
+                __m128 e0Row = _mm_set1_ps(t.edgeB[0] * py + t.edgeC[0]);
+                __m128 e1Row = _mm_set1_ps(t.edgeB[1] * py + t.edgeC[1]);
+                __m128 e2Row = _mm_set1_ps(t.edgeB[2] * py + t.edgeC[2]);
+                __m128 zRow = _mm_set1_ps(t.depthB * py + t.depthC);
+                __m128 a0 = _mm_set1_ps(t.edgeA[0]), a1 = _mm_set1_ps(t.edgeA[1]), a2 = _mm_set1_ps(t.edgeA[2]);
+                __m128 za = _mm_set1_ps(t.depthA);
+                __m128 zero = _mm_setzero_ps();
+                for (int x = x0; x <= x1; x += 4)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                    __m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), e0Row), zero),
+                                    _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), e1Row), zero),
+                                               _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), e2Row), zero)));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+                    __m128 z = _mm_add_ps(_mm_mul_ps(za, px), zRow);
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(current, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+                }
+#else
+                for (int x = x0; x <= x1; x++)
+                {
+                    float px = (float)x + 0.5f;
+                    if (t.edgeA[0] * px + t.edgeB[0] * py + t.edgeC[0] >= 0.0f &&
+                        t.edgeA[1] * px + t.edgeB[1] * py + t.edgeC[1] >= 0.0f &&
+                        t.edgeA[2] * px + t.edgeB[2] * py + t.edgeC[2] >= 0.0f)
+                        row[x] = std::min(row[x], t.depthA * px + t.depthB * py + t.depthC);
+                }
+#endif
+            }
+        }
+        float farthest = 0.0f;
+        for (int i = 0; i < TILE_WIDTH * TILE_HEIGHT; i++)
+            farthest = std::max(farthest, tileDepth[i]);
+        tileMax[tile] = farthest;
+    }
+};
+#endif
@@ -12,21 +12,59 @@ uniform sampler2D texNoise;
 uniform vec3 samples[64];
 
 //hemisphere parameters
-// parameters (you'd probably want to use them as uniforms to more easily tweak the effect)
-int kernelSize = 64;
-float radius = 0.5;
-float bias = 0.025;
+// parameters, uniforms so they can be tweaked at runtime
+uniform int kernelSize = 64;
+uniform float radius = 0.5;
+uniform float bias = 0.025;
 
 // tile noise texture over screen based on screen dimensions divided by noise size
-const vec2 noiseScale = vec2(800.0/4.0, 600.0/4.0); 
+uniform vec2 noiseScale = vec2(800.0/4.0, 600.0/4.0); 
 
 uniform mat4 projection;
 
+// compact G-buffer (GBuffer in gbuffer.h): the position is rebuilt from the depth buffer with the inverse
+// projection, the normal is octahedral encoded into [0,1]^2
+uniform bool compactGBuffer;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 octahedralDecode(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
+
+vec3 viewPositionFromDepth(vec2 uv)
+{
+    vec4 position = inverseProjection * vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+vec3 gBufferNormal(vec2 uv)
+{
+    vec4 normal = texture(gNormal, uv);
+    return compactGBuffer ? octahedralDecode(normal.xy) : normal.xyz;
+}
+
+// view space position, gPosition holds it in the classic layout
+vec3 gBufferViewPosition(vec2 uv)
+{
+    return compactGBuffer ? viewPositionFromDepth(uv) : texture(gPosition, uv).xyz;
+}
+
 void main()
 {
     // get input for SSAO algorithm
-    vec3 fragPos = texture(gPosition, TexCoords).xyz;
-    vec3 normal = normalize(texture(gNormal, TexCoords).rgb);
+    vec3 fragPos = gBufferViewPosition(TexCoords);
+    vec3 normal = normalize(gBufferNormal(TexCoords));
     vec3 randomVec = normalize(texture(texNoise, TexCoords * noiseScale).xyz);
     // create TBN change-of-basis matrix: from tangent-space to view-space
     vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -47,7 +85,7 @@ void main()
         offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
         
         // get sample depth
-        float sampleDepth = texture(gPosition, offset.xy).z; // get depth value of kernel sample
+        float sampleDepth = gBufferViewPosition(offset.xy).z; // get depth value of kernel sample
         
         // range check & accumulate
         float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
@@ -0,0 +1,216 @@
+
+
+#ifndef SSAO_H
+#define SSAO_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "glstate.h"
+#include "primitives.h"
+#include "gbuffer.h"
+#include "gputimer.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+// the hemisphere sample kernel of ssao.frag: size points in the +z half of the unit sphere, more of them close to
+// the center
+inline vector<glm::vec3> ssaoKernel(unsigned int size, unsigned int seed = 0)
+{
+    std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+    std::default_random_engine generator(seed);
+    vector<glm::vec3> kernel;
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        glm::vec3 sample(randomFloats(generator) * 2.0f - 1.0f, randomFloats(generator) * 2.0f - 1.0f, randomFloats(generator));
+        sample = glm::normalize(sample);
+        sample *= randomFloats(generator);
+        // scale samples s.t. they're more aligned to center of kernel
+        float scale = float(i) / size;
+        sample *= 0.1f + 0.9f * scale * scale;
+        kernel.push_back(sample);
+    }
+    return kernel;
+}
+
+// Screen space ambient occlusion at a fraction of the screen resolution.
+//
+// compute() runs four passes over the G-buffer (either GBuffer layout):
+// 1. ssaoDownsample.frag: view space normal and depth at 1/resolutionDivisor of the screen (RGBA16F),
+// 2. ssaoInterleaved.frag: the hemisphere test of ssao.frag with kernelSize samples, the kernel rotated per pixel
+//    by interleaved gradient noise instead of a tiled noise texture, so it doesn't depend on the screen size,
+// 3. ssaoBilateral.frag twice: a separable 9 tap blur that doesn't mix depths further apart than a few percent,
+// 4. ssaoUpsample.frag: back to full resolution, each pixel weighting its 4 low resolution neighbours by
+//    distance and by how close their depth is to its own, so occlusion doesn't bleed over silhouettes.
+// The result (R8, full resolution) is what ssaoLighting.frag reads as ssao. Kernel size, radius, bias and the
+// resolution divisor can change at any time. With GBUFFER_CLASSIC the position target has to hold view space
+// positions, as ssaoGeometry.frag writes them.
+// With temporal set every frame rotates the kernel differently and takes another kernelSize samples out of a
+// MAX_KERNEL_SIZE one, so a TemporalAccumulation (temporal.h) of the result converges to the full kernel over
+// MAX_KERNEL_SIZE / kernelSize frames.
+class SSAO
+{
+public:
+    static const int MAX_KERNEL_SIZE = 64;
+
+    int kernelSize;
+    float radius;
+    float bias;
+    int resolutionDivisor; // 1, 2 or 4
+    bool temporal;
+    unsigned int frame;    // counts the temporal frames
+    unsigned int result;   // full resolution occlusion
+    int width, height;     // of the screen
+
+    SSAO(int screenWidth, int screenHeight, int divisor = 2, int samples = 16)
+        : kernelSize(samples), radius(0.5f), bias(0.025f), resolutionDivisor(divisor), temporal(false), frame(0), result(0), width(0), height(0),
+          lowWidth(0), lowHeight(0), allocatedDivisor(0), normalDepth(0), kernelUploaded(0),
+          downsampleShader("ssao.vs", "ssaoDownsample.frag"), aoShader("ssao.vs", "ssaoInterleaved.frag"),
+          blurShader("ssao.vs", "ssaoBilateral.frag"), upsampleShader("ssao.vs", "ssaoUpsample.frag")
+    {
+        ao[0] = ao[1] = 0;
+        glGenFramebuffers(1, &FBO);
+        resize(screenWidth, screenHeight);
+    }
+    ~SSAO()
+    {
+        unsigned int textures[4] = { normalDepth, ao[0], ao[1], result };
+        glDeleteTextures(4, textures);
+        glDeleteFramebuffers(1, &FBO);
+        glState().invalidate(); // the targets may still be bound
+    }
+
+    // reallocates the targets for a new screen size (or resolution divisor)
+    void resize(int screenWidth, int screenHeight)
+    {
+        resolutionDivisor = std::max(1, std::min(resolutionDivisor, 4));
+        if (screenWidth == width && screenHeight == height && resolutionDivisor == allocatedDivisor)
+            return;
+        width = std::max(1, screenWidth);
+        height = std::max(1, screenHeight);
+        allocatedDivisor = resolutionDivisor;
+        lowWidth = std::max(1, (width + resolutionDivisor - 1) / resolutionDivisor);
+        lowHeight = std::max(1, (height + resolutionDivisor - 1) / resolutionDivisor);
+        if (result)
+        {
+            unsigned int textures[4] = { normalDepth, ao[0], ao[1], result };
+            glDeleteTextures(4, textures);
+            glState().invalidate(); // some of them may still be bound
+        }
+        normalDepth = createTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, lowWidth, lowHeight, GL_NEAREST);
+        ao[0] = createTarget(GL_R8, GL_RED, GL_UNSIGNED_BYTE, lowWidth, lowHeight, GL_NEAREST);
+        ao[1] = createTarget(GL_R8, GL_RED, GL_UNSIGNED_BYTE, lowWidth, lowHeight, GL_NEAREST);
+        result = createTarget(GL_R8, GL_RED, GL_UNSIGNED_BYTE, width, height, GL_LINEAR);
+    }
+
+    // computes the occlusion of the G-buffer's contents, projection and view as in its geometry pass. Uses its own
+    // framebuffer and viewport, so rebind yours afterwards. With a timer every pass is timed as "ssao <pass>".
+    void compute(const GBuffer& gBuffer, const glm::mat4& projection, const glm::mat4& view, GpuTimer* timer = 0)
+    {
+        resize(width, height);
+        kernelSize = std::max(1, std::min(kernelSize, (int)MAX_KERNEL_SIZE));
+        glState().disable(GL_DEPTH_TEST);
+        glState().disable(GL_BLEND);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        // 1. normal and depth at the reduced resolution
+        GpuTimer::mark(timer, "ssao downsample", true);
+        gBuffer.bind(downsampleShader, projection, view);
+        downsampleShader.setInt("divisor", resolutionDivisor);
+        draw(normalDepth, lowWidth, lowHeight);
+        GpuTimer::mark(timer, "ssao downsample", false);
+
+        // 2. occlusion
+        GpuTimer::mark(timer, "ssao occlusion", true);
+        aoShader.use();
+        // temporal: an interleaved subset of the full kernel, so every frame's samples span all distances
+        int uploadSize = temporal ? (int)MAX_KERNEL_SIZE : kernelSize;
+        int kernelStride = temporal ? std::max(1, (int)MAX_KERNEL_SIZE / kernelSize) : 1;
+        if (kernelUploaded != uploadSize)
+        {
+            vector<glm::vec3> kernel = ssaoKernel(uploadSize);
+            for (int i = 0; i < uploadSize; ++i)
+                aoShader.setVec3("samples[" + std::to_string(i) + "]", kernel[i]);
+            kernelUploaded = uploadSize;
+        }
+        aoShader.setInt("kernelStride", kernelStride);
+        aoShader.setInt("kernelOffset", temporal ? (int)(frame % kernelStride) : 0);
+        aoShader.setFloat("noiseOffset", temporal ? 5.588238f * (frame % 64) : 0.0f);
+        if (temporal)
+            frame++;
+        aoShader.setInt("normalDepth", 0);
+        aoShader.setInt("kernelSize", kernelSize);
+        aoShader.setFloat("radius", radius);
+        aoShader.setFloat("bias", bias);
+        aoShader.setMat4("projection", projection);
+        aoShader.setVec2("viewScale", 1.0f / projection[0][0], 1.0f / projection[1][1]);
+        glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, normalDepth);
+        draw(ao[0], lowWidth, lowHeight);
+        GpuTimer::mark(timer, "ssao occlusion", false);
+
+        // 3. separable bilateral blur, ao[0] -> ao[1] -> ao[0]
+        GpuTimer::mark(timer, "ssao blur", true);
+        blurShader.use();
+        blurShader.setInt("aoInput", 0);
+        blurShader.setInt("normalDepth", 1);
+        glState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, normalDepth);
+        for (int pass = 0; pass < 2; pass++)
+        {
+            blurShader.setVec2("direction", pass == 0 ? 1.0f : 0.0f, pass == 0 ? 0.0f : 1.0f);
+            glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, ao[pass]);
+            draw(ao[1 - pass], lowWidth, lowHeight);
+        }
+        GpuTimer::mark(timer, "ssao blur", false);
+
+        // 4. joint bilateral upsample to the full resolution
+        GpuTimer::mark(timer, "ssao upsample", true);
+        gBuffer.bind(upsampleShader, projection, view);
+        upsampleShader.setInt("aoInput", 3);
+        upsampleShader.setInt("normalDepth", 4);
+        upsampleShader.setInt("divisor", resolutionDivisor);
+        glState().bindTexture(GL_TEXTURE3, GL_TEXTURE_2D, ao[0]);
+        glState().bindTexture(GL_TEXTURE4, GL_TEXTURE_2D, normalDepth);
+        draw(result, width, height);
+        GpuTimer::mark(timer, "ssao upsample", false);
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState().enable(GL_DEPTH_TEST);
+    }
+
+private:
+    int lowWidth, lowHeight;
+    int allocatedDivisor;
+    unsigned int FBO;
+    unsigned int normalDepth;
+    unsigned int ao[2];
+    int kernelUploaded;
+    Shader downsampleShader, aoShader, blurShader, upsampleShader;
+
+    void draw(unsigned int target, int targetWidth, int targetHeight)
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+        glState().viewport(0, 0, targetWidth, targetHeight);
+        Primitives::Quad().draw();
+    }
+
+    static unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type, int targetWidth, int targetHeight, GLint filter)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState().bindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, targetWidth, targetHeight, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+};
+#endif
@@ -0,0 +1,34 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D aoInput;
+uniform sampler2D normalDepth; // ssaoDownsample.frag: view space normal, view space z
+uniform vec2 direction;        // (1, 0) for the horizontal pass, (0, 1) for the vertical one
+
+// 9 tap gaussian, center and one side
+const float weights[5] = float[](0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
+// a neighbour's weight drops to 0 when its depth differs by 1 / DEPTH_SHARPNESS of the pixel's depth
+const float DEPTH_SHARPNESS = 20.0;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(aoInput, 0) - 1;
+    float depth = texelFetch(normalDepth, pixel, 0).w;
+    float result = texelFetch(aoInput, pixel, 0).r * weights[0];
+    float total = weights[0];
+    for (int i = 1; i < 5; ++i)
+    {
+        for (int side = -1; side <= 1; side += 2)
+        {
+            ivec2 neighbour = clamp(pixel + ivec2(direction) * i * side, ivec2(0), last);
+            float neighbourDepth = texelFetch(normalDepth, neighbour, 0).w;
+            float weight = weights[i] * max(0.0, 1.0 - abs(neighbourDepth - depth) * DEPTH_SHARPNESS / max(abs(depth), 0.001));
+            result += texelFetch(aoInput, neighbour, 0).r * weight;
+            total += weight;
+        }
+    }
+    FragColor = result / total;
+}
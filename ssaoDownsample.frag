@@ -0,0 +1,63 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+
+uniform int divisor; // full resolution pixels per reduced resolution pixel, in x and y
+
+// compact G-buffer (GBuffer in gbuffer.h): the position is rebuilt from the depth buffer with the inverse
+// projection, the normal is octahedral encoded into [0,1]^2
+uniform bool compactGBuffer;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 octahedralDecode(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
+
+vec3 viewPositionFromDepth(vec2 uv)
+{
+    vec4 position = inverseProjection * vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+vec3 gBufferNormal(vec2 uv)
+{
+    vec4 normal = texture(gNormal, uv);
+    return compactGBuffer ? octahedralDecode(normal.xy) : normal.xyz;
+}
+
+// view space position, gPosition holds it in the classic layout
+vec3 gBufferViewPosition(vec2 uv)
+{
+    return compactGBuffer ? viewPositionFromDepth(uv) : texture(gPosition, uv).xyz;
+}
+
+void main()
+{
+    // one full resolution pixel of the block stands for it (point sampling, the upsample pass relies on it)
+    ivec2 pixel = ivec2(gl_FragCoord.xy) * divisor + divisor / 2;
+    vec2 uv = (vec2(pixel) + 0.5) / vec2(textureSize(gNormal, 0));
+    // the compact layout rebuilds the background at the far plane, mark it as nothing drawn like the classic
+    // layout's cleared positions so ssaoInterleaved.frag skips it
+    if (compactGBuffer && texture(gDepth, uv).r >= 1.0)
+    {
+        FragColor = vec4(0.0, 0.0, 1.0, 0.0);
+        return;
+    }
+    // view space normal and depth (negative, 0 where nothing was drawn)
+    FragColor = vec4(normalize(gBufferNormal(uv)), gBufferViewPosition(uv).z);
+}
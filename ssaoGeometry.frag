@@ -4,10 +4,28 @@
 layout (location = 0) out vec3 gPosition;
 layout (location = 1) out vec3 gNormal;
 layout (location = 2) out vec3 gAlbedo;
+layout (location = 3) out vec2 gVelocity;
 
 in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
+in vec4 CurrentClip;
+in vec4 PreviousClip;
+
+// compact G-buffer (GBuffer in gbuffer.h): no position, the normal octahedral encoded into [0,1]^2
+uniform bool compactGBuffer;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 octahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return e * 0.5 + 0.5;
+}
 
 void main()
 {    
@@ -15,7 +33,11 @@ void main()
     gPosition = FragPos;
     // also store the per-fragment normals into the gbuffer
     gNormal = normalize(Normal);
+    if (compactGBuffer)
+        gNormal = vec3(octahedralEncode(gNormal), 0.0);
     // and the diffuse per-fragment color
     gAlbedo.rgb = vec3(0.95);
+    // how far this point moved on screen since the last frame, in texture coordinates
+    gVelocity = (CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5;
 }
 
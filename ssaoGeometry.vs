@@ -8,6 +8,8 @@ layout (location = 2) in vec2 aTexCoords;
 out vec3 FragPos;
 out vec2 TexCoords;
 out vec3 Normal;
+out vec4 CurrentClip;
+out vec4 PreviousClip;
 
 uniform bool invertedNormals;
 
@@ -15,6 +17,13 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// velocity (GBuffer with a velocity target): this and the last frame's view projection without jitter, and the
+// last frame's model matrix of objects that moved
+uniform mat4 currentViewProjection;
+uniform mat4 previousViewProjection;
+uniform mat4 previousModel;
+uniform bool movingObject;
+
 void main()
 {
     vec4 viewPos = view * model * vec4(aPos, 1.0);
@@ -24,6 +33,10 @@ void main()
     mat3 normalMatrix = transpose(inverse(mat3(view * model)));
     Normal = normalMatrix * (invertedNormals ? -aNormal : aNormal);
     
+    vec4 worldPos = model * vec4(aPos, 1.0);
+    CurrentClip = currentViewProjection * worldPos;
+    PreviousClip = previousViewProjection * (movingObject ? previousModel : model) * vec4(aPos, 1.0);
+
     gl_Position = projection * viewPos;
 }
 
@@ -0,0 +1,66 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D normalDepth; // ssaoDownsample.frag: view space normal, view space z
+
+uniform vec3 samples[64];
+uniform int kernelSize;
+// temporal accumulation (SSAO::temporal): every frame uses samples kernelOffset, + kernelStride, ... of the
+// kernel and moves the noise by noiseOffset pixels
+uniform int kernelStride;
+uniform int kernelOffset;
+uniform float noiseOffset;
+uniform float radius;
+uniform float bias;
+
+uniform mat4 projection;
+uniform vec2 viewScale; // view space x and y per unit of ndc at z = -1: 1 / projection[0][0], 1 / projection[1][1]
+
+// noise that differs between neighbouring pixels but has no low frequencies (Jimenez 2014), so the
+// bilateral blur afterwards removes it well
+float interleavedGradientNoise(vec2 pixel)
+{
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+void main()
+{
+    vec4 center = texelFetch(normalDepth, ivec2(gl_FragCoord.xy), 0);
+    if (center.w >= 0.0)
+    {
+        FragColor = 1.0; // nothing drawn here
+        return;
+    }
+    vec3 fragPos = vec3((TexCoords * 2.0 - 1.0) * viewScale * -center.w, center.w);
+    vec3 normal = center.xyz;
+    // rotate the kernel around the normal by a per pixel angle
+    float angle = 6.2831853 * interleavedGradientNoise(gl_FragCoord.xy + noiseOffset);
+    vec3 randomVec = vec3(cos(angle), sin(angle), 0.0);
+    // create TBN change-of-basis matrix: from tangent-space to view-space
+    vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+    vec3 bitangent = cross(normal, tangent);
+    mat3 TBN = mat3(tangent, bitangent, normal);
+    // iterate over the sample kernel and calculate occlusion factor
+    float occlusion = 0.0;
+    for(int i = 0; i < kernelSize; ++i)
+    {
+        // get sample position
+        vec3 samplePos = fragPos + TBN * samples[i * kernelStride + kernelOffset] * radius;
+
+        // project sample position (to sample texture) (to get position on screen/texture)
+        vec4 offset = projection * vec4(samplePos, 1.0);
+        offset.xy = offset.xy / offset.w * 0.5 + 0.5;
+
+        // get sample depth, nothing drawn there doesn't occlude
+        float sampleDepth = texture(normalDepth, offset.xy).w;
+        if (sampleDepth >= 0.0)
+            continue;
+
+        // range check & accumulate
+        float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
+        occlusion += (sampleDepth >= samplePos.z + bias ? 1.0 : 0.0) * rangeCheck;
+    }
+    FragColor = 1.0 - (occlusion / float(kernelSize));
+}
@@ -7,7 +7,7 @@ in vec2 TexCoords;
 
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
-uniform sampler2D gAlbedo;
+uniform sampler2D gAlbedoSpec;
 uniform sampler2D ssao;
 
 struct Light {
@@ -19,12 +19,50 @@ struct Light {
 };
 uniform Light light;
 
+// compact G-buffer (GBuffer in gbuffer.h): the position is rebuilt from the depth buffer with the inverse
+// projection, the normal is octahedral encoded into [0,1]^2
+uniform bool compactGBuffer;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 octahedralDecode(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
+
+vec3 viewPositionFromDepth(vec2 uv)
+{
+    vec4 position = inverseProjection * vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+vec3 gBufferNormal(vec2 uv)
+{
+    vec4 normal = texture(gNormal, uv);
+    return compactGBuffer ? octahedralDecode(normal.xy) : normal.xyz;
+}
+
+// view space position, gPosition holds it in the classic layout
+vec3 gBufferViewPosition(vec2 uv)
+{
+    return compactGBuffer ? viewPositionFromDepth(uv) : texture(gPosition, uv).xyz;
+}
+
 void main()
 {             
     // retrieve data from gbuffer
-    vec3 FragPos = texture(gPosition, TexCoords).rgb;
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
-    vec3 Diffuse = texture(gAlbedo, TexCoords).rgb;
+    vec3 FragPos = gBufferViewPosition(TexCoords);
+    vec3 Normal = gBufferNormal(TexCoords);
+    vec3 Diffuse = texture(gAlbedoSpec, TexCoords).rgb;
     float AmbientOcclusion = texture(ssao, TexCoords).r;
     
     // then calculate lighting as usual
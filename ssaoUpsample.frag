@@ -0,0 +1,73 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D aoInput;     // blurred occlusion at the reduced resolution
+uniform sampler2D normalDepth; // ssaoDownsample.frag: view space normal, view space z
+
+uniform int divisor; // full resolution pixels per reduced resolution pixel, in x and y
+
+// compact G-buffer (GBuffer in gbuffer.h): the position is rebuilt from the depth buffer with the inverse
+// projection, the normal is octahedral encoded into [0,1]^2
+uniform bool compactGBuffer;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 octahedralDecode(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
+
+vec3 viewPositionFromDepth(vec2 uv)
+{
+    vec4 position = inverseProjection * vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+vec3 gBufferNormal(vec2 uv)
+{
+    vec4 normal = texture(gNormal, uv);
+    return compactGBuffer ? octahedralDecode(normal.xy) : normal.xyz;
+}
+
+// view space position, gPosition holds it in the classic layout
+vec3 gBufferViewPosition(vec2 uv)
+{
+    return compactGBuffer ? viewPositionFromDepth(uv) : texture(gPosition, uv).xyz;
+}
+
+void main()
+{
+    float depth = gBufferViewPosition(TexCoords).z;
+    // where this pixel lies between the reduced resolution pixels (each stands for the pixel ssaoDownsample.frag took)
+    vec2 position = (gl_FragCoord.xy - 0.5 - float(divisor / 2)) / float(divisor);
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+    ivec2 last = textureSize(aoInput, 0) - 1;
+    float result = 0.0;
+    float total = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 corner = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + corner, ivec2(0), last);
+        // bilinear weight, times how well the depth matches
+        vec2 bilinear = mix(1.0 - f, f, vec2(corner));
+        float neighbourDepth = texelFetch(normalDepth, texel, 0).w;
+        float weight = bilinear.x * bilinear.y / (0.001 + abs(neighbourDepth - depth) / max(abs(depth), 0.001));
+        result += texelFetch(aoInput, texel, 0).r * weight;
+        total += weight;
+    }
+    FragColor = total > 0.0 ? result / total : texelFetch(aoInput, clamp(ivec2(position + 0.5), ivec2(0), last), 0).r;
+}
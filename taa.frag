@@ -0,0 +1,102 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// Temporal anti-aliasing resolve: this frame (drawn with a sub-pixel jittered projection) blended into the
+// reprojected history. Before blending the history is clipped towards the 3x3 neighbourhood of the new frame
+// (mean +- 1.25 standard deviations, in YCoCg), so what the new frame can't have been - ghosts of moved or
+// disoccluded surfaces - is pulled back to something it could.
+// The scene may be smaller than the history (DynamicResolution, dynamicresolution.h): then every pixel takes the
+// scene sample whose jittered position lies closest, weighted down the further off it is, and the history
+// gathers the full resolution over the jitter sequence - temporal upsampling.
+uniform sampler2D scene;    // HDR, this frame
+uniform sampler2D history;  // the last result, linear filtered
+uniform sampler2D velocity; // the G-buffer's: where a pixel was is TexCoords - velocity
+uniform sampler2D depth;    // the G-buffer's
+uniform float blend;        // weight of the new frame
+uniform bool historyValid;
+uniform vec2 jitter;        // Camera::GetJitter() of this frame, in scene pixels; only read when upsampling
+
+vec3 toYCoCg(vec3 color)
+{
+    return vec3(dot(color, vec3(0.25, 0.5, 0.25)), dot(color, vec3(0.5, 0.0, -0.5)), dot(color, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 fromYCoCg(vec3 color)
+{
+    return vec3(color.x + color.y - color.z, color.x + color.z, color.x - color.y - color.z);
+}
+
+// pulls color along the line to the box's center until it lies inside the box
+vec3 clipToBox(vec3 color, vec3 boxMin, vec3 boxMax)
+{
+    vec3 center = 0.5 * (boxMax + boxMin);
+    vec3 extent = 0.5 * (boxMax - boxMin) + 1e-4;
+    vec3 offset = color - center;
+    vec3 units = abs(offset / extent);
+    float largest = max(units.x, max(units.y, units.z));
+    return largest > 1.0 ? center + offset / largest : color;
+}
+
+void main()
+{
+    ivec2 size = textureSize(scene, 0);
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float sampleWeight = 1.0;
+    if (size != textureSize(history, 0))
+    {
+        // the jittered projection moves what pixel p shows by +jitter, so its sample lies at p + 0.5 - jitter
+        vec2 scenePosition = TexCoords * vec2(size);
+        pixel = clamp(ivec2(floor(scenePosition + jitter)), ivec2(0), size - 1);
+        vec2 offset = (scenePosition - (vec2(pixel) + 0.5 - jitter)) * vec2(textureSize(history, 0)) / vec2(size);
+        sampleWeight = exp(-2.29 * dot(offset, offset)); // a Gaussian fit of Blackman-Harris, in target pixels
+    }
+    vec3 current = texelFetch(scene, pixel, 0).rgb;
+    if (!historyValid)
+    {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+
+    // neighbourhood statistics, and the velocity of the closest neighbour so the edges of a moving object move
+    // with it rather than with the background
+    vec3 moment1 = vec3(0.0), moment2 = vec3(0.0);
+    float closestDepth = 1.0;
+    ivec2 closest = pixel;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            ivec2 neighbour = clamp(pixel + ivec2(x, y), ivec2(0), size - 1);
+            vec3 color = toYCoCg(texelFetch(scene, neighbour, 0).rgb);
+            moment1 += color;
+            moment2 += color * color;
+            float neighbourDepth = texelFetch(depth, neighbour, 0).r;
+            if (neighbourDepth < closestDepth)
+            {
+                closestDepth = neighbourDepth;
+                closest = neighbour;
+            }
+        }
+    }
+    vec2 previousUV = TexCoords - texelFetch(velocity, closest, 0).xy;
+    if (any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0))))
+    {
+        FragColor = vec4(current, 1.0); // came in from off screen
+        return;
+    }
+
+    vec3 mean = moment1 / 9.0;
+    vec3 deviation = sqrt(max(moment2 / 9.0 - mean * mean, 0.0));
+    vec3 boxMin = mean - 1.25 * deviation;
+    vec3 boxMax = mean + 1.25 * deviation;
+    vec3 previous = clipToBox(toYCoCg(textureLod(history, previousUV, 0.0).rgb), boxMin, boxMax);
+
+    // weighted by inverse luma, so single very bright samples don't make the result flicker
+    vec3 color = toYCoCg(current);
+    float currentWeight = blend * sampleWeight / (1.0 + color.x);
+    float previousWeight = (1.0 - blend) / (1.0 + previous.x);
+    color = (color * currentWeight + previous * previousWeight) / (currentWeight + previousWeight);
+    FragColor = vec4(max(fromYCoCg(color), 0.0), 1.0);
+}
@@ -0,0 +1,243 @@
+
+
+#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "glstate.h"
+#include "primitives.h"
+#include "gputimer.h"
+
+#include <algorithm>
+using namespace std;
+
+// Temporal reprojection: carrying last frame's results over to this one.
+//
+// Every pass here reprojects the same way. The G-buffer's velocity target (GBuffer with velocityTarget, written
+// from this and the last frame's unjittered view projection, see GBuffer::setMotion) says where each pixel was
+// last frame: at TexCoords - velocity. What was there may have been a different surface (disocclusion), so
+// each pass checks: TemporalAA clips the history to the new frame's neighbourhood colors, TemporalAccumulation
+// compares view depths. Both ping-pong between two history targets and start over after resize() or reset()
+// (call that on camera cuts).
+//
+// A frame with both:
+//   camera.Jitter = true;
+//   glm::mat4 jittered = camera.GetJitteredProjection(projection, w, h);
+//   gBuffer.setMotion(geometryShader, projection * view, previousViewProjection); // draw with jittered
+//   ssao.temporal = true; ssao.kernelSize = 8; ssao.compute(gBuffer, jittered, view);
+//   aoHistory.apply(ssao.result, gBuffer.velocity, gBuffer.depth, jittered); // lighting reads aoHistory.result
+//   ... lighting into hdrScene ...
+//   taa.apply(hdrScene, gBuffer.velocity, gBuffer.depth);                    // post-process taa.result
+//   previousViewProjection = projection * view; camera.NextJitter();
+
+// Temporal anti-aliasing of the HDR scene, drawn with Camera::GetJitteredProjection: every frame samples a
+// different sub-pixel position and the history averages them, supersampling spread over frames (and the noise
+// of effects that change their samples every frame, like SSAO::temporal or the shadowSamples of
+// camShader2.frag, converges with it). taa.frag does the resolve. The scene may also be smaller than the
+// history, which then upsamples it: set jitter to the frame's Camera::GetJitter() for that.
+class TemporalAA
+{
+public:
+    float blend;         // weight of the new frame; 0.1 averages about the last 10
+    glm::vec2 jitter;    // Camera::GetJitter() the scene was drawn with, needed when it is smaller than the history
+    unsigned int result; // the anti-aliased HDR image (RGBA16F, linear filtered) until the next apply()
+    int width, height;
+
+    TemporalAA(int screenWidth, int screenHeight)
+        : blend(0.1f), jitter(0.0f), result(0), width(0), height(0), current(0), historyValid(false), shader("blur.vs", "taa.frag")
+    {
+        history[0] = history[1] = 0;
+        glGenFramebuffers(1, &FBO);
+        shader.use();
+        shader.setInt("scene", 0);
+        shader.setInt("history", 1);
+        shader.setInt("velocity", 2);
+        shader.setInt("depth", 3);
+        resize(screenWidth, screenHeight);
+    }
+
+    // reallocates the history for a new screen size, which starts it over
+    void resize(int screenWidth, int screenHeight)
+    {
+        if (screenWidth == width && screenHeight == height && history[0])
+            return;
+        width = std::max(1, screenWidth);
+        height = std::max(1, screenHeight);
+        if (history[0])
+        {
+            glDeleteTextures(2, history);
+            glState().invalidate(); // they may still be bound
+        }
+        for (int i = 0; i < 2; i++)
+            history[i] = createHistoryTarget(GL_RGBA16F, GL_RGBA, width, height, GL_LINEAR);
+        result = history[current];
+        historyValid = false;
+    }
+
+    // forgets the history, e.g. after a camera cut
+    void reset()
+    {
+        historyValid = false;
+    }
+
+    // blends sceneTexture (HDR, at most screen sized) into the history; velocity and depth are the G-buffer's, of
+    // the scene's size. Uses its own framebuffer and viewport. With a timer the pass is timed as "taa".
+    void apply(unsigned int sceneTexture, unsigned int velocityTexture, unsigned int depthTexture, GpuTimer* timer = 0)
+    {
+        if (timer)
+            timer->begin("taa");
+        int next = 1 - current;
+        glState().disable(GL_DEPTH_TEST);
+        glState().disable(GL_BLEND);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, history[next], 0);
+        glState().viewport(0, 0, width, height);
+        shader.use();
+        shader.setFloat("blend", blend);
+        shader.setBool("historyValid", historyValid);
+        shader.setVec2("jitter", jitter);
+        glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, sceneTexture);
+        glState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, history[current]);
+        glState().bindTexture(GL_TEXTURE2, GL_TEXTURE_2D, velocityTexture);
+        glState().bindTexture(GL_TEXTURE3, GL_TEXTURE_2D, depthTexture);
+        Primitives::Quad().draw();
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState().enable(GL_DEPTH_TEST);
+        current = next;
+        result = history[current];
+        historyValid = true;
+        if (timer)
+            timer->end("taa");
+    }
+
+    static unsigned int createHistoryTarget(GLenum internalFormat, GLenum format, int targetWidth, int targetHeight, GLint filter)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState().bindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, targetWidth, targetHeight, 0, format, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+private:
+    unsigned int FBO;
+    unsigned int history[2];
+    int current;
+    bool historyValid;
+    Shader shader;
+};
+
+// Temporal accumulation of any noisy screen space signal: a pass takes fewer samples per frame, varies them
+// between frames and this averages the frames (temporalAccumulate.frag). The average gives every new frame a
+// weight of 1 / frames, so it converges like a plain average until maxFrames, then keeps following changes at
+// that rate. Where the history's view depth is more than depthTolerance off (relative) it was a different
+// surface, and the average starts over from this frame.
+class TemporalAccumulation
+{
+public:
+    float maxFrames;
+    float depthTolerance;
+    unsigned int result; // RGBA16F: the average in rgb, the frames it holds in a; linear filtered
+    int width, height;
+
+    TemporalAccumulation(int screenWidth, int screenHeight)
+        : maxFrames(16.0f), depthTolerance(0.05f), result(0), width(0), height(0), current(0), historyValid(false),
+          shader("blur.vs", "temporalAccumulate.frag")
+    {
+        history[0] = history[1] = 0;
+        historyDepth[0] = historyDepth[1] = 0;
+        glGenFramebuffers(1, &FBO);
+        shader.use();
+        shader.setInt("current", 0);
+        shader.setInt("history", 1);
+        shader.setInt("historyDepth", 2);
+        shader.setInt("velocity", 3);
+        shader.setInt("depth", 4);
+        resize(screenWidth, screenHeight);
+    }
+
+    // reallocates the history for a new screen size, which starts it over
+    void resize(int screenWidth, int screenHeight)
+    {
+        if (screenWidth == width && screenHeight == height && history[0])
+            return;
+        width = std::max(1, screenWidth);
+        height = std::max(1, screenHeight);
+        if (history[0])
+        {
+            glDeleteTextures(2, history);
+            glDeleteTextures(2, historyDepth);
+            glState().invalidate(); // they may still be bound
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            history[i] = TemporalAA::createHistoryTarget(GL_RGBA16F, GL_RGBA, width, height, GL_LINEAR);
+            historyDepth[i] = TemporalAA::createHistoryTarget(GL_R32F, GL_RED, width, height, GL_NEAREST);
+        }
+        result = history[current];
+        historyValid = false;
+    }
+
+    // forgets the history, e.g. after a camera cut
+    void reset()
+    {
+        historyValid = false;
+    }
+
+    // adds this frame's signal (any size, read linearly filtered) to the average. velocity and depth are the
+    // G-buffer's, projection the one it was drawn with. Uses its own framebuffer and viewport. With a timer the
+    // pass is timed as "temporal accumulation".
+    void apply(unsigned int signalTexture, unsigned int velocityTexture, unsigned int depthTexture, const glm::mat4& projection,
+               GpuTimer* timer = 0)
+    {
+        if (timer)
+            timer->begin("temporal accumulation");
+        int next = 1 - current;
+        glState().disable(GL_DEPTH_TEST);
+        glState().disable(GL_BLEND);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, history[next], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, historyDepth[next], 0);
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        glState().viewport(0, 0, width, height);
+        shader.use();
+        shader.setMat4("inverseProjection", glm::inverse(projection));
+        shader.setFloat("maxFrames", std::max(1.0f, maxFrames));
+        shader.setFloat("depthTolerance", depthTolerance);
+        shader.setBool("historyValid", historyValid);
+        glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, signalTexture);
+        glState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, history[current]);
+        glState().bindTexture(GL_TEXTURE2, GL_TEXTURE_2D, historyDepth[current]);
+        glState().bindTexture(GL_TEXTURE3, GL_TEXTURE_2D, velocityTexture);
+        glState().bindTexture(GL_TEXTURE4, GL_TEXTURE_2D, depthTexture);
+        Primitives::Quad().draw();
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, 0, 0);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState().enable(GL_DEPTH_TEST);
+        current = next;
+        result = history[current];
+        historyValid = true;
+        if (timer)
+            timer->end("temporal accumulation");
+    }
+
+private:
+    unsigned int FBO;
+    unsigned int history[2];
+    unsigned int historyDepth[2];
+    int current;
+    bool historyValid;
+    Shader shader;
+};
+#endif
@@ -0,0 +1,52 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out float ViewDepth;
+
+in vec2 TexCoords;
+
+// Temporal accumulation of a noisy screen space signal (SSAO, a shadow mask, ...): the running average of every
+// pixel's reprojected history and this frame, the history's weight growing with the frames it holds, up to
+// maxFrames. History whose view depth doesn't match the pixel's (disoccluded, or off screen last frame) is
+// thrown away and the average starts over.
+uniform sampler2D current;      // this frame's signal, rgb
+uniform sampler2D history;      // rgb: the average, a: the frames in it; linear filtered
+uniform sampler2D historyDepth; // the view depth the history was accumulated at
+uniform sampler2D velocity;     // the G-buffer's: where a pixel was is TexCoords - velocity
+uniform sampler2D depth;        // the G-buffer's
+uniform mat4 inverseProjection;
+uniform float maxFrames;
+uniform float depthTolerance;   // relative
+uniform bool historyValid;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 value = textureLod(current, TexCoords, 0.0).rgb;
+    float d = texelFetch(depth, pixel, 0).r;
+    if (d >= 1.0)
+    {
+        // nothing drawn here
+        FragColor = vec4(value, 1.0);
+        ViewDepth = 0.0;
+        return;
+    }
+    vec4 viewPos = inverseProjection * vec4(vec3(TexCoords, d) * 2.0 - 1.0, 1.0);
+    float z = -viewPos.z / viewPos.w;
+
+    float frames = 1.0;
+    vec3 accumulated = value;
+    vec2 previousUV = TexCoords - texelFetch(velocity, pixel, 0).xy;
+    bool onScreen = all(greaterThanEqual(previousUV, vec2(0.0))) && all(lessThanEqual(previousUV, vec2(1.0)));
+    if (historyValid && onScreen)
+    {
+        float previousZ = textureLod(historyDepth, previousUV, 0.0).r;
+        if (abs(previousZ - z) < depthTolerance * z)
+        {
+            vec4 previous = textureLod(history, previousUV, 0.0);
+            frames = min(previous.a + 1.0, maxFrames);
+            accumulated = mix(previous.rgb, value, 1.0 / frames);
+        }
+    }
+    FragColor = vec4(accumulated, frames);
+    ViewDepth = z;
+}
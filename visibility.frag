@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) out uint visibility;
+
+flat in uint FirstID;
+
+void main()
+{
+    // the triangle's ID, gl_PrimitiveID counts the triangles of the instance
+    visibility = FirstID + uint(gl_PrimitiveID);
+}
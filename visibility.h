@@ -0,0 +1,384 @@
+
+
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "mesh.h"
+#include "model.h"
+#include "material.h"
+#include "glstate.h"
+#include "instancing.h"
+#include "primitives.h"
+#include "clusters.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <vector>
+using namespace std;
+
+// Visibility buffer rendering, the alternative to a G-buffer when overdraw is high (dense models, the asteroid
+// field): the geometry pass writes nothing but depth and a 32 bit visibility ID per pixel, so an overdrawn
+// pixel costs 8 bytes no matter how many textures its material has. Every triangle drawn in a frame gets its
+// own ID: each draw reserves instances x triangles consecutive IDs and the fragment shader adds
+// gl_InstanceID * triangles + gl_PrimitiveID to the draw's first one (0 is the background).
+//
+// resolve() then shades every pixel exactly once. It looks the draw up by its ID, fetches the triangle's three
+// vertices from one shared vertex/index buffer (every mesh drawn is copied in there once) and the instance's
+// transform from a per frame transform buffer, and computes perspective correct barycentrics and their screen
+// derivatives analytically (texture LOD through textureGrad). Material textures can't be picked per pixel on a
+// 3.3 context, so pixels are first classified: a pass writes each pixel's material index as depth, and then
+// every material is one screen filling quad at its depth with GL_EQUAL testing, the early depth test only lets
+// its own pixels through. Lighting is the clustered Blinn-Phong of deferredShading.frag.
+//
+// All tables are buffer textures (3.3 again); instance transforms are copied on the GPU from the instance
+// buffers, so GPU written instance data works too. Instances must use the Matrix() or Compact() layout.
+class VisibilityBuffer
+{
+public:
+    // units of the tables; materials bind from 0 and need fewer than 4 textures
+    static const unsigned int VISIBILITY_UNIT = 4;
+    static const unsigned int VERTICES_UNIT = 5;
+    static const unsigned int INDICES_UNIT = 6;
+    static const unsigned int DRAWS_UNIT = 7;
+    static const unsigned int TRANSFORMS_UNIT = 8;
+    static const unsigned int MAX_MATERIALS = 1023; // material depth is (index + 1) / 1024
+
+    unsigned int visibility; // R32UI visibility IDs
+    unsigned int depth;      // scene depth of the geometry pass
+    unsigned int color;      // RGBA16F, what resolve() shades
+    unsigned int resolveFBO; // color + material depth, blit or sample color from it
+    int width, height;
+    unsigned int drawCount; // draws recorded since begin()
+
+    VisibilityBuffer(int bufferWidth, int bufferHeight, unsigned int maxTransforms = 65536)
+        : visibility(0), depth(0), color(0), resolveFBO(0), width(0), height(0), drawCount(0),
+          geometryShader("visibility.vs", "visibility.frag"), classifyShader("hdr.vs", "visibilityClassify.frag"),
+          resolveShader("visibilityResolve.vs", "visibilityResolve.frag"), materialDepth(0),
+          transformCapacity(maxTransforms * 4), transformTexels(0), nextID(1), geometryDirty(false)
+    {
+        glGenFramebuffers(1, &FBO);
+        glGenFramebuffers(1, &resolveFBO);
+        createBufferTexture(vertexBuffer, vertexTexture, GL_RGBA32F);
+        createBufferTexture(indexBuffer, indexTexture, GL_R32UI);
+        createBufferTexture(drawBuffer, drawTexture, GL_RGBA32UI);
+        createBufferTexture(transformBuffer, transformTexture, GL_RGBA32F);
+        resize(bufferWidth, bufferHeight);
+    }
+
+    // reallocates the targets for a new screen size
+    void resize(int bufferWidth, int bufferHeight)
+    {
+        if (bufferWidth == width && bufferHeight == height)
+            return;
+        width = std::max(1, bufferWidth);
+        height = std::max(1, bufferHeight);
+        if (visibility)
+        {
+            unsigned int textures[4] = { visibility, depth, color, materialDepth };
+            glDeleteTextures(4, textures);
+            glState().invalidate(); // some of them may still be bound
+        }
+        visibility = createTarget(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT);
+        depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+        color = createTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT);
+        materialDepth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, visibility, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::VISIBILITY:: Framebuffer not complete!" << std::endl;
+        glState().bindFramebuffer(GL_FRAMEBUFFER, resolveFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, materialDepth, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::VISIBILITY:: Resolve framebuffer not complete!" << std::endl;
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // starts the geometry pass: binds and clears the visibility buffer, with a viewport of its size
+    void begin(const glm::mat4& projection, const glm::mat4& view)
+    {
+        viewProjection = projection * view;
+        viewMatrix = view;
+        draws.clear();
+        drawCount = 0;
+        nextID = 1;
+        transformTexels = 0;
+        materialUsed.assign(materials.size(), false);
+        // a fresh store every frame, so the GPU can keep reading last frame's
+        glState().bindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)transformCapacity * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+
+        glState().bindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glState().viewport(0, 0, width, height);
+        glState().depthMask(GL_TRUE);
+        GLuint background[4] = { 0, 0, 0, 0 };
+        float clearDepth = 1.0f;
+        glClearBufferuiv(GL_COLOR, 0, background);
+        glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+        geometryShader.use();
+        geometryShader.setMat4("projection", projection);
+        geometryShader.setMat4("view", view);
+    }
+
+    // the geometry pass: draws a model (or one mesh) with the model matrix
+    void draw(Model& object, const glm::mat4& model)
+    {
+        for (unsigned int i = 0; i < object.meshes.size(); i++)
+            draw(object.meshes[i], model);
+    }
+    void draw(Mesh& mesh, const glm::mat4& model)
+    {
+        if (transformTexels + 4 > transformCapacity)
+        {
+            std::cout << "ERROR::VISIBILITY:: Out of transform space" << std::endl;
+            return;
+        }
+        uint32_t transform = transformTexels;
+        glState().bindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, (GLintptr)transform * sizeof(glm::vec4), sizeof(glm::mat4), &model[0][0]);
+        transformTexels += 4;
+        if (!record(mesh, 1, transform, 4))
+            return;
+        geometryShader.use();
+        geometryShader.setInt("instanceLayout", 0);
+        geometryShader.setMat4("model", model);
+        mesh.Draw(geometryShader);
+    }
+
+    // the geometry pass: draws count instances of a model (or one mesh) from an instance buffer
+    void drawInstanced(Model& object, const InstanceBuffer& instances, unsigned int count)
+    {
+        for (unsigned int i = 0; i < object.meshes.size(); i++)
+            drawInstanced(object.meshes[i], instances, count);
+    }
+    void drawInstanced(Model& object, const InstanceBuffer& instances)
+    {
+        drawInstanced(object, instances, instances.count);
+    }
+    void drawInstanced(Mesh& mesh, const InstanceBuffer& instances, unsigned int count)
+    {
+        if (count == 0)
+            return;
+        const InstanceLayout& layout = instances.layout;
+        bool compact = layout.stride == sizeof(CompactInstance) && layout.attributes.size() == 2 && layout.attributes[1].type == GL_FLOAT;
+        bool matrix = layout.stride == sizeof(glm::mat4) && layout.attributes.size() == 4;
+        if (!compact && !matrix)
+        {
+            std::cout << "ERROR::VISIBILITY:: Instances must use InstanceLayout::Matrix() or Compact()" << std::endl;
+            return;
+        }
+        uint32_t texels = layout.stride / sizeof(glm::vec4);
+        if (transformTexels + (size_t)count * texels > transformCapacity)
+        {
+            std::cout << "ERROR::VISIBILITY:: Out of transform space" << std::endl;
+            return;
+        }
+        uint32_t transform = transformTexels;
+        // copied on the GPU, the instances may well have been written there
+        glState().bindBuffer(GL_COPY_READ_BUFFER, instances.ID);
+        glState().bindBuffer(GL_COPY_WRITE_BUFFER, transformBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)instances.regionOffset(),
+                            (GLintptr)transform * sizeof(glm::vec4), (GLsizeiptr)count * layout.stride);
+        transformTexels += count * texels;
+        if (!record(mesh, count, transform, texels))
+            return;
+        geometryShader.use();
+        geometryShader.setInt("instanceLayout", compact ? 2 : 1);
+        mesh.DrawInstanced(geometryShader, instances, count);
+    }
+
+    // shades every covered pixel once into color, lit by the clustered lights (their update() done for this view)
+    void resolve(ClusteredLights& lights, const glm::vec3& viewPos)
+    {
+        uploadGeometry();
+        uploadBuffer(drawBuffer, draws.empty() ? 0 : &draws[0], draws.size() * sizeof(glm::uvec4));
+
+        glState().bindFramebuffer(GL_FRAMEBUFFER, resolveFBO);
+        glState().viewport(0, 0, width, height);
+        glState().depthMask(GL_TRUE);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glState().disable(GL_BLEND);
+        glState().enable(GL_DEPTH_TEST);
+        glState().bindTexture(GL_TEXTURE0 + VISIBILITY_UNIT, GL_TEXTURE_2D, visibility);
+        glState().bindTexture(GL_TEXTURE0 + VERTICES_UNIT, GL_TEXTURE_BUFFER, vertexTexture);
+        glState().bindTexture(GL_TEXTURE0 + INDICES_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+        glState().bindTexture(GL_TEXTURE0 + DRAWS_UNIT, GL_TEXTURE_BUFFER, drawTexture);
+        glState().bindTexture(GL_TEXTURE0 + TRANSFORMS_UNIT, GL_TEXTURE_BUFFER, transformTexture);
+
+        // 1. every pixel's material index goes into the depth buffer
+        classifyShader.use();
+        setTables(classifyShader);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glState().depthFunc(GL_ALWAYS);
+        Primitives::Quad().draw();
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        // 2. one screen filling quad per material at its depth, the early depth test rejects the other pixels
+        resolveShader.use();
+        setTables(resolveShader);
+        resolveShader.setMat4("viewProjection", viewProjection);
+        resolveShader.setMat4("view", viewMatrix);
+        resolveShader.setVec3("viewPos", viewPos);
+        resolveShader.setVec2("screenSize", (float)width, (float)height);
+        lights.bind(resolveShader, width, height);
+        glState().depthFunc(GL_EQUAL);
+        glState().depthMask(GL_FALSE);
+        for (unsigned int i = 0; i < materials.size(); i++)
+        {
+            if (!materialUsed[i])
+                continue;
+            resolveShader.setFloat("materialDepth", (i + 1) / (float)(MAX_MATERIALS + 1));
+            materials[i]->bind();
+            Primitives::Quad().draw();
+        }
+        glState().depthFunc(GL_LESS);
+        glState().depthMask(GL_TRUE);
+    }
+
+private:
+    // a mesh in the shared vertex/index buffers
+    struct Geometry {
+        uint32_t firstIndex;
+        uint32_t triangles;
+        uint32_t material;
+    };
+
+    unsigned int FBO;
+    Shader geometryShader, classifyShader, resolveShader;
+    unsigned int materialDepth;
+    unsigned int vertexBuffer, vertexTexture;
+    unsigned int indexBuffer, indexTexture;
+    unsigned int drawBuffer, drawTexture;
+    unsigned int transformBuffer, transformTexture;
+    size_t transformCapacity; // texels
+    uint32_t transformTexels;
+    uint64_t nextID;
+    bool geometryDirty;
+    glm::mat4 viewProjection, viewMatrix;
+
+    map<const Mesh*, Geometry> geometry;
+    vector<glm::vec4> vertices; // two texels per vertex: position + u, normal + v
+    vector<uint32_t> indices;   // already offset to the mesh's first vertex
+    vector<Material*> materials;
+    vector<bool> materialUsed;
+    // two texels per draw: first ID, first index, triangles, material; first transform texel, texels per transform
+    vector<glm::uvec4> draws;
+
+    // reserves the draw's IDs and adds its record, false if the frame ran out of IDs
+    bool record(Mesh& mesh, unsigned int count, uint32_t transform, uint32_t texels)
+    {
+        const Geometry& source = geometryOf(mesh);
+        uint64_t ids = (uint64_t)count * source.triangles;
+        if (source.triangles == 0 || nextID + ids > 0xFFFFFFFFull)
+        {
+            if (source.triangles != 0)
+                std::cout << "ERROR::VISIBILITY:: Out of visibility IDs" << std::endl;
+            return false;
+        }
+        draws.push_back(glm::uvec4((uint32_t)nextID, source.firstIndex, source.triangles, source.material));
+        draws.push_back(glm::uvec4(transform, texels, 0, 0));
+        materialUsed[source.material] = true;
+        geometryShader.use();
+        geometryShader.setUint("firstID", (uint32_t)nextID);
+        geometryShader.setUint("triangles", source.triangles);
+        nextID += ids;
+        drawCount++;
+        return true;
+    }
+
+    // the mesh's place in the shared buffers, copied in on its first draw
+    const Geometry& geometryOf(Mesh& mesh)
+    {
+        map<const Mesh*, Geometry>::iterator it = geometry.find(&mesh);
+        if (it != geometry.end())
+            return it->second;
+        Geometry created;
+        created.firstIndex = (uint32_t)indices.size();
+        created.triangles = (uint32_t)(mesh.indices.size() / 3);
+        Material* material = &Material::Get(resolveShader, mesh.textures);
+        created.material = (uint32_t)(std::find(materials.begin(), materials.end(), material) - materials.begin());
+        if (created.material == materials.size())
+        {
+            if (materials.size() == MAX_MATERIALS)
+            {
+                std::cout << "ERROR::VISIBILITY:: Too many materials" << std::endl;
+                created.triangles = 0;
+                return geometry.insert(make_pair(&mesh, created)).first->second;
+            }
+            materials.push_back(material);
+            materialUsed.push_back(false);
+        }
+        uint32_t firstVertex = (uint32_t)(vertices.size() / 2);
+        for (unsigned int i = 0; i < mesh.vertices.size(); i++)
+        {
+            const Vertex& vertex = mesh.vertices[i];
+            vertices.push_back(glm::vec4(vertex.Position, vertex.TexCoords.x));
+            vertices.push_back(glm::vec4(vertex.Normal, vertex.TexCoords.y));
+        }
+        for (unsigned int i = 0; i < created.triangles * 3; i++)
+            indices.push_back(firstVertex + mesh.indices[i]);
+        geometryDirty = true;
+        return geometry.insert(make_pair(&mesh, created)).first->second;
+    }
+
+    void uploadGeometry()
+    {
+        if (!geometryDirty)
+            return;
+        uploadBuffer(vertexBuffer, vertices.empty() ? 0 : &vertices[0], vertices.size() * sizeof(glm::vec4));
+        uploadBuffer(indexBuffer, indices.empty() ? 0 : &indices[0], indices.size() * sizeof(uint32_t));
+        geometryDirty = false;
+    }
+
+    void setTables(Shader& shader)
+    {
+        shader.setInt("visibility", VISIBILITY_UNIT);
+        shader.setInt("vertices", VERTICES_UNIT);
+        shader.setInt("indices", INDICES_UNIT);
+        shader.setInt("draws", DRAWS_UNIT);
+        shader.setInt("transforms", TRANSFORMS_UNIT);
+        shader.setInt("drawCount", (int)drawCount);
+    }
+
+    unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState().bindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    static void createBufferTexture(unsigned int& buffer, unsigned int& texture, GLenum format)
+    {
+        glGenBuffers(1, &buffer);
+        glState().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glState().bindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    }
+
+    static void uploadBuffer(unsigned int buffer, const void* data, size_t size)
+    {
+        glState().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // a fresh store every time, so the GPU can keep reading the old one
+        glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t)16), NULL, GL_STREAM_DRAW);
+        if (size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+};
+#endif
@@ -0,0 +1,35 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 8) in vec4 aInstance0; // mat4 instances: the 4 columns at 8-11,
+layout (location = 9) in vec4 aInstance1; // CompactInstance: position + scale at 8, rotation at 9 (instancing.h)
+layout (location = 10) in vec4 aInstance2;
+layout (location = 11) in vec4 aInstance3;
+
+flat out uint FirstID; // visibility ID of this instance's first triangle
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+uniform int instanceLayout; // 0: the model uniform, 1: mat4 instances, 2: CompactInstance
+uniform uint firstID;       // of the draw, see VisibilityBuffer in visibility.h
+uniform uint triangles;
+
+// rotates v by the unit quaternion q
+vec3 rotate(vec4 q, vec3 v)
+{
+    vec3 t = 2.0 * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+
+void main()
+{
+    FirstID = firstID + uint(gl_InstanceID) * triangles;
+    vec3 worldPos;
+    if (instanceLayout == 2)
+        worldPos = aInstance0.xyz + aInstance0.w * rotate(aInstance1, aPos);
+    else if (instanceLayout == 1)
+        worldPos = (mat4(aInstance0, aInstance1, aInstance2, aInstance3) * vec4(aPos, 1.0)).xyz;
+    else
+        worldPos = (model * vec4(aPos, 1.0)).xyz;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
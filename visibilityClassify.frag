@@ -0,0 +1,31 @@
+#version 330 core
+
+uniform usampler2D visibility;
+uniform usamplerBuffer draws; // 2 texels per draw: first ID, first index, triangles, material; transform
+uniform int drawCount;
+
+// the draw an ID belongs to: the last one starting at or before it
+int findDraw(uint id)
+{
+    int first = 0;
+    int last = drawCount - 1;
+    while (first < last)
+    {
+        int middle = (first + last + 1) / 2;
+        if (texelFetch(draws, 2 * middle).x <= id)
+            first = middle;
+        else
+            last = middle - 1;
+    }
+    return first;
+}
+
+void main()
+{
+    uint id = texelFetch(visibility, ivec2(gl_FragCoord.xy), 0).r;
+    if (id == 0u)
+        discard; // background
+    // the resolve pass draws each material's quad at this depth (VisibilityBuffer::MAX_MATERIALS + 1 = 1024)
+    uint material = texelFetch(draws, 2 * findDraw(id)).w;
+    gl_FragDepth = float(material + 1u) / 1024.0;
+}
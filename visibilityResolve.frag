@@ -0,0 +1,174 @@
+#version 330 core
+out vec4 FragColor;
+
+// visibility buffer tables, see VisibilityBuffer in visibility.h
+uniform usampler2D visibility;
+uniform samplerBuffer vertices;   // 2 texels per vertex: position + u, normal + v
+uniform usamplerBuffer indices;   // 3 per triangle, pointing into vertices
+uniform usamplerBuffer draws;     // 2 texels per draw: first ID, first index, triangles, material; first transform texel, texels per transform
+uniform samplerBuffer transforms; // per instance: a mat4 (4 texels) or a CompactInstance (2 texels)
+uniform int drawCount;
+
+uniform mat4 viewProjection;
+uniform mat4 view;
+uniform vec3 viewPos;
+uniform vec2 screenSize;
+
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_specular1;
+
+// clustered point lights (ClusteredLights in clusters.h)
+uniform samplerBuffer clusterLights;   // 3 texels per light: position + radius, color + linear, quadratic
+uniform usamplerBuffer clusterCells;   // per cluster: first index, light count
+uniform usamplerBuffer clusterIndices; // light indices of all clusters
+uniform vec2 clusterTileScale;         // tiles per pixel
+uniform vec2 clusterSliceParams;       // slice = log(view depth) * x + y
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24); // LightClusterGrid::TILES_X, TILES_Y, SLICES
+
+// the draw an ID belongs to: the last one starting at or before it
+int findDraw(uint id)
+{
+    int first = 0;
+    int last = drawCount - 1;
+    while (first < last)
+    {
+        int middle = (first + last + 1) / 2;
+        if (texelFetch(draws, 2 * middle).x <= id)
+            first = middle;
+        else
+            last = middle - 1;
+    }
+    return first;
+}
+
+// rotates v by the unit quaternion q
+vec3 rotate(vec4 q, vec3 v)
+{
+    vec3 t = 2.0 * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+
+// perspective correct barycentrics of the pixel and their change per pixel in x and y, computed from the
+// triangle's clip space corners the way the rasterizer would
+struct Barycentrics {
+    vec3 lambda;
+    vec3 ddx;
+    vec3 ddy;
+};
+
+Barycentrics barycentrics(vec4 p0, vec4 p1, vec4 p2, vec2 pixelNdc)
+{
+    Barycentrics result;
+    vec3 invW = 1.0 / vec3(p0.w, p1.w, p2.w);
+    vec2 ndc0 = p0.xy * invW.x;
+    vec2 ndc1 = p1.xy * invW.y;
+    vec2 ndc2 = p2.xy * invW.z;
+    // screen space (linear in ndc) barycentric gradients, weighted by 1/w
+    float invDet = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+    vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+    vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+    float ddxSum = dot(ddx, vec3(1.0));
+    float ddySum = dot(ddy, vec3(1.0));
+    vec2 delta = pixelNdc - ndc0;
+    float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+    result.lambda = (vec3(invW.x, 0.0, 0.0) + delta.x * ddx + delta.y * ddy) / interpInvW;
+    // one pixel is 2 / screenSize in ndc
+    vec2 pixel = 2.0 / screenSize;
+    result.ddx = (result.lambda * interpInvW + ddx * pixel.x) / (interpInvW + ddxSum * pixel.x) - result.lambda;
+    result.ddy = (result.lambda * interpInvW + ddy * pixel.y) / (interpInvW + ddySum * pixel.y) - result.lambda;
+    return result;
+}
+
+void main()
+{
+    uint id = texelFetch(visibility, ivec2(gl_FragCoord.xy), 0).r;
+    // the draw, the instance and the triangle
+    int draw = findDraw(id);
+    uvec4 record = texelFetch(draws, 2 * draw);
+    uvec4 transform = texelFetch(draws, 2 * draw + 1);
+    uint local = id - record.x;
+    uint instance = local / record.z;
+    uint triangle = local - instance * record.z;
+
+    // the instance's transform
+    int first = int(transform.x + instance * transform.y);
+    mat4 model;
+    mat3 normalMatrix;
+    if (transform.y == 2u)
+    {
+        vec4 positionScale = texelFetch(transforms, first);
+        vec4 rotation = texelFetch(transforms, first + 1);
+        normalMatrix = mat3(rotate(rotation, vec3(1.0, 0.0, 0.0)), rotate(rotation, vec3(0.0, 1.0, 0.0)), rotate(rotation, vec3(0.0, 0.0, 1.0)));
+        model = mat4(vec4(normalMatrix[0] * positionScale.w, 0.0), vec4(normalMatrix[1] * positionScale.w, 0.0),
+                     vec4(normalMatrix[2] * positionScale.w, 0.0), vec4(positionScale.xyz, 1.0));
+    }
+    else
+    {
+        model = mat4(texelFetch(transforms, first), texelFetch(transforms, first + 1), texelFetch(transforms, first + 2), texelFetch(transforms, first + 3));
+        normalMatrix = transpose(inverse(mat3(model)));
+    }
+
+    // the triangle's corners
+    int index = int(record.y + 3u * triangle);
+    vec3 worldPos[3];
+    vec3 normals[3];
+    vec3 u, v;
+    vec4 clip[3];
+    for (int i = 0; i < 3; i++)
+    {
+        int vertex = int(texelFetch(indices, index + i).r);
+        vec4 positionU = texelFetch(vertices, 2 * vertex);
+        vec4 normalV = texelFetch(vertices, 2 * vertex + 1);
+        worldPos[i] = (model * vec4(positionU.xyz, 1.0)).xyz;
+        normals[i] = normalV.xyz;
+        u[i] = positionU.w;
+        v[i] = normalV.w;
+        clip[i] = viewProjection * vec4(worldPos[i], 1.0);
+    }
+
+    // interpolate the attributes like the rasterizer would have
+    Barycentrics b = barycentrics(clip[0], clip[1], clip[2], gl_FragCoord.xy / screenSize * 2.0 - 1.0);
+    vec3 FragPos = mat3(worldPos[0], worldPos[1], worldPos[2]) * b.lambda;
+    vec3 Normal = normalize(normalMatrix * (mat3(normals[0], normals[1], normals[2]) * b.lambda));
+    vec2 TexCoords = vec2(dot(u, b.lambda), dot(v, b.lambda));
+    vec2 texCoordsDx = vec2(dot(u, b.ddx), dot(v, b.ddx));
+    vec2 texCoordsDy = vec2(dot(u, b.ddy), dot(v, b.ddy));
+
+    // material
+    vec3 Diffuse = textureGrad(texture_diffuse1, TexCoords, texCoordsDx, texCoordsDy).rgb;
+    float Specular = textureGrad(texture_specular1, TexCoords, texCoordsDx, texCoordsDy).r;
+
+    // then calculate lighting as usual (as in deferredShading.frag)
+    vec3 lighting  = Diffuse * 0.1; // hard-coded ambient component
+    vec3 viewDir  = normalize(viewPos - FragPos);
+    // only the lights of this pixel's cluster can reach it
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+    ivec3 clusterCoord = ivec3(ivec2(gl_FragCoord.xy * clusterTileScale), int(log(viewDepth) * clusterSliceParams.x + clusterSliceParams.y));
+    clusterCoord = clamp(clusterCoord, ivec3(0), CLUSTER_GRID - 1);
+    uvec2 cell = texelFetch(clusterCells, (clusterCoord.z * CLUSTER_GRID.y + clusterCoord.y) * CLUSTER_GRID.x + clusterCoord.x).xy;
+    for(uint i = 0u; i < cell.y; ++i)
+    {
+        int light = int(texelFetch(clusterIndices, int(cell.x + i)).r);
+        vec4 positionRadius = texelFetch(clusterLights, 3 * light);
+        vec4 colorLinear = texelFetch(clusterLights, 3 * light + 1);
+        float quadratic = texelFetch(clusterLights, 3 * light + 2).r;
+        // calculate distance between light source and current fragment
+        float distance = length(positionRadius.xyz - FragPos);
+        if(distance < positionRadius.w)
+        {
+            // diffuse
+            vec3 lightDir = normalize(positionRadius.xyz - FragPos);
+            vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * colorLinear.rgb;
+            // specular
+            vec3 halfwayDir = normalize(lightDir + viewDir);  
+            float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
+            vec3 specular = colorLinear.rgb * spec * Specular;
+            // attenuation
+            float attenuation = 1.0 / (1.0 + colorLinear.a * distance + quadratic * distance * distance);
+            diffuse *= attenuation;
+            specular *= attenuation;
+            lighting += diffuse + specular;
+        }
+    }    
+    FragColor = vec4(lighting, 1.0);
+}
@@ -0,0 +1,9 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform float materialDepth; // depth the classification pass wrote for this material's pixels
+
+void main()
+{
+    gl_Position = vec4(aPos.xy, materialDepth * 2.0 - 1.0, 1.0);
+}
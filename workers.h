@@ -0,0 +1,109 @@
+
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// A fixed set of worker threads for data parallel loops. parallelFor splits [0, count) in one contiguous
+// range per thread (the calling thread takes the first one) and returns when all ranges are done.
+// The threads sleep between calls, so a per-frame loop pays a wake-up instead of a thread creation.
+class WorkerPool
+{
+public:
+    // threadCount includes the calling thread, 0 means one per hardware thread
+    explicit WorkerPool(unsigned int threadCount = 0)
+        : currentJob(0), chunkSize(0), total(0), generation(0), pending(0), quit(false)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, thread::hardware_concurrency());
+        for (unsigned int i = 1; i < threadCount; i++)
+            threads.push_back(thread(&WorkerPool::workerLoop, this, i));
+    }
+
+    ~WorkerPool()
+    {
+        {
+            lock_guard<mutex> lock(m);
+            quit = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+    }
+
+    unsigned int size() const
+    {
+        return (unsigned int)threads.size() + 1;
+    }
+
+    // calls job(begin, end) on every thread with its share of [0, count), ranges start at multiples of alignment
+    void parallelFor(size_t count, const function<void(size_t, size_t)>& job, size_t alignment = 1)
+    {
+        unsigned int n = size();
+        size_t chunk = (count + n - 1) / n;
+        chunk = (chunk + alignment - 1) / alignment * alignment;
+        if (n == 1 || count <= alignment)
+        {
+            job(0, count);
+            return;
+        }
+        {
+            lock_guard<mutex> lock(m);
+            currentJob = &job;
+            chunkSize = chunk;
+            total = count;
+            pending = (unsigned int)threads.size();
+            generation++;
+        }
+        wake.notify_all();
+        job(0, std::min(chunk, count));
+        unique_lock<mutex> lock(m);
+        done.wait(lock, [this] { return pending == 0; });
+        currentJob = 0;
+    }
+
+private:
+    vector<thread> threads;
+    mutex m;
+    condition_variable wake, done;
+    const function<void(size_t, size_t)>* currentJob;
+    size_t chunkSize, total;
+    unsigned int generation;
+    unsigned int pending;
+    bool quit;
+
+    void workerLoop(unsigned int index)
+    {
+        unsigned int seen = 0;
+        for (;;)
+        {
+            const function<void(size_t, size_t)>* job;
+            size_t begin, end;
+            {
+                unique_lock<mutex> lock(m);
+                wake.wait(lock, [&] { return quit || generation != seen; });
+                if (quit)
+                    return;
+                seen = generation;
+                job = currentJob;
+                begin = std::min(total, chunkSize * index);
+                end = std::min(total, begin + chunkSize);
+            }
+            if (begin < end)
+                (*job)(begin, end);
+            {
+                lock_guard<mutex> lock(m);
+                pending--;
+            }
+            done.notify_one();
+        }
+    }
+};
+#endif